@@ -18,6 +18,7 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <chrono>
 #include <map>
 
 namespace Pothos {
@@ -49,6 +50,87 @@ public:
     //! Get the thread pool used by this block
     const ThreadPool &getThreadPool(void) const;
 
+    /*!
+     * Set a placement hint for the thread that runs this block.
+     * The mode and list follow the ThreadPoolArgs affinity conventions.
+     * In thread-per-block mode, the hint pins the block's thread.
+     * In thread pool mode, blocks with the same hint are processed
+     * by a designated pool thread which is pinned to the hint.
+     * \param affinityMode "CPU", "NUMA", or "ALL" to clear the hint
+     * \param affinity a list of CPUs or NUMA nodes (depends on mode)
+     */
+    void setThreadAffinity(const std::string &affinityMode, const std::vector<size_t> &affinity);
+
+    //! Get the placement hint mode (empty when not set)
+    const std::string &getThreadAffinityMode(void) const;
+
+    //! Get the placement hint list of CPUs or NUMA nodes
+    const std::vector<size_t> &getThreadAffinity(void) const;
+
+    /*!
+     * Set the scheduling class for this block.
+     * In thread pool mode, pool threads serve ready blocks
+     * in the "HIGH" and "DEADLINE" classes before other blocks.
+     *
+     *  - "NORMAL" - round-robin or work-stealing (the default)
+     *  - "HIGH" - served before normal blocks in order of readiness
+     *  - "DEADLINE" - served before high priority blocks
+     *    in order of the earliest deadline, see setDeadline()
+     *
+     * \param schedulingClass the name of the scheduling class
+     * \throws ThreadPoolError for an unknown scheduling class
+     */
+    void setSchedulingClass(const std::string &schedulingClass);
+
+    //! Get the scheduling class for this block
+    const std::string &getSchedulingClass(void) const;
+
+    /*!
+     * Set the deadline metadata for the "DEADLINE" scheduling class.
+     * The deadline is relative to the time that the block becomes ready.
+     * When the deadline is zero, the period is used as the deadline.
+     * A block which is dispatched after its deadline counts
+     * a deadline miss, which is reported in the work stats.
+     * \param deadlineNs the relative deadline in nanoseconds
+     * \param periodNs the activation period in nanoseconds
+     */
+    void setDeadline(const long long deadlineNs, const long long periodNs = 0);
+
+    /*!
+     * Register a file descriptor for readiness notifications.
+     * The thread pool monitors the descriptors of its blocks,
+     * and calls work() when a descriptor is ready for reading
+     * or writing, so blocks which wrap sockets, pipes, or devices
+     * neither poll nor block in work() when there is nothing to do.
+     * The notification is level-triggered: work() is called again
+     * while the descriptor remains ready, use non-blocking I/O in work().
+     * Registering a registered descriptor replaces its interest.
+     * Unregister the descriptor before closing it.
+     * \param fd the file descriptor
+     * \param read true to call work() when the descriptor is readable
+     * \param write true to call work() when the descriptor is writable
+     * \throws ThreadPoolError when the descriptor cannot be monitored
+     */
+    void registerFileDescriptor(const int fd, const bool read, const bool write = false);
+
+    //! Unregister a file descriptor from readiness notifications
+    void unregisterFileDescriptor(const int fd);
+
+    /*!
+     * Make a replica of this block for data-parallel processing.
+     * A block opts into replication by overriding this method
+     * to return a new block with the same configuration.
+     * A replicable block has one input and one output port,
+     * and processes each frame of its input independently.
+     * The output of a frame should be produced by the work call
+     * which consumes the end of the frame, or earlier.
+     * The input labels are carried to the output when the block
+     * propagates them, but the merge does not depend on the labels.
+     * See Topology::setReplication() for the replication.
+     * \return a new block or null when not replicable (default)
+     */
+    virtual std::shared_ptr<Block> replicate(void);
+
 protected:
 
     /*!
@@ -319,6 +401,26 @@ public:
      */
     void yield(void);
 
+    /*!
+     * Notify the scheduler to call work() again at the specified time.
+     * Call this method instead of yield() when the work() function
+     * has nothing to do until a known time, such as a paced source
+     * or a periodic probe, so that the block is not polled meanwhile.
+     * The scheduler skips the block until the specified time,
+     * or until an external stimulus like an input arrives first,
+     * so the work() function must check the time when called.
+     * Only call this method from within a call to the work() function.
+     * \param when the time on the steady clock for the next work() call
+     */
+    void yieldUntil(const std::chrono::steady_clock::time_point &when);
+
+    /*!
+     * Notify the scheduler to call work() again after a delay.
+     * This is a convenience method for yieldUntil() given a delay.
+     * \param delayNs the delay in nanoseconds from now
+     */
+    void yieldFor(const long long delayNs);
+
     /*!
      * Emit a signal to all subscribed slots.
      * \param name the name of a registered signal
@@ -347,6 +449,11 @@ private:
     std::multimap<std::string, Callable> _calls;
     std::map<std::string, std::pair<std::string, std::string>> _probes;
     ThreadPool _threadPool;
+    std::string _threadAffinityMode;
+    std::vector<size_t> _threadAffinity;
+    std::string _schedulingClass;
+    long long _deadlineNs;
+    long long _periodNs;
     Block(const Block &){} // non construction-copyable
     Block &operator=(const Block &){return *this;} // non copyable
 public:
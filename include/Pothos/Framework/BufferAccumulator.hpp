@@ -72,11 +72,23 @@ public:
      * If the front buffer is less than numBytes,
      * several buffers will be copied together
      * into a larger buffer with at least numBytes.
+     * Buffers from a circular buffer manager are not copied
+     * while the ring can still grow the front to numBytes.
      * The effect of this call is over after pop().
      * \param numBytes the number of bytes needed
      */
     void require(const size_t numBytes);
 
+    /*!
+     * Reserve resources so that the steady state does not allocate:
+     * The queue holds numBuffers separate buffers without growing.
+     * When numBytes is non-zero, a buffer for require(numBytes)
+     * is made in the internal pool and its pages are touched.
+     * \param numBuffers the number of buffers to hold
+     * \param numBytes the size of the largest require() or 0
+     */
+    void reserve(const size_t numBuffers, const size_t numBytes = 0);
+
     /*!
      * How many unique managed buffers are enqueued in this accumulator?
      * \warning expensive: this method is for debug/stats purposes.
@@ -116,6 +116,9 @@ public:
 
     /*!
      * The underlying reference counted shared buffer.
+     * For a chunk from a managed buffer, this is the buffer
+     * held by the managed buffer, so copies of the chunk
+     * only count references on the managed buffer.
      */
     const SharedBuffer &getBuffer(void) const;
 
@@ -228,7 +231,7 @@ public:
 
 private:
     friend BufferAccumulator;
-    SharedBuffer _buffer;
+    SharedBuffer _buffer; //null when held by the managed buffer
     ManagedBuffer _managedBuffer;
     void _incrNextBuffers(void);
     void _decrNextBuffers(void);
@@ -289,7 +292,6 @@ inline Pothos::BufferChunk::BufferChunk(const SharedBuffer &buffer):
 inline Pothos::BufferChunk::BufferChunk(const ManagedBuffer &buffer):
     address(buffer.getBuffer().getAddress()),
     length(buffer.getBuffer().getLength()),
-    _buffer(buffer.getBuffer()),
     _managedBuffer(buffer),
     _nextBuffers(0)
 {
@@ -370,6 +372,7 @@ inline void Pothos::BufferChunk::setElements(const size_t numElements)
 
 inline const Pothos::SharedBuffer &Pothos::BufferChunk::getBuffer(void) const
 {
+    if (_managedBuffer) return _managedBuffer.getBuffer();
     return _buffer;
 }
 
@@ -380,9 +383,13 @@ inline const Pothos::ManagedBuffer &Pothos::BufferChunk::getManagedBuffer(void)
 
 inline size_t Pothos::BufferChunk::getAlias(void) const
 {
-    if (_buffer.getAlias() == 0) return 0;
-    if (address > _buffer.getAlias()) return address - _buffer.getLength();
-    else return address + _buffer.getLength();
+    const auto &buffer = this->getBuffer();
+    if (buffer.getAlias() == 0) return 0;
+    //the alias is offset by the size of the entire circular ring,
+    //which may be larger than the length of this chunk's buffer
+    const size_t ringSize = buffer.getAlias() - buffer.getAddress();
+    if (address >= buffer.getAlias()) return address - ringSize;
+    else return address + ringSize;
 }
 
 inline size_t Pothos::BufferChunk::getEnd(void) const
@@ -398,7 +405,7 @@ ElementType Pothos::BufferChunk::as(void) const
 
 inline Pothos::BufferChunk::operator bool(void) const
 {
-    return (address != 0) or bool(_buffer);
+    return (address != 0) or bool(_managedBuffer) or bool(_buffer);
 }
 
 inline bool Pothos::BufferChunk::unique(void) const
@@ -4,7 +4,7 @@
 /// BufferManager provides an output pool of buffers.
 ///
 /// \copyright
-/// Copyright (c) 2013-2014 Josh Blum
+/// Copyright (c) 2013-2016 Josh Blum
 /// SPDX-License-Identifier: BSL-1.0
 ///
 
@@ -41,11 +41,21 @@ struct POTHOS_API BufferManagerArgs
     size_t bufferSize;
 
     /*!
-     * The NUMA node affinity for the generic slab allocator.
+     * The NUMA node affinity for the generic and circular managers.
      * This argument is not used for the special-case managers.
      * Default: -1 or unspecified affinity
      */
     long nodeAffinity;
+
+    /*!
+     * The huge page mode for the buffer allocation.
+     * Huge pages reduce TLB misses for large buffers;
+     * see SharedBuffer::make() for the available modes.
+     * The allocation falls back to regular pages when
+     * huge pages are not available on the system.
+     * Default: "NONE" for regular pages
+     */
+    std::string hugePages;
 };
 
 /*!
@@ -11,22 +11,43 @@
 #pragma once
 #include <Pothos/Config.hpp>
 #include <Pothos/Framework/BufferChunk.hpp>
-#include <vector>
+#include <memory>
 
 namespace Pothos {
 
 /*!
  * The simple buffer pool holds a collection of re-usable buffers.
+ * The buffers are sorted into power of two size classes,
+ * and each size class has a free list of the unused buffers.
  * When the client requests a particular buffer size from the pool,
- * the pool first looks for an existing and unused buffer
- * that matches the requested size, or allocates a new buffer.
+ * the pool pops an unused buffer from the matching size class,
+ * or allocates a new buffer when the free list is empty.
+ * When the last copy of a buffer is released on any thread,
+ * the buffer is pushed back onto its free list without locking.
+ * Each size class caches a bounded number of unused buffers,
+ * and any further buffers are freed when they are released.
+ *
+ * Only one thread may call get() and clear() at a time,
+ * and a copy of the pool starts out with an empty cache.
  */
 class POTHOS_API BufferPool
 {
 public:
 
-    //! Construct an empty buffer pool
-    BufferPool(void);
+    /*!
+     * Construct an empty buffer pool.
+     * \param maxCached the maximum unused buffers per size class
+     */
+    BufferPool(const size_t maxCached = 16);
+
+    //! Copy constructor makes a new empty pool
+    BufferPool(const BufferPool &other);
+
+    //! Destroy the pool -- outstanding buffers remain valid
+    ~BufferPool(void);
+
+    //! Assignment clears this pool
+    BufferPool &operator=(const BufferPool &other);
 
     /*!
      * Clear all existing entries in the pool.
@@ -38,11 +59,12 @@ public:
      * \param numBytes the size of the requested buffer in bytes
      * \return an available buffer chunk of at least numBytes size
      */
-    const Pothos::BufferChunk &get(const size_t numBytes);
+    Pothos::BufferChunk get(const size_t numBytes);
 
 private:
-    size_t _minBuffSize;
-    std::vector<Pothos::BufferChunk> _buffs;
+    struct Impl;
+    size_t _maxCached;
+    std::shared_ptr<Impl> _impl;
 };
 
 } //namespace Pothos
@@ -17,7 +17,11 @@
 #include <Pothos/Framework/BufferAccumulator.hpp>
 #include <Pothos/Util/RingDeque.hpp>
 #include <Pothos/Util/SpinLock.hpp>
+#include <Pothos/Util/SpscQueue.hpp>
+#include <Pothos/Util/BoundedQueue.hpp>
 #include <string>
+#include <vector>
+#include <atomic>
 
 namespace Pothos {
 
@@ -152,6 +156,29 @@ public:
      */
     void setReserve(const size_t numElements);
 
+    /*!
+     * Set the capacity and overflow policy of the message queues.
+     * The asynchronous messages and the slot calls of this port
+     * are held in bounded lock-free queues of the given capacity.
+     * The overflow policy selects what happens when a queue is full:
+     *  - "DROP_NEWEST" - the new message is dropped (the default)
+     *  - "DROP_OLDEST" - the oldest message in the queue is dropped
+     *  - "BLOCK" - upstream blocks are not scheduled while the queue is full,
+     *    like when their message tokens are exhausted.
+     *    This only holds back the next work call of the upstream block:
+     *    messages posted in one work call beyond the free space,
+     *    and slot calls from outside of a block, are dropped as the newest.
+     *    Do not use it in a feedback loop of messages,
+     *    where each block would wait on the full queue of the other.
+     * Dropped messages are counted in the port stats.
+     * Call this method before the block is connected in a topology,
+     * because any enqueued messages are dropped by the change.
+     * \param capacity the capacity (rounds up to a power of two)
+     * \param overflowPolicy the name of the overflow policy
+     * \throws PortAccessError for an unknown policy or zero capacity
+     */
+    void setMessageQueue(const size_t capacity, const std::string &overflowPolicy = "DROP_NEWEST");
+
     /*!
      * Is this port used for signal handling in a signals + slots paradigm?
      */
@@ -215,16 +242,51 @@ private:
     //counts work actions which we will use to establish activity
     size_t _workEvents;
 
-    Util::SpinLock _asyncMessagesLock;
-    Util::RingDeque<std::pair<Object, BufferChunk>> _asyncMessages;
+    //messages with the upstream token that is held until the message is popped
+    typedef Util::BoundedQueue<std::pair<Object, BufferChunk>> MessageQueue;
+    enum MessageOverflowPolicy
+    {
+        MESSAGE_OVERFLOW_BLOCK,
+        MESSAGE_OVERFLOW_DROP_OLDEST,
+        MESSAGE_OVERFLOW_DROP_NEWEST,
+    };
+    MessageOverflowPolicy _messageOverflowPolicy;
+    std::atomic<unsigned long long> _droppedMessages;
 
-    Util::SpinLock _slotCallsLock;
-    Util::RingDeque<std::pair<Object, BufferChunk>> _slotCalls;
+    MessageQueue _asyncMessages;
+    Util::SpinLock _peekedMessageLock;
+    std::pair<Object, BufferChunk> _peekedMessage;
+    bool _hasPeekedMessage;
 
-    std::vector<Label> _inlineMessages; //user api structure
-    Util::RingDeque<Label> _inputInlineMessages; //shared structure
+    MessageQueue _slotCalls;
 
+    std::vector<Label> _inlineMessages; //user api structure
+    Util::RingDeque<Label> _inputInlineMessages; //labels in bytes from the accumulator front
+
+    //! buffers and labels handed off to the accumulator in a batch
+    struct BufferLabelBatch
+    {
+        BufferLabelBatch(void): sequence(0), absoluteLabels(false){}
+        unsigned long long sequence;
+        bool absoluteLabels; //label index is from the accumulator front
+        std::vector<Label> labels;
+        std::vector<BufferChunk> buffers;
+    };
+
+    //lock-free handoff from the only subscribed output port
+    std::atomic<const OutputPort *> _handoffProducer;
+    std::atomic<size_t> _handoffPushers;
+    std::atomic<unsigned long long> _handoffSequence;
+    Util::SpscQueue<BufferLabelBatch> _handoffQueue;
+
+    //locked handoff for fan-in and external pushes,
+    //the lock also serializes the consumers of the handoff queue
     Util::SpinLock _bufferAccumulatorLock;
+    Util::RingDeque<BufferLabelBatch> _stagedBatches;
+    std::atomic<size_t> _numStagedBatches;
+
+    //the lock-free producer never touches the accumulator,
+    //so the lock is uncontended unless clear() is called externally
     BufferAccumulator _bufferAccumulator;
 
     std::vector<OutputPort *> _subscribers;
@@ -235,6 +297,10 @@ private:
     Object asyncMessagesPop(void);
     Object asyncMessagesPeek(void);
     void asyncMessagesClear(void);
+    bool messagesBlocked(void) const;
+    bool messageQueuePush(MessageQueue &queue, const std::pair<Object, BufferChunk> &entry);
+    bool messageQueuePop(MessageQueue &queue, std::pair<Object, BufferChunk> &entry);
+    void messageDropped(void);
 
     /////// slot call interface /////////
     void slotCallsPush(const Object &args, const BufferChunk &token);
@@ -257,7 +323,12 @@ private:
     /////// combined label association push /////////
     void bufferLabelPush(
         const std::vector<Label> &postedLabels,
-        const Util::RingDeque<BufferChunk> &postedBuffers);
+        const Util::RingDeque<BufferChunk> &postedBuffers,
+        const OutputPort *producer = nullptr);
+    void bufferLabelStage(BufferLabelBatch &batch);
+    void setHandoffProducer(const OutputPort *producer);
+    void bufferLabelApply(BufferLabelBatch &batch);
+    void bufferLabelDrainNoLock(void);
 
     InputPort(void);
     InputPort(const InputPort &){} // non construction-copyable
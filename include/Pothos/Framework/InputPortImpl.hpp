@@ -120,31 +120,44 @@ inline void Pothos::InputPort::setReserve(const size_t numElements)
 
 inline bool Pothos::InputPort::asyncMessagesEmpty(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_asyncMessagesLock);
-    return _asyncMessages.empty();
+    std::lock_guard<Util::SpinLock> lock(_peekedMessageLock);
+    return not _hasPeekedMessage and _asyncMessages.empty();
 }
 
 inline Pothos::Object Pothos::InputPort::asyncMessagesPop(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_asyncMessagesLock);
-    if (_asyncMessages.empty()) return Pothos::Object();
-    auto msg = _asyncMessages.front().first;
-    _asyncMessages.pop_front();
-    return msg;
+    std::pair<Object, BufferChunk> entry;
+    std::lock_guard<Util::SpinLock> lock(_peekedMessageLock);
+    if (_hasPeekedMessage)
+    {
+        entry = std::move(_peekedMessage);
+        _peekedMessage = std::pair<Object, BufferChunk>();
+        _hasPeekedMessage = false;
+    }
+    else if (not this->messageQueuePop(_asyncMessages, entry)) return Pothos::Object();
+    return entry.first;
 }
 
 inline Pothos::Object Pothos::InputPort::asyncMessagesPeek(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_asyncMessagesLock);
-    if (_asyncMessages.empty()) return Pothos::Object();
-    return _asyncMessages.front().first;
+    //the peeked message is held aside, so it cannot be dropped as the oldest
+    std::lock_guard<Util::SpinLock> lock(_peekedMessageLock);
+    if (not _hasPeekedMessage) _hasPeekedMessage = this->messageQueuePop(_asyncMessages, _peekedMessage);
+    if (not _hasPeekedMessage) return Pothos::Object();
+    return _peekedMessage.first;
+}
+
+inline bool Pothos::InputPort::messagesBlocked(void) const
+{
+    return _messageOverflowPolicy == MESSAGE_OVERFLOW_BLOCK and (_asyncMessages.full() or _slotCalls.full());
 }
 
 inline void Pothos::InputPort::inlineMessagesPush(const Pothos::Label &label)
 {
-    std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
-    if (_inputInlineMessages.full()) _inputInlineMessages.set_capacity(_inputInlineMessages.capacity()*2);
-    _inputInlineMessages.push_back(label);
+    BufferLabelBatch batch;
+    batch.absoluteLabels = true;
+    batch.labels.push_back(label);
+    this->bufferLabelStage(batch);
 }
 
 inline void Pothos::InputPort::inlineMessagesClear(void)
@@ -157,6 +170,7 @@ inline void Pothos::InputPort::inlineMessagesClear(void)
 inline void Pothos::InputPort::bufferAccumulatorFront(Pothos::BufferChunk &buff)
 {
     std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
+    this->bufferLabelDrainNoLock();
     while (not _inputInlineMessages.empty())
     {
         const auto &front = _inputInlineMessages.front();
@@ -168,18 +182,21 @@ inline void Pothos::InputPort::bufferAccumulatorFront(Pothos::BufferChunk &buff)
 
 inline void Pothos::InputPort::bufferAccumulatorPush(const BufferChunk &buffer)
 {
-    std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
-    this->bufferAccumulatorPushNoLock(buffer);
+    BufferLabelBatch batch;
+    batch.buffers.push_back(buffer);
+    this->bufferLabelStage(batch);
 }
 
 inline void Pothos::InputPort::bufferAccumulatorRequire(const size_t numBytes)
 {
     std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
+    this->bufferLabelDrainNoLock();
     _bufferAccumulator.require(numBytes);
 }
 
 inline void Pothos::InputPort::bufferAccumulatorClear(void)
 {
     std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
-    _bufferAccumulator = BufferAccumulator();
+    this->bufferLabelDrainNoLock();
+    _bufferAccumulator.clear(); //keeps the reserved queue
 }
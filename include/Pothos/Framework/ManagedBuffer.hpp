@@ -136,6 +136,12 @@ struct Pothos::ManagedBuffer::Impl
 {
     Impl(void);
 
+    //! Take an Impl from the pool, which recycles released Impls
+    static Impl *make(void);
+
+    //! Return this Impl to the pool when there is no manager
+    void recycle(void);
+
     std::atomic<int> counter;
     std::weak_ptr<BufferManager> weakManager;
     SharedBuffer buffer;
@@ -11,9 +11,13 @@
 #pragma once
 #include <Pothos/Config.hpp>
 #include <memory> //shared_ptr
+#include <string>
 
 namespace Pothos {
 
+class SharedBufferArena;
+class BufferPool;
+
 /*!
  * The SharedBuffer represents the combination of address and length,
  * and a shared pointer that will automatically cleanup the memory.
@@ -31,12 +35,34 @@ public:
      * When the SharedBuffer is deleted, the memory will be freed as well.
      * The node affinity is used to allocate physical memory on a NUMA node.
      *
+     * Small buffers come from a thread-caching arena per NUMA node,
+     * which reuses freed memory without locking or using the heap.
+     * Without a node affinity, the arena of the calling thread's node is used.
+     *
      * \param numBytes the number of bytes to allocate in this buffer
      * \param nodeAffinity which NUMA node to allocate on (-1 for dont care)
      * \return a new shared buffer object
      */
     static SharedBuffer make(const size_t numBytes, const long nodeAffinity = -1);
 
+    /*!
+     * Create a SharedBuffer given a length in bytes and a huge page mode.
+     * The huge page modes are:
+     *  - "NONE" - the same allocation as make() without a mode
+     *  - "TRANSPARENT" - an aligned mapping advised for transparent huge pages
+     *  - "HUGETLB" - a mapping from the reserved huge page pool,
+     *    which falls back to "TRANSPARENT" when the pool is exhausted
+     * The allocation falls back to regular pages when huge pages
+     * are not available; getBacking() reports what was allocated.
+     *
+     * \throws SharedBufferError for an unknown huge page mode
+     * \param numBytes the number of bytes to allocate in this buffer
+     * \param nodeAffinity which NUMA node to allocate on (-1 for dont care)
+     * \param hugePages the huge page mode
+     * \return a new shared buffer object
+     */
+    static SharedBuffer make(const size_t numBytes, const long nodeAffinity, const std::string &hugePages);
+
     /*!
      * Create a circular SharedBuffer given a length in bytes.
      * The rules for the circular or double mapping are as follows:
@@ -44,7 +70,8 @@ public:
      *
      * This factory allocates memory which is held by the SharedBuffer.
      * When the SharedBuffer is deleted, the memory will be freed as well.
-     * The node affinity is used to allocate physical memory on a NUMA node.
+     * The node affinity is used to allocate physical memory on a NUMA node,
+     * and the pages are placed on the node when the buffer is made.
      *
      * \param numBytes the number of bytes to allocate in this buffer
      * \param nodeAffinity which NUMA node to allocate on (-1 for dont care)
@@ -52,6 +79,29 @@ public:
      */
     static SharedBuffer makeCirc(const size_t numBytes, const long nodeAffinity = -1);
 
+    /*!
+     * Create a circular SharedBuffer given a length in bytes and a huge page mode.
+     * The huge page modes are the same as make(), and the length is
+     * rounded up to the huge page size when huge pages are allocated.
+     * The allocation falls back to regular pages when huge pages
+     * are not available; getBacking() reports what was allocated.
+     *
+     * \throws SharedBufferError for an unknown huge page mode
+     * \param numBytes the number of bytes to allocate in this buffer
+     * \param nodeAffinity which NUMA node to allocate on (-1 for dont care)
+     * \param hugePages the huge page mode
+     * \return a new circular shared buffer object
+     */
+    static SharedBuffer makeCirc(const size_t numBytes, const long nodeAffinity, const std::string &hugePages);
+
+    /*!
+     * Query the stats of the allocation arenas used by make().
+     * The result is a JSON array with an object per NUMA node arena:
+     * "nodeAffinity", "bytesInUse", "highWaterBytes", and "slabBytes".
+     * \return the stats as a JSON formatted string
+     */
+    static std::string queryArenaStats(void);
+
     /*!
      * Create a SharedBuffer from address, length, and the container.
      * The container is any object that can be put into a shared_ptr.
@@ -89,6 +139,15 @@ public:
      */
     size_t getEnd(void) const;
 
+    /*!
+     * Get the name of the memory which backs this buffer.
+     * Buffers from the factories report one of the following:
+     * "ARENA", "HEAP", "NUMA", "TRANSPARENT", "HUGETLB", "MEMFD", "FILE", or "VIRTUAL".
+     * Sub-buffers report the backing of their parent buffer.
+     * \return the backing name, or empty for a user container
+     */
+    std::string getBacking(void) const;
+
     /*!
      * Is this instance of this shared buffer unique?
      * \return true if this is the only copy
@@ -111,10 +170,15 @@ public:
     const std::shared_ptr<void> &getContainer(void) const;
 
 private:
-    static SharedBuffer makeCircUnprotected(const size_t numBytes, const long nodeAffinity);
+    friend class SharedBufferArena;
+    friend class BufferPool;
+    static SharedBuffer makeSystem(const size_t numBytes, const long nodeAffinity);
+    static SharedBuffer makeHugePages(const size_t numBytes, const long nodeAffinity, const bool hugetlb);
+    static SharedBuffer makeCircUnprotected(const size_t numBytes, const long nodeAffinity, const std::string &hugePages);
     size_t _address;
     size_t _length;
     size_t _alias;
+    const char *_backing;
     std::shared_ptr<void> _container;
 };
 
@@ -146,6 +210,11 @@ inline size_t Pothos::SharedBuffer::getEnd(void) const
     return _address + _length;
 }
 
+inline std::string Pothos::SharedBuffer::getBacking(void) const
+{
+    return (_backing == nullptr)?"":_backing;
+}
+
 inline bool Pothos::SharedBuffer::unique(void) const
 {
     return _container.unique();
@@ -41,7 +41,18 @@ public:
      *     "priority" : 0.5,
      *     "affinityMode" : "CPU",
      *     "affinity" : [0, 2, 4, 6],
-     *     "yieldMode" : "SPIN"
+     *     "yieldMode" : "HYBRID",
+     *     "spinBudgetNs" : 10000,
+     *     "yieldBudgetNs" : 100000,
+     *     "schedulerMode" : "STEALING",
+     *     "workQuantum" : 8,
+     *     "workQuantumNs" : 50000,
+     *     "minThreads" : 1,
+     *     "maxThreads" : 8,
+     *     "utilizationLow" : 0.3,
+     *     "utilizationHigh" : 0.8,
+     *     "elasticPeriodNs" : 100000000,
+     *     "profile" : "REALTIME"
      * }
      * \endcode
      * \param json a JSON object markup string
@@ -85,12 +96,130 @@ public:
      * The yieldMode specifies the internal threading mechanisms:
      * 
      *  - "CONDITION" - Threads wait on condition variables when no work is available.
-     *  - "HYBRID" - Threads spin for a while, then yield to other threads, when no work is available.
+     *  - "HYBRID" - Threads spin for a while, then yield to other threads,
+     *    and then wait on condition variables when no work is available.
      *  - "SPIN" - Threads busy-wait, without yielding, when no work is available.
      *
      * The default is "CONDITION".
      */
     std::string yieldMode;
+
+    /*!
+     * The maximum time in nanoseconds that a thread spins
+     * when no work is available in the "HYBRID" yieldMode.
+     * The actual spin time adapts to the recently observed
+     * time between running out of work and receiving work.
+     *
+     * The default is 10000 (10 microseconds).
+     */
+    long long spinBudgetNs;
+
+    /*!
+     * The maximum time in nanoseconds that a thread yields
+     * after spinning in the "HYBRID" yieldMode and before
+     * waiting on a condition variable for available work.
+     * The actual yield time adapts like the spin time.
+     *
+     * The default is 100000 (100 microseconds).
+     */
+    long long yieldBudgetNs;
+
+    /*!
+     * The schedulerMode specifies how pool threads select blocks.
+     * Only blocks with pending changes are queued for processing:
+     *
+     *  - "ROUND_ROBIN" - Threads share one queue of ready blocks.
+     *  - "STEALING" - Each thread has its own queue of ready blocks,
+     *    and steals blocks from the other threads when idle.
+     *
+     * The schedulerMode has no effect in thread-per-block mode.
+     * The default is "ROUND_ROBIN".
+     */
+    std::string schedulerMode;
+
+    /*!
+     * The maximum number of back-to-back work() calls
+     * that a thread performs on a block before moving on.
+     * A block stays with the thread while each call
+     * produces or consumes resources, so its data stays cache-hot.
+     * The loop also ends when an external call is pending.
+     *
+     * The default is 1 (one work() call per dispatch).
+     */
+    size_t workQuantum;
+
+    /*!
+     * The maximum time in nanoseconds that a thread spends
+     * in back-to-back work() calls on a block before moving on.
+     * The loop ends at whichever of the workQuantum and
+     * workQuantumNs limits is reached first.
+     *
+     * The default is 0 (no time limit).
+     */
+    long long workQuantumNs;
+
+    /*!
+     * The minimum number of threads in elastic mode.
+     * The pool never retires threads below this count.
+     *
+     * The default is 0 (at least one thread is kept).
+     */
+    size_t minThreads;
+
+    /*!
+     * The maximum number of threads in elastic mode.
+     * A non-zero value enables elastic mode in pool mode:
+     * The pool starts with numThreads threads and measures
+     * the fraction of time that its threads spend in blocks.
+     * A thread is added when the utilization is above the band,
+     * and a thread is retired when it is below the band.
+     *
+     * The default is 0 (elastic mode disabled).
+     */
+    size_t maxThreads;
+
+    /*!
+     * The lower bound of the target utilization band in elastic mode.
+     * The value is a fraction of the time in range 0.0 to 1.0.
+     *
+     * The default is 0.3.
+     */
+    double utilizationLow;
+
+    /*!
+     * The upper bound of the target utilization band in elastic mode.
+     * The value is a fraction of the time in range 0.0 to 1.0.
+     *
+     * The default is 0.8.
+     */
+    double utilizationHigh;
+
+    /*!
+     * The period in nanoseconds between utilization samples
+     * in elastic mode. The pool adds or retires at most
+     * one thread per period to avoid oscillation.
+     *
+     * The default is 100000000 (100 milliseconds).
+     */
+    long long elasticPeriodNs;
+
+    /*!
+     * The execution profile for latency-critical pools:
+     *
+     *  - "" - no additional setup (default)
+     *  - "REALTIME" - The process memory is locked with mlockall()
+     *    while any realtime pool exists. The memory lock is process-wide:
+     *    the last realtime pool to be destroyed calls munlockall(),
+     *    which also releases memory locks made by the application.
+     *    The buffers of the blocks in this pool are pre-faulted
+     *    and the port queues are pre-sized when the blocks activate,
+     *    so that the stream does not stall on page faults
+     *    or on queue reallocations. The thread scheduling
+     *    still follows the priority setting.
+     *
+     * The default is "" (no profile).
+     */
+    std::string profile;
 };
 
 /*!
@@ -107,7 +236,11 @@ public:
  *    dedicated thread spawned explicitly for its execution alone.
  *
  *  - Positive values for numThreads indicate pool-mode where a
- *    fixed number of threads operate on the blocks in a round-robin fashion.
+ *    fixed number of threads operate on the blocks which are ready,
+ *    in a round-robin fashion or with work-stealing between threads
+ *    depending upon the schedulerMode setting.
+ *    In elastic mode (see ThreadPoolArgs::maxThreads), the number
+ *    of threads follows the measured utilization of the pool.
  *    The thread pool will never spawn more threads than there are blocks.
  */
 class POTHOS_API ThreadPool
@@ -54,6 +54,11 @@ public:
      * The special thread pool with empty name "" will apply
      * to all blocks that do not specify the "threadPool" key.
      *
+     * The "autoPlacement" field is an optional boolean
+     * to enable automatic NUMA placement, see setAutoPlacement().
+     * The "autoFusion" field is an optional boolean
+     * to enable fusion of linear block chains, see setAutoFusion().
+     *
      * <h3>Global variables</h3>
      * The "globals" field is an optional JSON array
      * where each entry is an object containing a variable name
@@ -71,6 +76,17 @@ public:
      * - The "calls" is a list of ordered method calls.
      *   Each specified by the call name then arguments.
      * - The "threadPool" specifies an optional thread pool by name
+     * - The "affinity" specifies an optional placement hint list
+     *   of CPUs or NUMA nodes, see Block::setThreadAffinity().
+     * - The "affinityMode" is the mode of the placement hint,
+     *   either "CPU" or "NUMA" (the default mode is "CPU").
+     * - The "schedulingClass" is an optional scheduling class,
+     *   "NORMAL", "HIGH", or "DEADLINE", see Block::setSchedulingClass().
+     * - The "deadlineNs" and "periodNs" specify the deadline
+     *   of the "DEADLINE" class, see Block::setDeadline().
+     * - The "replicas" specifies an optional number of replicas,
+     *   and "frameSize" the size of each frame in elements,
+     *   see setReplication().
      *
      * <h3>Connections</h3>
      * The "connections" field is an array of JSON arrays,
@@ -106,6 +122,8 @@ public:
      * Example JSON markup for a topology description:
      * \code {.json}
      * {
+     *     "autoPlacement" : true,
+     *     "autoFusion" : true,
      *     "threadPools" : {
      *         "default" : {"priority" : 0.5},
      *         "myPool0" : {"yieldMode" : "SPIN"}
@@ -128,6 +146,8 @@ public:
      *             "id" : "id1",
      *             "path" : "/blocks/bar",
      *             "threadPool" : "myPool0",
+     *             "affinityMode" : "CPU",
+     *             "affinity" : [2, 3],
      *             "args" : [],
      *             "calls" : [
      *                 ["setBar", "OK"],
@@ -160,6 +180,64 @@ public:
     //! Get the thread pool used by all blocks in this topology.
     const ThreadPool &getThreadPool(void) const;
 
+    /*!
+     * Enable automatic NUMA placement of blocks in commit().
+     * Connected blocks are assigned to the same NUMA node when possible,
+     * and each assigned block allocates its buffers on its node
+     * with BufferManagerArgs::nodeAffinity. The pool threads
+     * are divided among the nodes, and the task of each assigned
+     * block is shared by the pool threads of its node.
+     * The thread placement hints of the blocks are not changed.
+     * Blocks with a placement hint keep the node of the hint.
+     * Disabling placement clears the assigned nodes on commit().
+     * Placement only applies to blocks in the local process,
+     * and only on systems with more than one NUMA node.
+     * The default is disabled.
+     */
+    void setAutoPlacement(const bool enable);
+
+    //! Is automatic NUMA placement enabled for commit()?
+    bool getAutoPlacement(void) const;
+
+    /*!
+     * Enable automatic fusion of linear block chains in commit().
+     * A linear chain is a sequence of blocks in the local process
+     * where each block has exactly one output connection,
+     * to the next block which has exactly one input connection,
+     * both ports are in the same domain, and every block
+     * in the chain shares the same thread pool and hints.
+     * The blocks of a fused chain are processed in order
+     * by a single task on the same thread, so that each block
+     * consumes the buffers of the previous block from the cache.
+     * The fused chains are reported by queryJSONStats().
+     * The default is disabled.
+     */
+    void setAutoFusion(const bool enable);
+
+    //! Is automatic fusion of linear block chains enabled for commit()?
+    bool getAutoFusion(void) const;
+
+    /*!
+     * Replicate a data-parallel block across the thread pool in commit().
+     * The block must opt into replication, see Block::replicate().
+     * The commit replaces the block with a splitter, the replicas,
+     * and a merger: the splitter deals the input frames round-robin
+     * to the replicas, and the merger reassembles the output frames
+     * in the original order, so that the output stream and labels
+     * are the same as if the block processed the input alone.
+     * The output of each frame is complete when the replica
+     * consumed the whole frame, so replicas may change the rate.
+     * The replicas share the thread pool and scheduling class of the block.
+     * \param block the block to replicate (in this process)
+     * \param numReplicas the number of replicas, 1 to disable
+     * \param frameSize the frame size in input elements,
+     *        or 0 to deal all available input as a frame
+     */
+    void setReplication(const Object &block, const size_t numReplicas, const size_t frameSize = 0);
+
+    //! Get the number of replicas for a block (1 when not replicated)
+    size_t getReplication(const Object &block) const;
+
     /*!
      * Get a vector of info about all of the input ports available.
      */
@@ -249,6 +327,8 @@ public:
 
     /*!
      * Query performance statistics for all blocks in the topology.
+     * The blocks of a fused chain (see setAutoFusion()) list
+     * the IDs of the blocks in the chain under "fusedChain".
      *
      * Example JSON markup for stats reporting:
      * (The actual stats markup has many more fields.)
@@ -257,6 +337,7 @@ public:
      *     "unique_id_of_blockA" : {
      *         "blockName" : "blockA",
      *         "numWorkCalls" : 12345,
+     *         "fusedChain" : ["unique_id_of_blockA", "unique_id_of_blockB"],
      *         "outputStats" : [
      *              {"portName" : "0", totalElements : 42},
      *         ]
@@ -264,9 +345,9 @@ public:
      *     "unique_id_of_blockB" : {
      *         "blockName" : "blockB",
      *         "numWorkCalls" : 6789,
+     *         "fusedChain" : ["unique_id_of_blockA", "unique_id_of_blockB"],
      *         "inputStats" : [
-     *              {"portName" : "0", totalElements : 0},
-     *              {"portName" : "1", totalElements : 100}
+     *              {"portName" : "0", totalElements : 42}
      *         ]
      *     }
      * }
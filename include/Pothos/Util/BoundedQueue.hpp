@@ -0,0 +1,210 @@
+///
+/// \file Util/BoundedQueue.hpp
+///
+/// A bounded lock-free multi-producer queue.
+///
+/// \copyright
+/// Copyright (c) 2016-2016 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <cstdlib> //size_t
+#include <cstddef> //ptrdiff_t
+#include <utility> //forward, move
+#include <atomic>
+
+namespace Pothos {
+namespace Util {
+
+/*!
+ * BoundedQueue is a lock-free queue with a fixed capacity.
+ * Any number of threads may push, and pop is also safe from any thread,
+ * so that a producer can drop the oldest element to make room.
+ * Each cell has a sequence number which tells the producers
+ * and consumers when the cell is free or holds an element,
+ * so neither side takes a lock, and a full queue fails the push.
+ * The cells are allocated on the first push, so that a port
+ * which never receives an element does not hold the memory.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    //! Construct a new queue -- capacity rounds up to a power of two
+    BoundedQueue(const size_t capacity = 1024);
+
+    //! Destroy the queue and any remaining elements
+    ~BoundedQueue(void);
+
+    //! Push an element onto the back, false when full
+    template <typename U>
+    bool push(U &&elem);
+
+    //! Pop an element from the front, false when empty
+    bool pop(T &elem);
+
+    //! Is the queue empty? -- no element is ready at the front
+    bool empty(void) const;
+
+    //! Is the queue full? -- approximate under contention
+    bool full(void) const;
+
+    //! How many elements are in the queue -- approximate under contention
+    size_t size(void) const;
+
+    //! How many elements can be stored?
+    size_t capacity(void) const;
+
+    //! Allocate the cells now rather than on the first push
+    void allocate(void);
+
+    //! Change the capacity and drop all elements -- not thread-safe
+    void reset(const size_t capacity);
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    Cell *cells(void);
+    size_t _mask;
+    std::atomic<Cell *> _cells;
+    char _pad0[64];
+    std::atomic<size_t> _head; //pop position
+    char _pad1[64];
+    std::atomic<size_t> _tail; //push position
+    char _pad2[64];
+    BoundedQueue(const BoundedQueue &){} // non construction-copyable
+    BoundedQueue &operator=(const BoundedQueue &){return *this;} // non copyable
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(const size_t capacity):
+    _mask(0),
+    _cells(nullptr),
+    _head(0),
+    _tail(0)
+{
+    this->reset(capacity);
+}
+
+template <typename T>
+BoundedQueue<T>::~BoundedQueue(void)
+{
+    delete [] _cells.load();
+}
+
+template <typename T>
+typename BoundedQueue<T>::Cell *BoundedQueue<T>::cells(void)
+{
+    auto cells = _cells.load(std::memory_order_acquire);
+    if (cells != nullptr) return cells;
+
+    //the first producer installs the cells, the others delete their copy
+    auto newCells = new Cell[_mask+1];
+    for (size_t i = 0; i <= _mask; i++) newCells[i].sequence.store(i, std::memory_order_relaxed);
+    if (_cells.compare_exchange_strong(cells, newCells, std::memory_order_acq_rel)) return newCells;
+    delete [] newCells;
+    return cells;
+}
+
+template <typename T>
+template <typename U>
+bool BoundedQueue<T>::push(U &&elem)
+{
+    auto cells = this->cells();
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+    while (true)
+    {
+        cell = cells + (pos & _mask);
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+        if (diff == 0)
+        {
+            if (_tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false; //full
+        else pos = _tail.load(std::memory_order_relaxed);
+    }
+    cell->data = std::forward<U>(elem);
+    cell->sequence.store(pos+1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T &elem)
+{
+    auto cells = _cells.load(std::memory_order_acquire);
+    if (cells == nullptr) return false;
+    size_t pos = _head.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+    while (true)
+    {
+        cell = cells + (pos & _mask);
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos+1);
+        if (diff == 0)
+        {
+            if (_head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) return false; //empty
+        else pos = _head.load(std::memory_order_relaxed);
+    }
+    elem = std::move(cell->data);
+    cell->data = T(); //release resources held by the cell
+    cell->sequence.store(pos+_mask+1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::empty(void) const
+{
+    auto cells = _cells.load(std::memory_order_acquire);
+    if (cells == nullptr) return true;
+    const size_t pos = _head.load(std::memory_order_acquire);
+    return cells[pos & _mask].sequence.load(std::memory_order_acquire) != pos+1;
+}
+
+template <typename T>
+bool BoundedQueue<T>::full(void) const
+{
+    return this->size() >= this->capacity();
+}
+
+template <typename T>
+size_t BoundedQueue<T>::size(void) const
+{
+    const size_t head = _head.load(std::memory_order_acquire);
+    const size_t tail = _tail.load(std::memory_order_acquire);
+    return (tail > head)?(tail - head):0;
+}
+
+template <typename T>
+size_t BoundedQueue<T>::capacity(void) const
+{
+    return _mask+1;
+}
+
+template <typename T>
+void BoundedQueue<T>::allocate(void)
+{
+    this->cells();
+}
+
+template <typename T>
+void BoundedQueue<T>::reset(const size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    delete [] _cells.exchange(nullptr);
+    _mask = size-1;
+    _head.store(0);
+    _tail.store(0);
+}
+
+} //namespace Util
+} //namespace Pothos
@@ -0,0 +1,134 @@
+///
+/// \file Util/SpscQueue.hpp
+///
+/// A bounded lock-free single-producer single-consumer queue.
+///
+/// \copyright
+/// Copyright (c) 2016-2016 Josh Blum
+/// SPDX-License-Identifier: BSL-1.0
+///
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <cstdlib> //size_t
+#include <atomic>
+#include <vector>
+#include <cassert>
+
+namespace Pothos {
+namespace Util {
+
+/*!
+ * SpscQueue is a bounded queue for one producer and one consumer thread.
+ * The slots are allocated once at construction and reused in place:
+ * the producer fills the slot from back() and publishes it with push(),
+ * and the consumer reads the slot from front() and releases it with pop().
+ * Reusing the slots keeps the capacity of containers inside the elements,
+ * so the steady state neither locks nor allocates memory.
+ * The producer and consumer indexes are kept on separate cache lines.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    //! Construct a new queue -- capacity rounds up to a power of two
+    SpscQueue(const size_t capacity = 64);
+
+    //! Producer: get the next slot to fill, or nullptr when full
+    T *back(void);
+
+    //! Producer: publish the slot from back() to the consumer
+    void push(void);
+
+    //! Consumer: get the oldest published slot, or nullptr when empty
+    T *front(void);
+
+    //! Consumer: release the slot from front() to the producer
+    void pop(void);
+
+    //! Is the queue empty? -- only exact from the consumer
+    bool empty(void) const;
+
+    //! How many elements can be stored?
+    size_t capacity(void) const;
+
+private:
+    std::vector<T> _slots;
+    size_t _mask;
+    char _pad0[64];
+    std::atomic<size_t> _head; //consumer position
+    size_t _tailCache; //consumer's copy of the producer position
+    char _pad1[64];
+    std::atomic<size_t> _tail; //producer position
+    size_t _headCache; //producer's copy of the consumer position
+    char _pad2[64];
+};
+
+template <typename T>
+SpscQueue<T>::SpscQueue(const size_t capacity):
+    _mask(0),
+    _head(0),
+    _tailCache(0),
+    _tail(0),
+    _headCache(0)
+{
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    _slots.resize(size);
+    _mask = size-1;
+}
+
+template <typename T>
+T *SpscQueue<T>::back(void)
+{
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _headCache == _slots.size())
+    {
+        _headCache = _head.load(std::memory_order_acquire);
+        if (tail - _headCache == _slots.size()) return nullptr;
+    }
+    return &_slots[tail & _mask];
+}
+
+template <typename T>
+void SpscQueue<T>::push(void)
+{
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    assert(tail - _head.load(std::memory_order_relaxed) < _slots.size());
+    _tail.store(tail+1, std::memory_order_release);
+}
+
+template <typename T>
+T *SpscQueue<T>::front(void)
+{
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tailCache)
+    {
+        _tailCache = _tail.load(std::memory_order_acquire);
+        if (head == _tailCache) return nullptr;
+    }
+    return &_slots[head & _mask];
+}
+
+template <typename T>
+void SpscQueue<T>::pop(void)
+{
+    const size_t head = _head.load(std::memory_order_relaxed);
+    assert(head != _tail.load(std::memory_order_relaxed));
+    _head.store(head+1, std::memory_order_release);
+}
+
+template <typename T>
+bool SpscQueue<T>::empty(void) const
+{
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SpscQueue<T>::capacity(void) const
+{
+    return _slots.size();
+}
+
+} //namespace Util
+} //namespace Pothos
@@ -1,12 +1,13 @@
-// Copyright (c) 2015-2015 Josh Blum
+// Copyright (c) 2015-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include <Pothos/Config.hpp>
+#include "Framework/ThreadEnvironment.hpp"
+#include "Framework/EventCount.hpp"
 #include <atomic>
 #include <mutex>
 #include <thread>
-#include <condition_variable>
 
 /*!
  * The implementation of the exclusive access to the actor.
@@ -17,7 +18,10 @@ public:
 
     ActorInterface(void):
         _waitModeEnabled(true),
-        _externalAcquired(0)
+        _externalAcquired(0),
+        _readyTask(nullptr),
+        _readyNotifiers(0),
+        _fusedHead(nullptr)
     {
         _changeFlagged.test_and_set();
     }
@@ -36,9 +40,15 @@ public:
     //! Release external caller's exclusive access to the actor
     void externalCallRelease(void);
 
+    //! Is an external caller waiting for or holding exclusive access?
+    bool externalCallPending(void) const
+    {
+        return _externalAcquired.load(std::memory_order_relaxed) != 0;
+    }
+
     /*!
      * Acquire exclusive access to the actor context.
-     * \param waitEnabled true to enable CV waiting
+     * \param waitEnabled true to enable waiting for a change
      * \return true when acquired, false otherwise
      */
     bool workerThreadAcquire(const bool waitEnabled);
@@ -49,7 +59,8 @@ public:
     /*!
      * An external caller from outside the worker thread context
      * may use this to indicate that a state change has occurred.
-     * This call marks the change and wakes up a sleeping thread.
+     * This call marks the change and wakes up a sleeping thread,
+     * or notifies the ready queue of the thread environment.
      */
     void flagExternalChange(void);
 
@@ -66,19 +77,49 @@ public:
      */
     void wakeNoChange(void);
 
-    //! Enable or disable use of condition variables
+    //! Enable or disable waiting for changes in the worker thread
     void enableWaitMode(const bool enb)
     {
         _waitModeEnabled = enb;
     }
 
+    /*!
+     * Set the task data used to notify the ready queue of changes.
+     * This call blocks until notifications in progress complete,
+     * so that the previous task data can be safely unregistered.
+     * \param task the registered task data or null to disable
+     */
+    void setReadyTask(TaskData *task);
+
+    /*!
+     * Set the head actor of a fused chain which processes this actor.
+     * External changes are forwarded to the head so that it runs the chain.
+     * This call blocks until notifications in progress complete.
+     * \param head the head of the fused chain or null to disable
+     */
+    void setFusedHead(ActorInterface *head);
+
+    //! Get the head actor of the fused chain or null when not fused
+    ActorInterface *getFusedHead(void) const
+    {
+        return _fusedHead.load();
+    }
+
 private:
+    //! Notify the ready queue of the thread environment
+    void notifyReady(void);
+
+    //! Forward an external change to the head of the fused chain
+    void notifyFusedHead(void);
+
     bool _waitModeEnabled;
     std::atomic_flag _changeFlagged;
     std::atomic<size_t> _externalAcquired;
+    std::atomic<TaskData *> _readyTask;
+    std::atomic<size_t> _readyNotifiers;
+    std::atomic<ActorInterface *> _fusedHead;
     std::mutex _contextMutex;
-    std::mutex _acquireMutex;
-    std::condition_variable _cond;
+    EventCount _changeEvent;
 };
 
 /*!
@@ -131,19 +172,20 @@ inline bool ActorInterface::workerThreadAcquire(const bool waitEnabled)
         return true;
     }
 
-    //wait mode enabled -- lock and wait on condition variable
+    //wait mode enabled -- check again and wait on the event
     if (waitEnabled)
     {
-        std::unique_lock<std::mutex> lock(_acquireMutex);
-        if (not _changeFlagged.test_and_set(std::memory_order_acquire))
+        const auto key = _changeEvent.prepareWait();
+        if (not _changeFlagged.test_and_set())
         {
-           _contextMutex.lock();
+            _changeEvent.cancelWait();
+            _contextMutex.lock();
             return true;
         }
-        _cond.wait(lock);
+        _changeEvent.wait(key);
         if (not _changeFlagged.test_and_set(std::memory_order_acquire))
         {
-           _contextMutex.lock();
+            _contextMutex.lock();
             return true;
         }
         return false;
@@ -162,19 +204,53 @@ inline void ActorInterface::flagExternalChange(void)
     //asynchronous indication
     _changeFlagged.clear(std::memory_order_release);
 
+    //queue the task for a pool thread to process the change
+    if (_readyTask.load(std::memory_order_relaxed) != nullptr) this->notifyReady();
+
+    //a fused actor is processed by the task of the chain head
+    if (_fusedHead.load(std::memory_order_relaxed) != nullptr) this->notifyFusedHead();
+
     //wake a blocked thread to process the change
     if (_waitModeEnabled) this->wakeNoChange();
 }
 
-inline void ActorInterface::wakeNoChange(void)
+inline void ActorInterface::notifyReady(void)
 {
-    //if lock fails, the worker context is busy
-    if (not _contextMutex.try_lock()) return;
-    _contextMutex.unlock();
+    _readyNotifiers++;
+    auto task = _readyTask.load();
+    if (task != nullptr) task->environment->notifyReady(task);
+    _readyNotifiers--;
+}
+
+inline void ActorInterface::setReadyTask(TaskData *task)
+{
+    //wait for notifications which may use the previous task
+    _readyTask = task;
+    while (_readyNotifiers != 0) std::this_thread::yield();
+
+    //check the new task once for changes flagged before this call
+    if (task != nullptr) task->environment->notifyReady(task);
+}
 
-    //otherwise we need to notify the waiting cv
-    std::lock_guard<std::mutex> lock(_acquireMutex);
-    _cond.notify_one();
+inline void ActorInterface::notifyFusedHead(void)
+{
+    _readyNotifiers++;
+    auto head = _fusedHead.load();
+    if (head != nullptr) head->flagExternalChange();
+    _readyNotifiers--;
+}
+
+inline void ActorInterface::setFusedHead(ActorInterface *head)
+{
+    //wait for notifications which may use the previous head
+    _fusedHead = head;
+    while (_readyNotifiers != 0) std::this_thread::yield();
+}
+
+inline void ActorInterface::wakeNoChange(void)
+{
+    //only a waiting worker thread makes a system call
+    _changeEvent.notify();
 }
 
 inline void ActorInterface::flagInternalChange(void)
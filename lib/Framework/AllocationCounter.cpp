@@ -0,0 +1,39 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/AllocationCounter.hpp"
+
+#if defined(__linux__) && defined(__GNUC__)
+
+/***********************************************************************
+ * The counting is provided by the optional PothosAllocationCounter
+ * library (see AllocationCounterPreload.cpp), which replaces the global
+ * operator new when preloaded or linked into the application.
+ * The hook is a weak reference, so without the library it is null,
+ * and libPothos does not change the allocator of the process.
+ **********************************************************************/
+extern "C" void PothosSetThreadAllocationCounter(unsigned long long *counter) __attribute__((weak));
+
+void setThreadAllocationCounter(unsigned long long *counter)
+{
+    if (PothosSetThreadAllocationCounter != nullptr) PothosSetThreadAllocationCounter(counter);
+}
+
+bool hasAllocationCounter(void)
+{
+    return PothosSetThreadAllocationCounter != nullptr;
+}
+
+#else
+
+void setThreadAllocationCounter(unsigned long long *)
+{
+    return;
+}
+
+bool hasAllocationCounter(void)
+{
+    return false;
+}
+
+#endif //__linux__
@@ -0,0 +1,30 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+
+/*!
+ * Set the counter for heap allocations made by the calling thread.
+ * The replacement of the global operator new increments the counter,
+ * and a null counter disables counting on this thread (the default).
+ * Allocations are only counted when the PothosAllocationCounter
+ * library with the replacement is preloaded (Linux only).
+ */
+void setThreadAllocationCounter(unsigned long long *counter);
+
+//! Are allocations counted? (the counter library is loaded)
+bool hasAllocationCounter(void);
+
+//! Helper routine to count the allocations made within a scope
+struct AllocationAccumulator
+{
+    inline AllocationAccumulator(unsigned long long &count)
+    {
+        setThreadAllocationCounter(&count);
+    }
+    inline ~AllocationAccumulator(void)
+    {
+        setThreadAllocationCounter(nullptr);
+    }
+};
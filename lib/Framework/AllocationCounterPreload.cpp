@@ -0,0 +1,83 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <new>
+#include <cstdlib>
+
+/***********************************************************************
+ * Replacement of the global operator new and delete:
+ * This file is built as the separate PothosAllocationCounter library,
+ * which is opt-in because it replaces the allocator entry points
+ * for the whole process (and so conflicts with tcmalloc or ASan).
+ * Preload it with LD_PRELOAD or link it into the application,
+ * then the numWorkAllocations stat counts allocations in work().
+ *
+ * The allocations go to malloc() and free() like the default versions,
+ * and increment the counter of the calling thread when one is set.
+ **********************************************************************/
+static thread_local unsigned long long *threadAllocationCounter(nullptr);
+
+//! The hook which libPothos looks up as a weak symbol
+extern "C" void PothosSetThreadAllocationCounter(unsigned long long *counter)
+{
+    threadAllocationCounter = counter;
+}
+
+static void *countedAlloc(const std::size_t size)
+{
+    if (threadAllocationCounter != nullptr) (*threadAllocationCounter)++;
+    for (;;)
+    {
+        void *p = std::malloc(size == 0?1:size);
+        if (p != nullptr) return p;
+        auto handler = std::get_new_handler();
+        if (handler == nullptr) return nullptr;
+        handler();
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    void *p = countedAlloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    void *p = countedAlloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {return countedAlloc(size);}
+    catch (...) {return nullptr;}
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {return countedAlloc(size);}
+    catch (...) {return nullptr;}
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
@@ -4,6 +4,7 @@
 #include "Framework/WorkerActor.hpp"
 #include "Framework/ThreadEnvironment.hpp"
 #include <Pothos/Object/Containers.hpp>
+#include <Pothos/Framework/Exception.hpp>
 #include <Pothos/Framework/InputPortImpl.hpp>
 #include <Pothos/Framework/OutputPortImpl.hpp>
 #include <Poco/String.h>
@@ -15,26 +16,49 @@ void Pothos::Block::setThreadPool(const ThreadPool &newThreadPool)
 {
     if (_threadPool == newThreadPool) return; //no change
 
+    //a fused block is processed by the task of its chain head,
+    //so it is not registered with the thread pool on its own
+    const bool fused = _actor->getFusedHead() != nullptr;
+
     //unregister if the old thread pool is valid
-    if (_threadPool)
+    if (_threadPool and not fused)
     {
         auto threads = std::static_pointer_cast<ThreadEnvironment>(_threadPool.getContainer());
+        _actor->setReadyTask(nullptr);
         threads->unregisterTask(this);
     }
 
     //register if the new thread pool is valid
-    if (newThreadPool)
+    if (newThreadPool and not fused)
     {
         auto threads = std::static_pointer_cast<ThreadEnvironment>(newThreadPool.getContainer());
-        threads->registerTask(this,
-            std::bind(&Pothos::WorkerActor::processTask, _actor.get(), std::placeholders::_1),
-            std::bind(&Pothos::WorkerActor::wakeNoChange, _actor.get()));
 
         //configure the actor interface based on thread pool args
-        //all we support for now is the default (wait) or spin mode
+        //pool threads wait on the ready queue rather than the actor
         _actor->enableWaitMode(threads->isWaitingEnabled());
+        _actor->setWorkQuantum(threads->getArgs().workQuantum, threads->getArgs().workQuantumNs);
+
+        TaskHints hints;
+        hints.affinityMode = _threadAffinityMode;
+        hints.affinity = _threadAffinity;
+        hints.nodeAffinity = _actor->placementNode.load();
+        hints.schedulingClass = _schedulingClass;
+        hints.deadlineNs = (_deadlineNs == 0)?_periodNs:_deadlineNs;
+        hints.deadlineMissed = std::bind(&Pothos::WorkerActor::deadlineMissed, _actor.get());
+        hints.taskStolen = std::bind(&Pothos::WorkerActor::taskStolen, _actor.get());
+
+        auto task = threads->registerTask(this,
+            std::bind(&Pothos::WorkerActor::processFusedTask, _actor.get(), std::placeholders::_1),
+            std::bind(&Pothos::WorkerActor::wakeNoChange, _actor.get()),
+            hints);
+        _actor->setReadyTask(task);
     }
 
+    //the realtime profile and file descriptors also apply to the blocks of a fused chain
+    auto threads = std::static_pointer_cast<ThreadEnvironment>(newThreadPool.getContainer());
+    _actor->setRealtimeProfile(threads and threads->getArgs().profile == "REALTIME");
+    _actor->setDescriptorEnvironment(threads);
+
     //and save the reference to the new pool
     _threadPool = newThreadPool;
 }
@@ -44,10 +68,70 @@ const Pothos::ThreadPool &Pothos::Block::getThreadPool(void) const
     return _threadPool;
 }
 
+static void reregisterThreadPool(Pothos::Block &block)
+{
+    //re-register with the thread pool to apply new hints
+    const auto threadPool = block.getThreadPool();
+    if (not threadPool) return;
+    block.setThreadPool(Pothos::ThreadPool());
+    block.setThreadPool(threadPool);
+}
+
+void Pothos::Block::setThreadAffinity(const std::string &affinityMode, const std::vector<size_t> &affinity)
+{
+    //validate the placement hint
+    if (affinityMode == "ALL"){}
+    else if (affinityMode == "CPU"){}
+    else if (affinityMode == "NUMA"){}
+    else throw ThreadPoolError("Pothos::Block::setThreadAffinity()", "unknown affinityMode " + affinityMode);
+
+    _threadAffinityMode = (affinityMode == "ALL")?"":affinityMode;
+    _threadAffinity = (affinityMode == "ALL")?std::vector<size_t>():affinity;
+    reregisterThreadPool(*this);
+}
+
+const std::string &Pothos::Block::getThreadAffinityMode(void) const
+{
+    return _threadAffinityMode;
+}
+
+const std::vector<size_t> &Pothos::Block::getThreadAffinity(void) const
+{
+    return _threadAffinity;
+}
+
+void Pothos::Block::setSchedulingClass(const std::string &schedulingClass)
+{
+    //validate the scheduling class
+    if (schedulingClass == "NORMAL"){}
+    else if (schedulingClass == "HIGH"){}
+    else if (schedulingClass == "DEADLINE"){}
+    else throw ThreadPoolError("Pothos::Block::setSchedulingClass()", "unknown schedulingClass " + schedulingClass);
+
+    _schedulingClass = schedulingClass;
+    reregisterThreadPool(*this);
+}
+
+const std::string &Pothos::Block::getSchedulingClass(void) const
+{
+    return _schedulingClass;
+}
+
+void Pothos::Block::setDeadline(const long long deadlineNs, const long long periodNs)
+{
+    if (deadlineNs < 0 or periodNs < 0) throw ThreadPoolError("Pothos::Block::setDeadline()", "negative deadline or period");
+    _deadlineNs = deadlineNs;
+    _periodNs = periodNs;
+    reregisterThreadPool(*this);
+}
+
 /***********************************************************************
  * Block member implementation
  **********************************************************************/
 Pothos::Block::Block(void):
+    _schedulingClass("NORMAL"),
+    _deadlineNs(0),
+    _periodNs(0),
     _actor(new WorkerActor(this))
 {
     //set the default thread pool (registers)
@@ -233,6 +317,55 @@ void Pothos::Block::yield(void)
     _actor->flagInternalChange();
 }
 
+void Pothos::Block::yieldUntil(const std::chrono::steady_clock::time_point &when)
+{
+    //no thread pool to provide the timer service, just yield
+    if (not _threadPool) return this->yield();
+
+    //only schedule the timer when it is earlier than the pending timer,
+    //the pending timer calls work() first, which can yield again
+    const long long whenNs = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+    long long pendingNs = _actor->pendingWakeNs.load();
+    do
+    {
+        if (pendingNs != 0 and pendingNs <= whenNs) return;
+    } while (not _actor->pendingWakeNs.compare_exchange_weak(pendingNs, whenNs));
+
+    //the timer holds a weak reference in case the block is destroyed first
+    std::weak_ptr<WorkerActor> weakActor(_actor);
+    auto threads = std::static_pointer_cast<ThreadEnvironment>(_threadPool.getContainer());
+    threads->scheduleTimer(when, [weakActor, whenNs](void)
+    {
+        auto actor = weakActor.lock();
+        if (not actor) return;
+        long long expectedNs = whenNs;
+        actor->pendingWakeNs.compare_exchange_strong(expectedNs, 0);
+        actor->flagExternalChange();
+    });
+}
+
+void Pothos::Block::registerFileDescriptor(const int fd, const bool read, const bool write)
+{
+    if (fd < 0) throw ThreadPoolError("Pothos::Block::registerFileDescriptor()", "invalid file descriptor " + std::to_string(fd));
+    if (not read and not write) throw ThreadPoolError("Pothos::Block::registerFileDescriptor()", "no read or write interest");
+    _actor->registerDescriptor(fd, read, write);
+}
+
+void Pothos::Block::unregisterFileDescriptor(const int fd)
+{
+    _actor->unregisterDescriptor(fd);
+}
+
+std::shared_ptr<Pothos::Block> Pothos::Block::replicate(void)
+{
+    return std::shared_ptr<Block>(); //not replicable
+}
+
+void Pothos::Block::yieldFor(const long long delayNs)
+{
+    this->yieldUntil(std::chrono::steady_clock::now() + std::chrono::nanoseconds(delayNs));
+}
+
 std::shared_ptr<Pothos::BufferManager> Pothos::Block::getInputBufferManager(const std::string &, const std::string &)
 {
     return Pothos::BufferManager::Sptr(); //abdicate
@@ -290,6 +423,15 @@ static auto managedBlock = Pothos::ManagedClass()
     //all of the setups with default args set
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, setThreadPool))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, getThreadPool))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, setThreadAffinity))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, getThreadAffinityMode))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, getThreadAffinity))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, setSchedulingClass))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, getSchedulingClass))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, setDeadline))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, registerFileDescriptor))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, unregisterFileDescriptor))
+    .registerMethod("setDeadline", Pothos::Callable(&Pothos::Block::setDeadline).bind(0, 2))
     .registerMethod<Pothos::InputPort *, Pothos::Block, const std::string &, const Pothos::DType &, const std::string &>(POTHOS_FCN_TUPLE(Pothos::Block, setupInput))
     .registerMethod<Pothos::InputPort *, Pothos::Block, size_t, const Pothos::DType &, const std::string &>(POTHOS_FCN_TUPLE(Pothos::Block, setupInput))
     .registerMethod<Pothos::OutputPort *, Pothos::Block, const std::string &, const Pothos::DType &, const std::string &>(POTHOS_FCN_TUPLE(Pothos::Block, setupOutput))
@@ -319,6 +461,7 @@ static auto managedBlock = Pothos::ManagedClass()
     .registerMethod<Pothos::OutputPort *, Pothos::Block, const std::string &>(POTHOS_FCN_TUPLE(Pothos::Block, output))
     .registerMethod<Pothos::OutputPort *, Pothos::Block, size_t>(POTHOS_FCN_TUPLE(Pothos::Block, output))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, yield))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Block, yieldFor))
     .commit("Pothos/Block");
 
 template <typename PortType>
@@ -141,19 +141,21 @@ void Pothos::BufferAccumulator::pop(const size_t numBytes)
     //If we passed the boundary of the front buffer,
     //and the front-1 buffer is contiguous with front,
     //then we can move into the front-1 and pop front.
-    else if (queue.size() > 1)
+    //A front which wrapped into the alias of a circular buffer
+    //is contiguous with the alias address of the front-1 buffer.
+    //Repeat because the front may have passed several buffers,
+    //and each buffer passed is only released once it is popped.
+    else while (queue.size() > 1)
     {
         BufferChunk &f = queue[0];
         BufferChunk &b = queue[1];
         assert(b);
         assert(f);
         const bool fOverBounds = f.address >= (f.getBuffer().getEnd());
-        if (fOverBounds and f.getEnd() == b.address)
-        {
-            b.address -= f.length;
-            b.length += f.length;
-            queue.pop_front();
-        }
+        if (not fOverBounds or (f.getEnd() != b.address and f.getEnd() != b.getAlias())) break;
+        b.address -= f.length;
+        b.length += f.length;
+        queue.pop_front();
     }
 
     //clear the pool buffer state when the queue size shrinks
@@ -183,6 +185,14 @@ void Pothos::BufferAccumulator::require(const size_t numBytes)
     if (_bytesAvailable < numBytes and queue.size() == 1 and
         numBytes <= queue.front().getBuffer().getLength()) return;
 
+    //A circular buffer keeps growing contiguously as the ring wraps around,
+    //so wait for more bytes when the front holds all of the available bytes.
+    //The ring must fit the requirement and the partially consumed buffers
+    //at either end, with each buffer holding at least half of its length.
+    const auto &frontBuffer = queue.front().getBuffer();
+    if (_bytesAvailable < numBytes and _bytesAvailable == queue.front().length and frontBuffer.getAlias() != 0 and
+        2*(numBytes + frontBuffer.getLength()) <= frontBuffer.getAlias() - frontBuffer.getAddress()) return;
+
     //Actually this is ok: assert(not _inPoolBuffer);
     //The smaller pool buffer in front will be absorbed and popped.
 
@@ -225,6 +235,19 @@ void Pothos::BufferAccumulator::require(const size_t numBytes)
     queue.push_front(std::move(newBuffer));
 }
 
+/***********************************************************************
+ * BufferAccumulator Reserve implementation
+ **********************************************************************/
+void Pothos::BufferAccumulator::reserve(const size_t numBuffers, const size_t numBytes)
+{
+    if (_queue.capacity() < numBuffers) _queue.set_capacity(numBuffers);
+    if (numBytes == 0) return;
+
+    //the released buffer is cached in the pool for the next require()
+    auto buffer = _pool.get(numBytes);
+    std::memset(buffer.as<void *>(), 0, buffer.length);
+}
+
 /***********************************************************************
  * BufferAccumulator debug methods
  **********************************************************************/
@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2014 Josh Blum
+// Copyright (c) 2013-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/BufferManager.hpp>
@@ -10,7 +10,8 @@
 Pothos::BufferManagerArgs::BufferManagerArgs(void):
     numBuffers(4),
     bufferSize(8*1024),
-    nodeAffinity(-1)
+    nodeAffinity(-1),
+    hugePages("NONE")
 {
     return;
 }
@@ -2,38 +2,235 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/BufferPool.hpp>
+#include <atomic>
+#include <new> //operator new
+#include <utility> //move
 
 //! The default size of allocations until the client requests larger buffers
 static const size_t defaultSize = 8*1024;
 
-Pothos::BufferPool::BufferPool(void):
-    _minBuffSize(defaultSize)
+//! The size classes are powers of two starting with the default size
+static const size_t NumSizeClasses = 48;
+
+static size_t sizeToClass(const size_t numBytes)
+{
+    size_t sizeClass = 0;
+    while ((defaultSize << sizeClass) < numBytes) sizeClass++;
+    return sizeClass;
+}
+
+/***********************************************************************
+ * Pool state:
+ * Each size class has a private list which only the owner pops from,
+ * and a returned list which any thread pushes onto without locking.
+ * The owner takes the entire returned list when the private list is empty,
+ * so no thread ever pops a single entry from the shared list (no ABA).
+ * Free entries belong to the state, and outstanding entries hold a
+ * reference to the state, so releasing a buffer after the pool
+ * is destroyed still returns the entry to a valid state.
+ **********************************************************************/
+struct Pothos::BufferPool::Impl
+{
+    struct Entry
+    {
+        //space for the shared pointer control block, see Allocator
+        alignas(16) char control[32];
+        std::shared_ptr<Impl> impl;
+        Pothos::SharedBuffer buffer;
+        size_t sizeClass;
+        Entry *next;
+    };
+
+    Impl(const size_t maxCached):
+        maxCached(maxCached),
+        closed(false)
+    {
+        for (size_t i = 0; i < NumSizeClasses; i++)
+        {
+            cached[i] = nullptr;
+            returned[i] = nullptr;
+            numCached[i] = 0;
+        }
+    }
+
+    ~Impl(void)
+    {
+        this->drain();
+    }
+
+    //! Free all unused entries
+    void drain(void)
+    {
+        for (size_t i = 0; i < NumSizeClasses; i++)
+        {
+            deleteEntries(cached[i]);
+            cached[i] = nullptr;
+            deleteEntries(returned[i].exchange(nullptr, std::memory_order_acquire));
+        }
+    }
+
+    static void deleteEntries(Entry *entry)
+    {
+        while (entry != nullptr)
+        {
+            auto next = entry->next;
+            delete entry;
+            entry = next;
+        }
+    }
+
+    //! Owner: pop an unused entry or nullptr when empty
+    Entry *pop(const size_t sizeClass)
+    {
+        if (cached[sizeClass] == nullptr)
+        {
+            cached[sizeClass] = returned[sizeClass].exchange(nullptr, std::memory_order_acquire);
+            if (cached[sizeClass] == nullptr) return nullptr;
+        }
+        auto entry = cached[sizeClass];
+        cached[sizeClass] = entry->next;
+        numCached[sizeClass].fetch_sub(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    //! Any thread: return an entry when its last buffer copy is released
+    static void recycle(Entry *entry)
+    {
+        const auto impl = std::move(entry->impl);
+        const auto sizeClass = entry->sizeClass;
+        if (impl->closed.load() or impl->numCached[sizeClass].fetch_add(1, std::memory_order_relaxed) >= impl->maxCached)
+        {
+            if (not impl->closed.load()) impl->numCached[sizeClass].fetch_sub(1, std::memory_order_relaxed);
+            delete entry;
+            return;
+        }
+
+        auto &head = impl->returned[sizeClass];
+        entry->next = head.load(std::memory_order_relaxed);
+        while (not head.compare_exchange_weak(entry->next, entry, std::memory_order_release)){}
+    }
+
+    /*******************************************************************
+     * The allocator places the control block into the entry,
+     * and recycles the entry when the control block is deallocated.
+     * The deleter does nothing because the entry owns the memory.
+     ******************************************************************/
+    template <typename T>
+    struct Allocator
+    {
+        typedef T value_type;
+
+        Allocator(Entry *entry):
+            entry(entry)
+        {
+            return;
+        }
+
+        template <typename U>
+        Allocator(const Allocator<U> &other):
+            entry(other.entry)
+        {
+            return;
+        }
+
+        T *allocate(const size_t n)
+        {
+            //fall back to the heap when the control block does not fit
+            if (n*sizeof(T) <= sizeof(entry->control) and alignof(T) <= 16) return reinterpret_cast<T *>(entry->control);
+            return static_cast<T *>(::operator new(n*sizeof(T)));
+        }
+
+        void deallocate(T *p, const size_t)
+        {
+            if (reinterpret_cast<char *>(p) != entry->control) ::operator delete(p);
+            recycle(entry);
+        }
+
+        template <typename U>
+        bool operator==(const Allocator<U> &other) const
+        {
+            return entry == other.entry;
+        }
+
+        template <typename U>
+        bool operator!=(const Allocator<U> &other) const
+        {
+            return entry != other.entry;
+        }
+
+        Entry *entry;
+    };
+
+    struct Deleter
+    {
+        void operator()(void *) const
+        {
+            return;
+        }
+    };
+
+    const size_t maxCached;
+    std::atomic<bool> closed;
+    Entry *cached[NumSizeClasses];
+    std::atomic<Entry *> returned[NumSizeClasses];
+    std::atomic<size_t> numCached[NumSizeClasses];
+};
+
+/***********************************************************************
+ * BufferPool implementation
+ **********************************************************************/
+Pothos::BufferPool::BufferPool(const size_t maxCached):
+    _maxCached(maxCached),
+    _impl(std::make_shared<Impl>(maxCached))
 {
     return;
 }
 
-void Pothos::BufferPool::clear(void)
+Pothos::BufferPool::BufferPool(const BufferPool &other):
+    _maxCached(other._maxCached),
+    _impl(std::make_shared<Impl>(_maxCached))
 {
-    _minBuffSize = defaultSize;
-    _buffs.clear();
+    return;
 }
 
-const Pothos::BufferChunk &Pothos::BufferPool::get(const size_t numBytes)
+Pothos::BufferPool::~BufferPool(void)
 {
-    //user asked for a larger buffer size -- drop all entries
-    if (numBytes > _minBuffSize)
-    {
-        _buffs.clear();
-        _minBuffSize = numBytes;
-    }
+    _impl->closed = true;
+    _impl->drain();
+}
+
+Pothos::BufferPool &Pothos::BufferPool::operator=(const BufferPool &other)
+{
+    _maxCached = other._maxCached;
+    this->clear();
+    return *this;
+}
+
+void Pothos::BufferPool::clear(void)
+{
+    //outstanding buffers are freed when released to the old state
+    _impl->closed = true;
+    _impl->drain();
+    _impl = std::make_shared<Impl>(_maxCached);
+}
 
-    //find the first buffer where we hold the only copy
-    for (size_t i = 0; i < _buffs.size(); i++)
+Pothos::BufferChunk Pothos::BufferPool::get(const size_t numBytes)
+{
+    //pop an unused entry or make a new one
+    const size_t sizeClass = sizeToClass(numBytes);
+    auto entry = _impl->pop(sizeClass);
+    if (entry == nullptr)
     {
-        if (_buffs[i].getBuffer().unique()) return _buffs[i];
+        entry = new Impl::Entry();
+        entry->buffer = SharedBuffer::make(defaultSize << sizeClass);
+        entry->sizeClass = sizeClass;
     }
+    entry->impl = _impl;
 
-    //otherwise make a new buffer
-    _buffs.emplace_back(_minBuffSize);
-    return _buffs.back();
+    //the container recycles the entry when the last copy is released
+    const auto &buffer = entry->buffer;
+    std::shared_ptr<void> container(reinterpret_cast<void *>(buffer.getAddress()), Impl::Deleter(), Impl::Allocator<char>(entry));
+    SharedBuffer out(buffer.getAddress(), buffer.getLength(), std::move(container));
+    out._backing = buffer._backing;
+    return BufferChunk(out);
 }
@@ -28,7 +28,7 @@ public:
 
         //create the circular buffer
         _circBuff = Pothos::SharedBuffer::makeCirc(
-            args.bufferSize*args.numBuffers, args.nodeAffinity);
+            args.bufferSize*args.numBuffers, args.nodeAffinity, args.hugePages);
 
         //init the state variables
         _frontAddress = _circBuff.getAddress();
@@ -4,6 +4,7 @@
 #include <Pothos/Plugin.hpp>
 #include <Pothos/Util/OrderedQueue.hpp>
 #include <Pothos/Framework/BufferManager.hpp>
+#include "Framework/ShmChannel.hpp"
 #include <cassert>
 #include <iostream>
 
@@ -15,7 +16,8 @@ class GenericBufferManager :
     public std::enable_shared_from_this<GenericBufferManager>
 {
 public:
-    GenericBufferManager(void):
+    GenericBufferManager(const bool sharedMemory):
+        _sharedMemory(sharedMemory),
         _bufferSize(0),
         _bytesPopped(0)
     {
@@ -28,9 +30,11 @@ public:
         _bufferSize = args.bufferSize;
         _readyBuffs = Pothos::Util::OrderedQueue<Pothos::ManagedBuffer>(args.numBuffers);
 
-        //allocate one large continuous slab
-        auto commonSlab = Pothos::SharedBuffer::make(
-            args.bufferSize*args.numBuffers, args.nodeAffinity);
+        //allocate one large continuous slab,
+        //or a shared memory segment which other processes can map
+        auto commonSlab = _sharedMemory?
+            ShmSegment::makeBuffer(ShmSegment::make(args.bufferSize*args.numBuffers)):
+            Pothos::SharedBuffer::make(args.bufferSize*args.numBuffers, args.nodeAffinity, args.hugePages);
 
         //create managed buffers based on chunks from the slab
         std::vector<Pothos::ManagedBuffer> managedBuffers(args.numBuffers);
@@ -83,6 +87,7 @@ public:
 
 private:
 
+    const bool _sharedMemory;
     size_t _bufferSize;
     size_t _bytesPopped;
     Pothos::Util::OrderedQueue<Pothos::ManagedBuffer> _readyBuffs;
@@ -93,7 +98,12 @@ private:
  **********************************************************************/
 Pothos::BufferManager::Sptr makeGenericBufferManager(void)
 {
-    return std::make_shared<GenericBufferManager>();
+    return std::make_shared<GenericBufferManager>(false);
+}
+
+Pothos::BufferManager::Sptr makeShmBufferManager(void)
+{
+    return std::make_shared<GenericBufferManager>(true);
 }
 
 pothos_static_block(pothosFrameworkRegisterGenericBufferManager)
@@ -101,4 +111,7 @@ pothos_static_block(pothosFrameworkRegisterGenericBufferManager)
     Pothos::PluginRegistry::addCall(
         "/framework/buffer_manager/generic",
         &makeGenericBufferManager);
+    Pothos::PluginRegistry::addCall(
+        "/framework/buffer_manager/shm",
+        &makeShmBufferManager);
 }
@@ -0,0 +1,137 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Testing.hpp>
+#include <Pothos/Framework/BufferAccumulator.hpp>
+#include <Pothos/Framework/BufferManager.hpp>
+#include <Pothos/Framework/BufferChunk.hpp>
+#include "Framework/AllocationCounter.hpp"
+#include <iostream>
+#include <chrono>
+#include <algorithm> //max
+
+/***********************************************************************
+ * Feed frames from a buffer manager through an accumulator:
+ * Produce whole buffers and require the frame after every push,
+ * like the worker does with an input port that has a reserve.
+ * The frames are misaligned with the buffers by a small header.
+ * Return the average time spent per call to require().
+ **********************************************************************/
+static double requireFrames(Pothos::BufferManager::Sptr manager, const size_t frameSize, const size_t numFrames, size_t &numCopies)
+{
+    Pothos::BufferAccumulator accumulator;
+    std::chrono::high_resolution_clock::duration requireTime(0);
+    size_t numRequires = 0;
+    size_t produced = 0, consumed = 0;
+    numCopies = 0;
+
+    //consume the header of the first buffer
+    const size_t headerSize = 100;
+    {
+        auto buffer = manager->front();
+        buffer.length = headerSize;
+        manager->pop(buffer.length);
+        accumulator.push(buffer);
+        accumulator.pop(headerSize);
+        produced = consumed = headerSize;
+    }
+
+    for (size_t frame = 0; frame < numFrames; frame++)
+    {
+        while (true)
+        {
+            //produce when the manager has a buffer available
+            if (not manager->empty() and accumulator.getTotalBytesAvailable() < frameSize)
+            {
+                auto buffer = manager->front();
+                auto p = buffer.as<unsigned char *>();
+                for (size_t i = 0; i < buffer.length; i++) p[i] = (unsigned char)((produced+i)%251);
+                produced += buffer.length;
+                manager->pop(buffer.length);
+                accumulator.push(buffer);
+            }
+
+            const auto startTime = std::chrono::high_resolution_clock::now();
+            accumulator.require(frameSize);
+            requireTime += std::chrono::high_resolution_clock::now() - startTime;
+            numRequires++;
+            if (accumulator.front().length >= frameSize) break;
+        }
+
+        //check the contents of the contiguous frame
+        const auto &front = accumulator.front();
+        if (not front.getManagedBuffer()) numCopies++;
+        auto p = front.as<const unsigned char *>();
+        for (size_t i = 0; i < frameSize; i++)
+        {
+            if (p[i] != (unsigned char)((consumed+i)%251)) POTHOS_TEST_EQUAL(size_t(p[i]), (consumed+i)%251);
+        }
+        consumed += frameSize;
+        accumulator.pop(frameSize);
+    }
+
+    return std::chrono::duration<double, std::nano>(requireTime).count()/numRequires;
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_accumulator_require)
+{
+    for (size_t frameSize = 1024; frameSize <= 1024*1024; frameSize *= 4)
+    {
+        const size_t numFrames = std::max<size_t>(16, (16*1024*1024)/frameSize);
+        Pothos::BufferManagerArgs args;
+        size_t numCopies = 0;
+
+        //generic buffers with the default arguments
+        auto generic = Pothos::BufferManager::make("generic", args);
+        const double genericNs = requireFrames(generic, frameSize, numFrames, numCopies);
+        std::cout << "Require " << frameSize << " byte frames from generic buffers: "
+            << genericNs << " ns/require, " << numCopies << " copied" << std::endl;
+
+        //circular staging sized like the worker does for an input reserve
+        const size_t buffersPerFrame = (frameSize + args.bufferSize - 1)/args.bufferSize;
+        args.numBuffers = std::max(args.numBuffers, 2*buffersPerFrame + 2);
+        auto circular = Pothos::BufferManager::make("circular", args);
+        const double circularNs = requireFrames(circular, frameSize, numFrames, numCopies);
+        std::cout << "Require " << frameSize << " byte frames from circular staging: "
+            << circularNs << " ns/require, " << numCopies << " copied" << std::endl;
+
+        //the frames are always contiguous in the circular buffer
+        POTHOS_TEST_EQUAL(numCopies, 0);
+    }
+}
+
+/***********************************************************************
+ * A reserved accumulator holds separate buffers without allocating
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_accumulator_reserve)
+{
+    const size_t numBuffers = 256;
+    Pothos::BufferManagerArgs args;
+    args.numBuffers = numBuffers;
+    auto manager = Pothos::BufferManager::make("generic", args);
+
+    Pothos::BufferAccumulator accumulator;
+    accumulator.reserve(numBuffers, 2*args.bufferSize);
+
+    //push every buffer of the manager, they are not contiguous
+    unsigned long long numAllocations = 0;
+    {
+        AllocationAccumulator allocations(numAllocations);
+        for (size_t i = 0; i < numBuffers; i++)
+        {
+            auto buffer = manager->front();
+            manager->pop(buffer.length);
+            accumulator.push(buffer);
+        }
+
+        //the pool buffer for the require was made by the reserve
+        accumulator.require(2*args.bufferSize);
+    }
+    POTHOS_TEST_EQUAL(accumulator.getTotalBytesAvailable(), numBuffers*args.bufferSize);
+    POTHOS_TEST_TRUE(accumulator.front().length >= 2*args.bufferSize);
+
+    //the allocations are only counted with the preloaded counter library
+    std::cout << "Reserved accumulator: " << numAllocations << " allocations"
+        << (hasAllocationCounter()?"":" (not counted)") << std::endl;
+    POTHOS_TEST_EQUAL(numAllocations, 0);
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Testing.hpp>
+#include <Pothos/Framework/BufferPool.hpp>
+#include <Pothos/Framework/BufferChunk.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <set>
+#include <deque>
+
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_pool)
+{
+    Pothos::BufferPool pool;
+
+    //requests round up to a power of two size class
+    auto b0 = pool.get(100);
+    POTHOS_TEST_EQUAL(b0.length, 8*1024);
+    auto b1 = pool.get(10000);
+    POTHOS_TEST_EQUAL(b1.length, 16*1024);
+
+    //a released buffer is reused by the next request of its class
+    const size_t address0 = b0.address;
+    const size_t address1 = b1.address;
+    b0 = Pothos::BufferChunk();
+    b1 = Pothos::BufferChunk();
+    POTHOS_TEST_EQUAL(pool.get(8*1024).address, address0);
+
+    //a larger request does not discard the cached buffers
+    auto b2 = pool.get(1024*1024);
+    POTHOS_TEST_TRUE(b2.length >= 1024*1024);
+    b2 = Pothos::BufferChunk();
+    POTHOS_TEST_EQUAL(pool.get(1).address, address0);
+    POTHOS_TEST_EQUAL(pool.get(16*1024).address, address1);
+
+    //a buffer in use is not handed out again
+    b0 = pool.get(1);
+    POTHOS_TEST_TRUE(pool.get(1).address != b0.address);
+
+    //buffers released on another thread return to the pool
+    Pothos::BufferPool shared;
+    b0 = shared.get(1);
+    const size_t address2 = b0.address;
+    std::thread([&b0](void){b0 = Pothos::BufferChunk();}).join();
+    POTHOS_TEST_EQUAL(shared.get(1).address, address2);
+
+    //each size class caches a bounded number of buffers
+    Pothos::BufferPool bounded(4);
+    std::vector<Pothos::BufferChunk> buffs;
+    for (size_t i = 0; i < 8; i++) buffs.push_back(bounded.get(1));
+    std::set<size_t> addresses;
+    for (const auto &buff : buffs) addresses.insert(buff.address);
+    buffs.clear();
+
+    //keep the freed memory in use so that new buffers get new addresses
+    std::vector<Pothos::SharedBuffer> blockers;
+    for (size_t i = 0; i < 8; i++) blockers.push_back(Pothos::SharedBuffer::make(8*1024));
+    size_t numReused = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        buffs.push_back(bounded.get(1));
+        numReused += addresses.count(buffs.back().address);
+    }
+    POTHOS_TEST_EQUAL(numReused, 4);
+
+    //buffers outlive the pool which made them
+    Pothos::BufferChunk orphan;
+    {
+        Pothos::BufferPool temp;
+        orphan = temp.get(64);
+    }
+    reinterpret_cast<char *>(orphan.address)[0] = 1;
+    orphan = Pothos::BufferChunk();
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_pool_mixed_sizes)
+{
+    //request sizes cycle through several size classes,
+    //with a window of buffers held downstream like a port
+    static const size_t sizes[] = {512, 64*1024, 4*1024, 200*1024, 16*1024, 1024*1024, 8*1024};
+    static const size_t numSizes = sizeof(sizes)/sizeof(sizes[0]);
+    static const size_t numIters = 100000;
+    for (const size_t window : {1, 8})
+    {
+        Pothos::BufferPool pool;
+        std::deque<Pothos::BufferChunk> held;
+        std::set<size_t> addresses;
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < numIters; i++)
+        {
+            held.push_back(pool.get(sizes[i % numSizes]));
+            if (i < 2*numSizes*window) addresses.insert(held.back().address);
+            if (held.size() > window) held.pop_front();
+        }
+        const auto elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        const double nsPerGet = std::chrono::duration<double, std::nano>(elapsed).count()/numIters;
+        std::cout << "Buffer pool mixed sizes with " << window << " held: " << nsPerGet << " ns/get" << std::endl;
+
+        //the steady state only reuses buffers from the first rounds
+        for (size_t i = numIters; i < numIters + 2*numSizes*window; i++)
+        {
+            held.push_back(pool.get(sizes[i % numSizes]));
+            POTHOS_TEST_EQUAL(addresses.count(held.back().address), 1);
+            if (held.size() > window) held.pop_front();
+        }
+    }
+}
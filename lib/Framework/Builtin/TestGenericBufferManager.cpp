@@ -5,6 +5,7 @@
 #include <Pothos/Framework/BufferManager.hpp>
 #include <Pothos/Framework/BufferChunk.hpp>
 #include <Pothos/Framework/Exception.hpp>
+#include <algorithm> //fill_n
 
 POTHOS_TEST_BLOCK("/framework/tests", test_generic_buffer_manager)
 {
@@ -24,3 +25,41 @@ POTHOS_TEST_BLOCK("/framework/tests", test_generic_buffer_manager)
     buffs.clear();
     POTHOS_TEST_TRUE(not manager->empty());
 }
+
+POTHOS_TEST_BLOCK("/framework/tests", test_managed_buffer_chunk_refs)
+{
+    Pothos::BufferManagerArgs args;
+    args.numBuffers = 2;
+    auto manager = Pothos::BufferManager::make("generic", args);
+
+    //a chunk from a managed buffer uses the buffer of the managed buffer
+    auto b0 = manager->front();
+    manager->pop(b0.length);
+    POTHOS_TEST_EQUAL(b0.useCount(), 1);
+    POTHOS_TEST_TRUE(b0.getBuffer() == b0.getManagedBuffer().getBuffer());
+    POTHOS_TEST_EQUAL(b0.getBuffer().getAddress(), b0.address);
+    POTHOS_TEST_EQUAL(b0.getBuffer().getLength(), b0.length);
+
+    //copies of the chunk share one reference count
+    auto b1 = b0;
+    POTHOS_TEST_EQUAL(b0.useCount(), 2);
+    POTHOS_TEST_TRUE(b1 == b0);
+    b1 = Pothos::BufferChunk();
+    POTHOS_TEST_EQUAL(b0.useCount(), 1);
+
+    //the chunk remains valid after the manager is deleted
+    manager.reset();
+    POTHOS_TEST_TRUE(bool(b0));
+    std::fill_n(b0.as<char *>(), b0.length, char(1));
+    POTHOS_TEST_EQUAL(b0.as<const char *>()[b0.length-1], char(1));
+    b0 = Pothos::BufferChunk();
+
+    //managed buffers released without a manager are recycled for new managers
+    for (size_t i = 0; i < 100; i++)
+    {
+        manager = Pothos::BufferManager::make("generic", args);
+        b0 = manager->front();
+        manager.reset();
+        b0 = Pothos::BufferChunk();
+    }
+}
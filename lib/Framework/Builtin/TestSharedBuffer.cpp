@@ -1,10 +1,23 @@
-// Copyright (c) 2013-2014 Josh Blum
+// Copyright (c) 2013-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework/SharedBuffer.hpp>
 #include <Pothos/Framework/Exception.hpp>
+#include <Pothos/System/NumaInfo.hpp>
+#include <Poco/JSON/Parser.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/JSON/Object.h>
 #include <cstdlib> //rand
+#include <algorithm> //find
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cctype> //isdigit
 
 POTHOS_TEST_BLOCK("/framework/tests", test_generic_shared_buffer)
 {
@@ -60,3 +73,164 @@ POTHOS_TEST_BLOCK("/framework/tests", test_circular_shared_buffer)
         POTHOS_TEST_EQUAL(p[i+alias], randNum);
     }
 }
+
+POTHOS_TEST_BLOCK("/framework/tests", test_huge_page_shared_buffer)
+{
+    const std::vector<std::string> backings{"ARENA", "HEAP", "NUMA", "TRANSPARENT", "HUGETLB", "MEMFD", "FILE", "VIRTUAL"};
+    for (const auto &mode : {"NONE", "TRANSPARENT", "HUGETLB"})
+    {
+        //huge pages fall back to regular pages when unavailable
+        auto b0 = Pothos::SharedBuffer::make(3*1024*1024, -1, mode);
+        POTHOS_TEST_TRUE(b0.getAddress() != 0);
+        POTHOS_TEST_EQUAL(b0.getLength(), 3*1024*1024);
+        POTHOS_TEST_TRUE(std::find(backings.begin(), backings.end(), b0.getBacking()) != backings.end());
+        int *p0 = reinterpret_cast<int *>(b0.getAddress());
+        for (size_t i = 0; i < b0.getLength()/sizeof(int); i += 1024) p0[i] = int(i);
+        for (size_t i = 0; i < b0.getLength()/sizeof(int); i += 1024) POTHOS_TEST_EQUAL(p0[i], int(i));
+
+        //sub-buffers report the backing of the parent
+        Pothos::SharedBuffer sub(b0.getAddress()+1024, 1024, b0);
+        POTHOS_TEST_EQUAL(sub.getBacking(), b0.getBacking());
+
+        auto b1 = Pothos::SharedBuffer::makeCirc(1024*1024, -1, mode);
+        std::cout << mode << " huge pages: " << b0.getBacking() << ", circular " << b1.getBacking() << std::endl;
+        POTHOS_TEST_TRUE(b1.getLength() >= 1024*1024);
+        POTHOS_TEST_TRUE(std::find(backings.begin(), backings.end(), b1.getBacking()) != backings.end());
+        int *p1 = reinterpret_cast<int *>(b1.getAddress());
+        const size_t alias = b1.getLength()/sizeof(int);
+        for (size_t i = 0; i < alias; i += 1024)
+        {
+            p1[i] = int(i);
+            POTHOS_TEST_EQUAL(p1[i+alias], int(i));
+        }
+    }
+
+    POTHOS_TEST_THROWS(Pothos::SharedBuffer::make(1024, -1, "FAIL"), Pothos::SharedBufferError);
+    POTHOS_TEST_THROWS(Pothos::SharedBuffer::makeCirc(1024, -1, "FAIL"), Pothos::SharedBufferError);
+}
+
+static size_t getArenaBytesInUse(const char *key)
+{
+    size_t total = 0;
+    const auto stats = Pothos::SharedBuffer::queryArenaStats();
+    const auto arr = Poco::JSON::Parser().parse(stats).extract<Poco::JSON::Array::Ptr>();
+    for (size_t i = 0; i < arr->size(); i++) total += arr->getObject(i)->getValue<Poco::UInt64>(key);
+    return total;
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_arena_shared_buffer)
+{
+    //small buffers come from the arena with cache line alignment
+    const size_t inUse = getArenaBytesInUse("bytesInUse");
+    auto b0 = Pothos::SharedBuffer::make(1000);
+    POTHOS_TEST_EQUAL(b0.getBacking(), "ARENA");
+    POTHOS_TEST_EQUAL(b0.getLength(), 1000);
+    POTHOS_TEST_TRUE((b0.getAddress() & 0x3f) == 0);
+    POTHOS_TEST_EQUAL(getArenaBytesInUse("bytesInUse"), inUse+1024);
+    POTHOS_TEST_TRUE(getArenaBytesInUse("highWaterBytes") >= inUse+1024);
+
+    //a freed block is reused by the next buffer of the same size class
+    const size_t address = b0.getAddress();
+    b0 = Pothos::SharedBuffer();
+    POTHOS_TEST_EQUAL(getArenaBytesInUse("bytesInUse"), inUse);
+    auto b1 = Pothos::SharedBuffer::make(1024);
+    POTHOS_TEST_EQUAL(b1.getAddress(), address);
+    b1 = Pothos::SharedBuffer();
+
+    //large buffers bypass the arena
+    auto b2 = Pothos::SharedBuffer::make(1024*1024);
+    POTHOS_TEST_TRUE(b2.getBacking() != "ARENA");
+
+    //buffers are made and released across threads
+    std::atomic<size_t> numErrors(0);
+    std::vector<Pothos::SharedBuffer> handoff(1000);
+    std::thread producer([&handoff](void)
+    {
+        for (size_t i = 0; i < handoff.size(); i++)
+        {
+            handoff[i] = Pothos::SharedBuffer::make(64 << (i % 12));
+            std::fill_n(reinterpret_cast<char *>(handoff[i].getAddress()), handoff[i].getLength(), char(i));
+        }
+    });
+    producer.join();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) threads.emplace_back([t, &handoff, &numErrors](void)
+    {
+        for (size_t i = t; i < handoff.size(); i += 4)
+        {
+            const auto p = reinterpret_cast<const char *>(handoff[i].getAddress());
+            if (p[handoff[i].getLength()-1] != char(i)) numErrors++;
+            handoff[i] = Pothos::SharedBuffer();
+            auto b = Pothos::SharedBuffer::make(100 + i);
+            std::fill_n(reinterpret_cast<char *>(b.getAddress()), b.getLength(), char(t));
+        }
+    });
+    for (auto &thread : threads) thread.join();
+    POTHOS_TEST_EQUAL(numErrors.load(), 0);
+    POTHOS_TEST_EQUAL(getArenaBytesInUse("bytesInUse"), inUse);
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_circular_shared_buffer_reuse)
+{
+    //a released mapping is reused by the next buffer of the same size
+    auto b0 = Pothos::SharedBuffer::makeCirc(3*4096);
+    const size_t address = b0.getAddress();
+    b0 = Pothos::SharedBuffer();
+    auto b1 = Pothos::SharedBuffer::makeCirc(3*4096);
+    POTHOS_TEST_EQUAL(b1.getAddress(), address);
+
+    //many threads create buffers of mixed sizes without a global lock
+    std::atomic<size_t> numErrors(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) threads.emplace_back([t, &numErrors](void)
+    {
+        for (size_t i = 0; i < 100; i++)
+        {
+            auto b = Pothos::SharedBuffer::makeCirc(4096*(1+(i+t)%7));
+            auto p = reinterpret_cast<char *>(b.getAddress());
+            for (size_t j = 0; j < b.getLength(); j += 512) p[j] = char(i+j);
+            for (size_t j = 0; j < b.getLength(); j += 512)
+            {
+                if (p[j+b.getLength()] != char(i+j)) numErrors++;
+            }
+        }
+    });
+    for (auto &thread : threads) thread.join();
+    POTHOS_TEST_EQUAL(numErrors.load(), 0);
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_circular_shared_buffer_numa)
+{
+    //allocate on the last node to tell placement apart from the default
+    const auto numaInfo = Pothos::System::NumaInfo::get();
+    if (numaInfo.empty()) return;
+    const long node = long(numaInfo.back().nodeNumber);
+    auto b0 = Pothos::SharedBuffer::makeCirc(1024*1024, node);
+    POTHOS_TEST_EQUAL(b0.getAlias(), b0.getAddress()+b0.getLength());
+
+    //find the mapping in the page placement report where available
+    std::ifstream numaMaps("/proc/self/numa_maps");
+    if (not numaMaps.is_open()) return;
+    std::ostringstream address; address << std::hex << b0.getAddress() << " ";
+    std::string line;
+    while (std::getline(numaMaps, line))
+    {
+        if (line.compare(0, address.str().size(), address.str()) != 0) continue;
+        std::cout << "Circular buffer placement: " << line << std::endl;
+
+        //every resident page is counted on the requested node: N<node>=<pages>
+        std::istringstream fields(line);
+        std::string field;
+        size_t numPagesOnNode = 0;
+        while (fields >> field)
+        {
+            if (field.size() < 2 or field[0] != 'N' or not std::isdigit(field[1])) continue;
+            const auto eq = field.find('=');
+            POTHOS_TEST_EQUAL(std::stol(field.substr(1, eq-1)), node);
+            numPagesOnNode += std::stoul(field.substr(eq+1));
+        }
+        POTHOS_TEST_TRUE(numPagesOnNode > 0);
+        return;
+    }
+    POTHOS_TEST_TRUE(false); //mapping not found
+}
@@ -1,8 +1,24 @@
-// Copyright (c) 2014-2014 Josh Blum
+// Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework.hpp>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Parser.h>
+#include "Framework/WorkerActor.hpp"
+#include "Framework/AllocationCounter.hpp"
+#include <algorithm> //min
+#include <cstring> //memcpy
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#ifdef __linux__
+#include <unistd.h> //pipe
+#include <fcntl.h> //O_NONBLOCK
+#endif
 
 POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool)
 {
@@ -23,4 +39,1074 @@ POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool)
     Pothos::ThreadPoolArgs args4;
     args4.priority = -1e6;
     POTHOS_TEST_THROWS(Pothos::ThreadPool tp4(args4), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args5;
+    args5.schedulerMode = "FAIL";
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp5(args5), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args6("{\"numThreads\" : 2, \"schedulerMode\" : \"STEALING\"}");
+    POTHOS_TEST_EQUAL(args6.schedulerMode, "STEALING");
+    Pothos::ThreadPool tp6(args6);
+    POTHOS_TEST_TRUE(tp6);
+
+    Pothos::ThreadPoolArgs args7("{\"yieldMode\" : \"HYBRID\", \"spinBudgetNs\" : 5000, \"yieldBudgetNs\" : 50000}");
+    POTHOS_TEST_EQUAL(args7.spinBudgetNs, 5000);
+    POTHOS_TEST_EQUAL(args7.yieldBudgetNs, 50000);
+    Pothos::ThreadPool tp7(args7);
+    POTHOS_TEST_TRUE(tp7);
+
+    Pothos::ThreadPoolArgs args8;
+    args8.spinBudgetNs = -1;
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp8(args8), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args9("{\"numThreads\" : 2, \"workQuantum\" : 8, \"workQuantumNs\" : 50000}");
+    POTHOS_TEST_EQUAL(args9.workQuantum, 8);
+    POTHOS_TEST_EQUAL(args9.workQuantumNs, 50000);
+    Pothos::ThreadPool tp9(args9);
+    POTHOS_TEST_TRUE(tp9);
+
+    Pothos::ThreadPoolArgs args10;
+    args10.workQuantum = 0;
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp10(args10), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args11("{\"numThreads\" : 2, \"minThreads\" : 1, \"maxThreads\" : 4}");
+    POTHOS_TEST_EQUAL(args11.minThreads, 1);
+    POTHOS_TEST_EQUAL(args11.maxThreads, 4);
+    Pothos::ThreadPool tp11(args11);
+    POTHOS_TEST_TRUE(tp11);
+
+    Pothos::ThreadPoolArgs args12(2);
+    args12.minThreads = 4;
+    args12.maxThreads = 2;
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp12(args12), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args13(2);
+    args13.maxThreads = 4;
+    args13.utilizationLow = 0.9;
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp13(args13), Pothos::ThreadPoolError);
+
+    Pothos::ThreadPoolArgs args14("{\"numThreads\" : 2, \"profile\" : \"REALTIME\"}");
+    POTHOS_TEST_EQUAL(args14.profile, "REALTIME");
+    Pothos::ThreadPool tp14(args14);
+    POTHOS_TEST_TRUE(tp14);
+
+    Pothos::ThreadPoolArgs args15;
+    args15.profile = "FAIL";
+    POTHOS_TEST_THROWS(Pothos::ThreadPool tp15(args15), Pothos::ThreadPoolError);
+}
+
+/***********************************************************************
+ * Helper blocks to stream buffers through the scheduler
+ **********************************************************************/
+struct ThroughputSource : Pothos::Block
+{
+    ThroughputSource(const size_t chunkSize = 0):
+        chunkSize(chunkSize)
+    {
+        this->setupOutput(0, "uint8");
+    }
+
+    void work(void)
+    {
+        //produce the whole buffer or a fixed chunk per call
+        auto out0 = this->output(0);
+        const size_t n = (chunkSize == 0)?out0->elements():std::min(chunkSize, out0->elements());
+        out0->produce(n);
+    }
+
+    const size_t chunkSize;
+};
+
+struct ThroughputCopier : Pothos::Block
+{
+    ThroughputCopier(void)
+    {
+        this->setupInput(0, "uint8");
+        this->setupOutput(0, "uint8");
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        auto out0 = this->output(0);
+        const size_t n = std::min(in0->elements(), out0->elements());
+        std::memcpy(out0->buffer().as<void *>(), in0->buffer().as<const void *>(), n);
+        in0->consume(n);
+        out0->produce(n);
+    }
+};
+
+struct ThroughputSink : Pothos::Block
+{
+    ThroughputSink(void):
+        total(0)
+    {
+        this->setupInput(0, "uint8");
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        total += in0->elements();
+        in0->consume(in0->elements());
+    }
+
+    std::atomic<unsigned long long> total;
+};
+
+/***********************************************************************
+ * Query a counter from the work stats of a block in the topology
+ **********************************************************************/
+static Poco::UInt64 getWorkStat(Pothos::Topology &topology, const std::string &uid, const std::string &name)
+{
+    const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+    const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(uid);
+    return stats->getValue<Poco::UInt64>(name);
+}
+
+/***********************************************************************
+ * Idle threads steal tasks from the queues of the other threads:
+ * A single chain has fewer tasks than the pool has threads,
+ * so the threads without tasks in their own queue must steal.
+ * The shared queue of the round robin mode is never stolen from.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_scheduler_stealing)
+{
+    for (const std::string mode : {"ROUND_ROBIN", "STEALING"})
+    {
+        Pothos::ThreadPoolArgs args(4/*threads*/);
+        args.schedulerMode = mode;
+
+        std::shared_ptr<Pothos::Block> source(new ThroughputSource());
+        std::shared_ptr<Pothos::Block> copier(new ThroughputCopier());
+        std::shared_ptr<ThroughputSink> sink(new ThroughputSink());
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        topology.connect(source, 0, copier, 0);
+        topology.connect(copier, 0, sink, 0);
+        topology.commit();
+
+        //run until the first steal, or a fixed amount of data without stealing
+        Poco::UInt64 numSteals = 0;
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        while (std::chrono::high_resolution_clock::now() - startTime < std::chrono::seconds(10))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            numSteals = getWorkStat(topology, source->uid(), "numTaskSteals");
+            numSteals += getWorkStat(topology, copier->uid(), "numTaskSteals");
+            numSteals += getWorkStat(topology, sink->uid(), "numTaskSteals");
+            if (numSteals != 0 or (mode == "ROUND_ROBIN" and sink->total > (1 << 24))) break;
+        }
+
+        POTHOS_TEST_TRUE(sink->total > 0);
+        if (mode == "STEALING") POTHOS_TEST_TRUE(numSteals > 0);
+        if (mode == "ROUND_ROBIN") POTHOS_TEST_EQUAL(numSteals, 0);
+    }
+}
+
+/***********************************************************************
+ * Measure the throughput of parallel chains of copier blocks
+ **********************************************************************/
+static double measureThroughput(const Pothos::ThreadPoolArgs &args, const size_t numChains, const size_t chainLength)
+{
+    std::vector<std::shared_ptr<ThroughputSink>> sinks;
+
+    double bytesPerSec = 0.0;
+    {
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        for (size_t i = 0; i < numChains; i++)
+        {
+            std::shared_ptr<Pothos::Block> last(new ThroughputSource());
+            for (size_t j = 0; j < chainLength; j++)
+            {
+                std::shared_ptr<Pothos::Block> copier(new ThroughputCopier());
+                topology.connect(last, 0, copier, 0);
+                last = copier;
+            }
+            std::shared_ptr<ThroughputSink> sink(new ThroughputSink());
+            topology.connect(last, 0, sink, 0);
+            sinks.push_back(sink);
+        }
+
+        topology.commit();
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        unsigned long long totalBytes = 0;
+        for (const auto &sink : sinks) totalBytes += sink->total;
+        const auto elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        bytesPerSec = totalBytes/std::chrono::duration<double>(elapsed).count();
+    }
+
+    return bytesPerSec;
+}
+
+/***********************************************************************
+ * Compare the throughput of the pool scheduler modes:
+ * Many parallel chains of blocks share a small thread pool.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_scheduler_throughput)
+{
+    for (const auto &mode : {"ROUND_ROBIN", "STEALING"})
+    {
+        Pothos::ThreadPoolArgs args(4/*threads*/);
+        args.schedulerMode = mode;
+        const auto bytesPerSec = measureThroughput(args, 16/*chains*/, 4/*length*/);
+        std::cout << mode << " scheduler throughput: " << (bytesPerSec/1e6) << " MB/s" << std::endl;
+        POTHOS_TEST_TRUE(bytesPerSec > 0.0);
+    }
+}
+
+/***********************************************************************
+ * The work quantum limits the consecutive calls to work()
+ * in each dispatch of a task: The source is productive
+ * on every call, so it reaches the limit of the quantum.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_work_quantum)
+{
+    for (const size_t quantum : {1, 8})
+    {
+        Pothos::ThreadPoolArgs args(2/*threads*/);
+        args.workQuantum = quantum;
+
+        std::shared_ptr<Pothos::Block> source(new ThroughputSource(1/*chunk*/));
+        std::shared_ptr<Pothos::Block> sink(new ThroughputSink());
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        topology.connect(source, 0, sink, 0);
+        topology.commit();
+
+        //stats queries interrupt the quantum, so wait for a complete one
+        Poco::UInt64 maxWorkCalls = 0;
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        while (maxWorkCalls < quantum and
+            std::chrono::high_resolution_clock::now() - startTime < std::chrono::seconds(10))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            maxWorkCalls = getWorkStat(topology, source->uid(), "maxWorkCallsPerTask");
+        }
+
+        POTHOS_TEST_EQUAL(maxWorkCalls, quantum);
+    }
+}
+
+/***********************************************************************
+ * Helper blocks to test message delivery in pool mode
+ **********************************************************************/
+struct MessageSource : Pothos::Block
+{
+    MessageSource(const int numMessages):
+        numMessages(numMessages),
+        count(0)
+    {
+        this->setupOutput(0);
+    }
+
+    void work(void)
+    {
+        if (count == numMessages) return;
+        this->output(0)->postMessage(count++);
+    }
+
+    const int numMessages;
+    int count;
+};
+
+struct MessageForwarder : Pothos::Block
+{
+    MessageForwarder(void)
+    {
+        this->setupInput(0);
+        this->setupOutput(0);
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        if (in0->hasMessage()) this->output(0)->postMessage(in0->popMessage());
+    }
+};
+
+struct MessageCounter : Pothos::Block
+{
+    MessageCounter(void):
+        count(0)
+    {
+        this->setupInput(0);
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        while (in0->hasMessage())
+        {
+            in0->popMessage();
+            count++;
+        }
+    }
+
+    std::atomic<int> count;
+};
+
+/***********************************************************************
+ * Messages are delivered through a small pool of threads,
+ * while the pool also contains many idle blocks.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_ready_queue)
+{
+    for (const auto &mode : {"ROUND_ROBIN", "STEALING"})
+    for (const auto &yield : {"CONDITION", "HYBRID"})
+    {
+        std::cout << "Testing message delivery with " << mode << " scheduler, " << yield << " yield" << std::endl;
+        Pothos::ThreadPoolArgs args(2/*threads*/);
+        args.schedulerMode = mode;
+        args.yieldMode = yield;
+
+        std::vector<std::shared_ptr<Pothos::Block>> blocks;
+        std::shared_ptr<MessageSource> source(new MessageSource(100));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(args));
+
+            //a chain of forwarders between the source and counter
+            std::shared_ptr<Pothos::Block> last(source);
+            for (size_t i = 0; i < 4; i++)
+            {
+                std::shared_ptr<Pothos::Block> forwarder(new MessageForwarder());
+                topology.connect(last, 0, forwarder, 0);
+                blocks.push_back(forwarder);
+                last = forwarder;
+            }
+            topology.connect(last, 0, counter, 0);
+
+            //many idle forwarders which never receive messages
+            for (size_t i = 0; i < 64; i++)
+            {
+                std::shared_ptr<Pothos::Block> idle0(new MessageForwarder());
+                std::shared_ptr<Pothos::Block> idle1(new MessageCounter());
+                topology.connect(idle0, 0, idle1, 0);
+                blocks.push_back(idle0);
+                blocks.push_back(idle1);
+            }
+
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+
+        POTHOS_TEST_EQUAL(counter->count.load(), 100);
+    }
+}
+
+/***********************************************************************
+ * Helper block to record the threads which called work()
+ **********************************************************************/
+struct ThreadRecorder : MessageForwarder
+{
+    ThreadRecorder(std::mutex &mutex, std::set<std::thread::id> &threadIds):
+        mutex(mutex),
+        threadIds(threadIds)
+    {
+        return;
+    }
+
+    void work(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threadIds.insert(std::this_thread::get_id());
+        }
+        MessageForwarder::work();
+    }
+
+    std::mutex &mutex;
+    std::set<std::thread::id> &threadIds;
+};
+
+/***********************************************************************
+ * Blocks with the same placement hint run on one designated thread
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_placement_hint)
+{
+    //invalid affinity mode throws
+    {
+        std::shared_ptr<Pothos::Block> block(new MessageForwarder());
+        POTHOS_TEST_THROWS(block->setThreadAffinity("FAIL", {0}), Pothos::ThreadPoolError);
+        block->setThreadAffinity("CPU", {0});
+        POTHOS_TEST_EQUAL(block->getThreadAffinityMode(), "CPU");
+        POTHOS_TEST_EQUAL(block->getThreadAffinity().size(), 1);
+        block->setThreadAffinity("ALL", {});
+        POTHOS_TEST_TRUE(block->getThreadAffinityMode().empty());
+    }
+
+    for (const size_t numThreads : {0, 4})
+    {
+        std::cout << "Testing placement hint with " << numThreads << " threads" << std::endl;
+        Pothos::ThreadPoolArgs args(numThreads);
+        args.schedulerMode = "STEALING";
+
+        std::mutex mutex;
+        std::set<std::thread::id> threadIds;
+        std::shared_ptr<MessageSource> source(new MessageSource(100));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+        std::shared_ptr<Pothos::Block> placed0(new ThreadRecorder(mutex, threadIds));
+        std::shared_ptr<Pothos::Block> placed1(new ThreadRecorder(mutex, threadIds));
+        placed0->setThreadAffinity("CPU", {0});
+        placed1->setThreadAffinity("CPU", {0});
+
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(args));
+
+            //placed blocks in the middle of a chain of forwarders
+            std::shared_ptr<Pothos::Block> last(source);
+            std::vector<std::shared_ptr<Pothos::Block>> blocks;
+            for (size_t i = 0; i < 4; i++) blocks.emplace_back(new MessageForwarder());
+            blocks.insert(blocks.begin()+2, {placed0, placed1});
+            for (const auto &block : blocks)
+            {
+                topology.connect(last, 0, block, 0);
+                last = block;
+            }
+            topology.connect(last, 0, counter, 0);
+
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+
+        POTHOS_TEST_EQUAL(counter->count.load(), 100);
+
+        //pool mode: both placed blocks only ran on the designated thread
+        if (numThreads != 0) POTHOS_TEST_EQUAL(threadIds.size(), 1);
+    }
+}
+
+/***********************************************************************
+ * Helper blocks to test the order of service among scheduling classes:
+ * The busy source is always ready and counts its work calls,
+ * the recorder notes the busy work calls at its first and last message.
+ **********************************************************************/
+struct BusySource : Pothos::Block
+{
+    BusySource(std::atomic<unsigned long long> &busyCalls):
+        busyCalls(busyCalls)
+    {
+        this->setupOutput(0);
+    }
+
+    void work(void)
+    {
+        busyCalls++;
+        const auto exitTime = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(10);
+        while (std::chrono::high_resolution_clock::now() < exitTime){}
+        this->output(0)->postMessage(0);
+    }
+
+    std::atomic<unsigned long long> &busyCalls;
+};
+
+struct OrderRecorder : Pothos::Block
+{
+    OrderRecorder(const std::atomic<unsigned long long> &busyCalls):
+        busyCalls(busyCalls),
+        count(0),
+        firstMark(0),
+        lastMark(0)
+    {
+        this->setupInput(0);
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        while (in0->hasMessage())
+        {
+            in0->popMessage();
+            if (count == 0) firstMark = busyCalls.load();
+            lastMark = busyCalls.load();
+            count++;
+        }
+    }
+
+    const std::atomic<unsigned long long> &busyCalls;
+    std::atomic<int> count;
+    std::atomic<unsigned long long> firstMark;
+    std::atomic<unsigned long long> lastMark;
+};
+
+/***********************************************************************
+ * Blocks in the urgent scheduling classes among many normal blocks
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_scheduling_class)
+{
+    //invalid scheduling class throws
+    {
+        std::shared_ptr<Pothos::Block> block(new MessageForwarder());
+        POTHOS_TEST_EQUAL(block->getSchedulingClass(), "NORMAL");
+        POTHOS_TEST_THROWS(block->setSchedulingClass("FAIL"), Pothos::ThreadPoolError);
+        POTHOS_TEST_THROWS(block->setDeadline(-1), Pothos::ThreadPoolError);
+        block->setSchedulingClass("DEADLINE");
+        POTHOS_TEST_EQUAL(block->getSchedulingClass(), "DEADLINE");
+    }
+
+    for (const size_t numThreads : {0, 2})
+    {
+        std::cout << "Testing scheduling classes with " << numThreads << " threads" << std::endl;
+        Pothos::ThreadPoolArgs args(numThreads);
+        args.schedulerMode = "STEALING";
+
+        std::shared_ptr<MessageSource> source(new MessageSource(100));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+        std::shared_ptr<Pothos::Block> high(new MessageForwarder());
+        std::shared_ptr<Pothos::Block> late(new MessageForwarder());
+        high->setSchedulingClass("HIGH");
+        late->setSchedulingClass("DEADLINE");
+        late->setDeadline(1/*ns, always missed*/);
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        topology.connect(source, 0, high, 0);
+        topology.connect(high, 0, late, 0);
+        topology.connect(late, 0, counter, 0);
+
+        //many normal blocks competing for the pool threads
+        std::vector<std::shared_ptr<Pothos::Block>> blocks;
+        for (size_t i = 0; i < 16; i++)
+        {
+            std::shared_ptr<Pothos::Block> busy0(new MessageSource(1000));
+            std::shared_ptr<Pothos::Block> busy1(new MessageCounter());
+            topology.connect(busy0, 0, busy1, 0);
+            blocks.push_back(busy0);
+            blocks.push_back(busy1);
+        }
+
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+        POTHOS_TEST_EQUAL(counter->count.load(), 100);
+
+        //pool mode: the missed deadlines are counted in the stats
+        const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+        const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(late->uid());
+        POTHOS_TEST_TRUE(stats);
+        const auto numMisses = stats->getValue<Poco::UInt64>("numDeadlineMisses");
+        if (numThreads == 0) POTHOS_TEST_EQUAL(numMisses, 0);
+        if (numThreads != 0) POTHOS_TEST_TRUE(numMisses > 0);
+        topology.disconnectAll();
+    }
+
+    //order of service on a single thread among many busy normal blocks:
+    //the urgent tasks are served first, so no busy work calls interleave,
+    //while the normal chain waits behind the busy sources for each message
+    unsigned long long normalInterleaved = 0;
+    for (const auto &schedClass : {"NORMAL", "HIGH", "DEADLINE"})
+    {
+        Pothos::ThreadPoolArgs args(1);
+        args.schedulerMode = "STEALING";
+
+        std::atomic<unsigned long long> busyCalls(0);
+        std::shared_ptr<Pothos::Block> source(new MessageSource(100));
+        std::shared_ptr<Pothos::Block> forwarder(new MessageForwarder());
+        std::shared_ptr<OrderRecorder> recorder(new OrderRecorder(busyCalls));
+        for (const auto &block : {source, forwarder, std::shared_ptr<Pothos::Block>(recorder)})
+        {
+            block->setSchedulingClass(schedClass);
+            block->setDeadline(1000000/*ns*/);
+        }
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        topology.connect(source, 0, forwarder, 0);
+        topology.connect(forwarder, 0, recorder, 0);
+        for (size_t i = 0; i < 16; i++)
+        {
+            std::shared_ptr<Pothos::Block> busy0(new BusySource(busyCalls));
+            std::shared_ptr<Pothos::Block> busy1(new MessageCounter());
+            topology.connect(busy0, 0, busy1, 0);
+        }
+        topology.commit();
+
+        //the busy sources never finish, so wait on the recorder
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        while (recorder->count.load() < 100 and
+            std::chrono::high_resolution_clock::now() - startTime < std::chrono::seconds(10))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        topology.disconnectAll();
+        topology.commit();
+        POTHOS_TEST_EQUAL(recorder->count.load(), 100);
+
+        const auto interleaved = recorder->lastMark.load() - recorder->firstMark.load();
+        std::cout << schedClass << " chain among busy blocks: " << interleaved << " busy work calls interleaved" << std::endl;
+        if (std::string(schedClass) == "NORMAL") normalInterleaved = interleaved;
+        if (std::string(schedClass) != "NORMAL") POTHOS_TEST_TRUE(interleaved < 100);
+        if (std::string(schedClass) != "NORMAL") POTHOS_TEST_TRUE(interleaved < normalInterleaved);
+    }
+}
+
+/***********************************************************************
+ * Helper block to bounce a message back and forth with a peer
+ **********************************************************************/
+struct PingPong : Pothos::Block
+{
+    PingPong(const bool serve, const int limit):
+        serve(serve),
+        limit(limit),
+        count(0)
+    {
+        this->setupInput(0);
+        this->setupOutput(0);
+    }
+
+    void activate(void)
+    {
+        if (serve) this->output(0)->postMessage(0);
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        if (not in0->hasMessage()) return;
+        in0->popMessage();
+        if (++count < limit) this->output(0)->postMessage(count.load());
+    }
+
+    const bool serve;
+    const int limit;
+    std::atomic<int> count;
+};
+
+/***********************************************************************
+ * Measure the per-push cost of waking a block:
+ * Two blocks bounce a single message back and forth,
+ * so that every push wakes the otherwise idle peer.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_ping_pong)
+{
+    static const int numBounces = 20000;
+    for (const size_t numThreads : {0, 2})
+    for (const auto &yield : {"CONDITION", "HYBRID"})
+    {
+        Pothos::ThreadPoolArgs args(numThreads);
+        args.yieldMode = yield;
+
+        std::shared_ptr<PingPong> ping(new PingPong(true, numBounces));
+        std::shared_ptr<PingPong> pong(new PingPong(false, numBounces));
+
+        double nsPerPush = 0.0;
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(args));
+            topology.connect(ping, 0, pong, 0);
+            topology.connect(pong, 0, ping, 0);
+
+            const auto startTime = std::chrono::high_resolution_clock::now();
+            topology.commit();
+            while (ping->count + pong->count < 2*numBounces - 1 and
+                std::chrono::high_resolution_clock::now() - startTime < std::chrono::seconds(10))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            const auto elapsed = std::chrono::high_resolution_clock::now() - startTime;
+            nsPerPush = std::chrono::duration<double, std::nano>(elapsed).count()/(ping->count + pong->count);
+        }
+
+        std::cout << "Ping-pong with " << numThreads << " threads, " << yield << " yield: " << nsPerPush << " ns/push" << std::endl;
+        POTHOS_TEST_EQUAL(ping->count + pong->count, 2*numBounces - 1);
+    }
+}
+
+/***********************************************************************
+ * Helper block to record the threads which called work()
+ * while copying a stream of buffers
+ **********************************************************************/
+struct ThroughputRecorder : ThroughputCopier
+{
+    ThroughputRecorder(std::mutex &mutex, std::set<std::thread::id> &threadIds):
+        mutex(mutex),
+        threadIds(threadIds)
+    {
+        return;
+    }
+
+    void work(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threadIds.insert(std::this_thread::get_id());
+        }
+        ThroughputCopier::work();
+    }
+
+    std::mutex &mutex;
+    std::set<std::thread::id> &threadIds;
+};
+
+/***********************************************************************
+ * Linear chains are fused onto one thread when enabled
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_fused_chain)
+{
+    for (const size_t numThreads : {0, 2})
+    {
+        Pothos::ThreadPoolArgs args(numThreads);
+        std::shared_ptr<MessageSource> source(new MessageSource(100));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+        std::vector<std::shared_ptr<Pothos::Block>> blocks;
+
+        {
+            Pothos::Topology topology;
+            POTHOS_TEST_TRUE(not topology.getAutoFusion());
+            topology.setAutoFusion(true);
+            topology.setThreadPool(Pothos::ThreadPool(args));
+
+            //a linear chain between the source and counter
+            std::shared_ptr<Pothos::Block> last(source);
+            for (size_t i = 0; i < 4; i++)
+            {
+                std::shared_ptr<Pothos::Block> forwarder(new MessageForwarder());
+                topology.connect(last, 0, forwarder, 0);
+                blocks.push_back(forwarder);
+                last = forwarder;
+            }
+            topology.connect(last, 0, counter, 0);
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+
+            //the stats list the whole chain for every block in it
+            const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+            const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(counter->uid());
+            POTHOS_TEST_TRUE(stats->has("fusedChain"));
+            const auto chain = stats->getArray("fusedChain");
+            POTHOS_TEST_EQUAL(chain->size(), 6);
+            POTHOS_TEST_EQUAL(chain->getElement<std::string>(0), source->uid());
+            POTHOS_TEST_EQUAL(chain->getElement<std::string>(5), counter->uid());
+
+            //a disabled topology unfuses the chain on the next commit
+            topology.setAutoFusion(false);
+            topology.commit();
+            const auto result2 = Poco::JSON::Parser().parse(topology.queryJSONStats());
+            const auto stats2 = result2.extract<Poco::JSON::Object::Ptr>()->getObject(counter->uid());
+            POTHOS_TEST_TRUE(not stats2->has("fusedChain"));
+        }
+
+        POTHOS_TEST_EQUAL(counter->count.load(), 100);
+    }
+
+    //in thread-per-block mode, a fused chain runs on the one thread of its head
+    for (const bool autoFusion : {false, true})
+    {
+        std::mutex mutex;
+        std::set<std::thread::id> threadIds;
+        std::shared_ptr<ThroughputSink> sink(new ThroughputSink());
+        size_t numThreadIds = 0;
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(0/*threads*/)));
+            topology.setAutoFusion(autoFusion);
+            std::shared_ptr<Pothos::Block> last(new ThroughputSource());
+            for (size_t i = 0; i < 8; i++)
+            {
+                std::shared_ptr<Pothos::Block> recorder(new ThroughputRecorder(mutex, threadIds));
+                topology.connect(last, 0, recorder, 0);
+                last = recorder;
+            }
+            topology.connect(last, 0, sink, 0);
+            topology.commit();
+
+            //the chain is fused after activation, forget the threads before
+            const unsigned long long startTotal = sink->total;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                threadIds.clear();
+            }
+
+            //run until the unfused chain used several threads, or a fixed amount of data
+            const auto startTime = std::chrono::high_resolution_clock::now();
+            while (sink->total - startTotal < (1 << 24) and
+                std::chrono::high_resolution_clock::now() - startTime < std::chrono::seconds(10))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(mutex);
+                numThreadIds = threadIds.size();
+                if (not autoFusion and numThreadIds > 1) break;
+            }
+        }
+
+        POTHOS_TEST_TRUE(sink->total > 0);
+        if (autoFusion) POTHOS_TEST_EQUAL(numThreadIds, 1);
+        if (not autoFusion) POTHOS_TEST_TRUE(numThreadIds > 1);
+    }
+}
+
+/***********************************************************************
+ * An elastic pool adds threads while it is fully utilized
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_elastic)
+{
+    Pothos::ThreadPoolArgs args(1/*threads*/);
+    args.maxThreads = 4;
+    args.elasticPeriodNs = 10000000; //10 ms
+
+    std::mutex mutex;
+    std::set<std::thread::id> threadIds;
+    std::vector<std::shared_ptr<Pothos::Block>> blocks;
+    {
+        //the pool is set before activation so only pool threads are recorded
+        Pothos::ThreadPool threadPool(args);
+        Pothos::Topology topology;
+        for (size_t i = 0; i < 8; i++)
+        {
+            std::shared_ptr<Pothos::Block> source(new ThroughputSource());
+            std::shared_ptr<Pothos::Block> recorder(new ThroughputRecorder(mutex, threadIds));
+            std::shared_ptr<Pothos::Block> sink(new ThroughputSink());
+            topology.connect(source, 0, recorder, 0);
+            topology.connect(recorder, 0, sink, 0);
+            blocks.push_back(source);
+            blocks.push_back(recorder);
+            blocks.push_back(sink);
+        }
+        for (const auto &block : blocks) block->setThreadPool(threadPool);
+        topology.commit();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    std::cout << "Elastic pool used " << threadIds.size() << " threads" << std::endl;
+    POTHOS_TEST_TRUE(threadIds.size() > 1);
+    POTHOS_TEST_TRUE(threadIds.size() <= 4);
 }
+
+/***********************************************************************
+ * Measure the latency of topology commits versus the block count:
+ * Pairs of idle blocks are committed into a pool,
+ * and then moved into another pool, which unregisters
+ * and registers every block while the others are running.
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_commit_latency)
+{
+    for (const size_t numThreads : {0, 4})
+    for (const size_t numBlocks : {16, 64, 256})
+    {
+        Pothos::ThreadPoolArgs args(numThreads);
+        Pothos::ThreadPool threadPool(args);
+        std::vector<std::shared_ptr<Pothos::Block>> blocks;
+        for (size_t i = 0; i < numBlocks/2; i++)
+        {
+            blocks.push_back(std::shared_ptr<Pothos::Block>(new MessageForwarder()));
+            blocks.push_back(std::shared_ptr<Pothos::Block>(new MessageCounter()));
+        }
+
+        Pothos::Topology topology;
+        topology.setThreadPool(threadPool);
+        for (size_t i = 0; i < blocks.size(); i += 2)
+        {
+            topology.connect(blocks[i], 0, blocks[i+1], 0);
+        }
+
+        //the commit moves every block into the pool
+        const auto startCommit = std::chrono::high_resolution_clock::now();
+        topology.commit();
+        const auto commitTime = std::chrono::high_resolution_clock::now() - startCommit;
+
+        //moving the blocks into another pool unregisters and registers every block
+        Pothos::ThreadPool otherPool(args);
+        const auto startMove = std::chrono::high_resolution_clock::now();
+        for (const auto &block : blocks) block->setThreadPool(otherPool);
+        const auto moveTime = std::chrono::high_resolution_clock::now() - startMove;
+
+        topology.disconnectAll();
+        topology.commit();
+
+        std::cout << "Commit latency with " << numThreads << " threads, " << numBlocks << " blocks: "
+            << std::chrono::duration<double, std::milli>(commitTime).count() << " ms commit, "
+            << std::chrono::duration<double, std::milli>(moveTime).count() << " ms move" << std::endl;
+        POTHOS_TEST_TRUE(commitTime.count() > 0);
+    }
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_realtime_profile)
+{
+    Pothos::ThreadPoolArgs args(2);
+    args.profile = "REALTIME";
+    std::shared_ptr<MessageSource> source(new MessageSource(100));
+    std::shared_ptr<MessageCounter> counter(new MessageCounter());
+
+    {
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(args));
+        topology.connect(source, 0, counter, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+
+        //the allocations are only counted with the preloaded counter library
+        const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+        const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(source->uid());
+        POTHOS_TEST_TRUE(stats->has("numWorkAllocations"));
+        const auto numAllocations = stats->getValue<Poco::UInt64>("numWorkAllocations");
+        std::cout << "Realtime source: " << numAllocations << " work allocations"
+            << (hasAllocationCounter()?"":" (not counted)") << std::endl;
+
+        //posting a message allocates the message object in work()
+        if (hasAllocationCounter()) POTHOS_TEST_TRUE(numAllocations > 0);
+        if (not hasAllocationCounter()) POTHOS_TEST_EQUAL(numAllocations, 0);
+
+        //the blocks in a realtime pool are flagged until they leave the pool
+        POTHOS_TEST_TRUE(source->_actor->realtimeProfile);
+        source->setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(1)));
+        POTHOS_TEST_TRUE(not source->_actor->realtimeProfile);
+        source->setThreadPool(Pothos::ThreadPool());
+        POTHOS_TEST_TRUE(not source->_actor->realtimeProfile);
+    }
+
+    POTHOS_TEST_EQUAL(counter->count.load(), 100);
+}
+
+/***********************************************************************
+ * Helper block to post messages at a fixed period
+ * using the timer service rather than polling
+ **********************************************************************/
+struct PacedSource : Pothos::Block
+{
+    PacedSource(const int numMessages, const long long periodNs):
+        numMessages(numMessages),
+        period(periodNs),
+        count(0)
+    {
+        this->setupOutput(0);
+    }
+
+    void activate(void)
+    {
+        next = std::chrono::steady_clock::now();
+    }
+
+    void work(void)
+    {
+        if (count == numMessages) return;
+
+        //work() may be called early by other changes
+        if (std::chrono::steady_clock::now() < next) return this->yieldUntil(next);
+
+        this->output(0)->postMessage(count++);
+        next += period;
+        this->yieldUntil(next);
+    }
+
+    const int numMessages;
+    const std::chrono::nanoseconds period;
+    std::chrono::steady_clock::time_point next;
+    int count;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_timer_service)
+{
+    for (const size_t numThreads : {0, 2})
+    {
+        std::shared_ptr<PacedSource> source(new PacedSource(10, 5000000/*5ms*/));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(numThreads)));
+        topology.connect(source, 0, counter, 0);
+        const auto start = std::chrono::steady_clock::now();
+        topology.commit();
+
+        //the source sleeps between messages rather than polling
+        while (counter->count.load() != 10)
+        {
+            POTHOS_TEST_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        POTHOS_TEST_TRUE(elapsed >= std::chrono::milliseconds(45));
+
+        const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+        const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(source->uid());
+        const auto numWorkCalls = stats->getValue<Poco::UInt64>("numWorkCalls");
+        std::cout << "Paced source with " << numThreads << " threads: " << numWorkCalls << " work calls" << std::endl;
+        POTHOS_TEST_TRUE(numWorkCalls < 100);
+    }
+}
+
+#ifdef __linux__
+
+/***********************************************************************
+ * Helper block to post a message for every byte read from a pipe,
+ * work() is only called when the pipe becomes readable
+ **********************************************************************/
+struct PipeReader : Pothos::Block
+{
+    PipeReader(const int fd):
+        fd(fd),
+        numWorkCalls(0)
+    {
+        this->setupOutput(0);
+        this->registerFileDescriptor(fd, true);
+    }
+
+    ~PipeReader(void)
+    {
+        this->unregisterFileDescriptor(fd);
+    }
+
+    void work(void)
+    {
+        numWorkCalls++;
+        char buff[16];
+        const auto ret = read(fd, buff, sizeof(buff));
+        for (ssize_t i = 0; i < ret; i++) this->output(0)->postMessage(buff[i]);
+    }
+
+    const int fd;
+    std::atomic<int> numWorkCalls;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests", test_thread_pool_file_descriptor)
+{
+    POTHOS_TEST_THROWS(Pothos::Block().registerFileDescriptor(-1, true), Pothos::ThreadPoolError);
+
+    for (const size_t numThreads : {0, 2})
+    {
+        int fds[2];
+        POTHOS_TEST_EQUAL(pipe(fds), 0);
+        POTHOS_TEST_EQUAL(fcntl(fds[0], F_SETFL, O_NONBLOCK), 0);
+
+        std::shared_ptr<PipeReader> reader(new PipeReader(fds[0]));
+        std::shared_ptr<MessageCounter> counter(new MessageCounter());
+
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(numThreads)));
+            topology.connect(reader, 0, counter, 0);
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+
+            //the reader is idle while the pipe is empty
+            const int idleWorkCalls = reader->numWorkCalls.load();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            POTHOS_TEST_TRUE(reader->numWorkCalls.load() - idleWorkCalls < 5);
+
+            //every byte written wakes the reader
+            for (int i = 0; i < 10; i++)
+            {
+                POTHOS_TEST_EQUAL(write(fds[1], "x", 1), 1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            const auto start = std::chrono::steady_clock::now();
+            while (counter->count.load() != 10)
+            {
+                POTHOS_TEST_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        reader.reset();
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+#endif //__linux__
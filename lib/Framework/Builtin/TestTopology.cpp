@@ -3,10 +3,19 @@
 
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework.hpp>
+#include <Pothos/Remote.hpp>
+#include <Pothos/Util/Network.hpp>
+#include <Pothos/System/NumaInfo.hpp>
 #include <Poco/JSON/Object.h>
 #include <Poco/JSON/Array.h>
 #include <Poco/JSON/Parser.h>
+#include "Framework/NumaPlacement.hpp"
+#include "Framework/WorkerActor.hpp"
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <set>
 
 /***********************************************************************
  * Helper blocks to test the rendered flow of the topology
@@ -607,3 +616,507 @@ POTHOS_TEST_BLOCK("/framework/tests/topology", test_independent_passthrough)
         POTHOS_TEST_TRUE(connectionsHave(connsArray, pingInner->uid(), "out0", pongInner->uid(), "in0"));
     }
 }
+
+/***********************************************************************
+ * Test automatic NUMA placement of connected blocks
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_numa_auto_placement)
+{
+    //two independent ping pong pairs
+    auto ping0 = std::shared_ptr<Ping>(new Ping("0"));
+    auto pong0 = std::shared_ptr<Pong>(new Pong("0"));
+    auto ping1 = std::shared_ptr<Ping>(new Ping("1"));
+    auto pong1 = std::shared_ptr<Pong>(new Pong("1"));
+
+    //the explicit placement hint of a block is kept
+    ping1->setThreadAffinity("NUMA", {0});
+
+    Pothos::Topology topology;
+    POTHOS_TEST_TRUE(not topology.getAutoPlacement());
+    topology.setAutoPlacement(true);
+    topology.connect(ping0, "out0", pong0, "in0");
+    topology.connect(ping1, "out0", pong1, "in0");
+    topology.commit();
+
+    //check that the messages flowed
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    POTHOS_TEST_EQUAL(pong0->triggered, 1);
+    POTHOS_TEST_EQUAL(pong1->triggered, 1);
+    POTHOS_TEST_EQUAL(ping1->getThreadAffinityMode(), "NUMA");
+
+    //the placement hints are not changed by automatic placement
+    POTHOS_TEST_TRUE(ping0->getThreadAffinityMode().empty());
+    POTHOS_TEST_TRUE(pong0->getThreadAffinityMode().empty());
+    POTHOS_TEST_TRUE(pong1->getThreadAffinityMode().empty());
+
+    //helper to query the assigned node from the stats
+    auto placementNode = [&topology](const std::string &uid)
+    {
+        const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+        const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(uid);
+        return stats->getValue<Poco::Int64>("placementNode");
+    };
+
+    //single node systems are not placed
+    if (Pothos::System::NumaInfo::get().size() < 2)
+    {
+        POTHOS_TEST_EQUAL(placementNode(ping0->uid()), -1);
+        POTHOS_TEST_EQUAL(placementNode(pong1->uid()), -1);
+        return;
+    }
+
+    //connected blocks were placed on the same node
+    POTHOS_TEST_TRUE(placementNode(ping0->uid()) >= 0);
+    POTHOS_TEST_EQUAL(placementNode(ping0->uid()), placementNode(pong0->uid()));
+    POTHOS_TEST_EQUAL(placementNode(pong1->uid()), 0);
+
+    //disabling placement clears the assigned nodes
+    topology.setAutoPlacement(false);
+    topology.commit();
+    POTHOS_TEST_EQUAL(placementNode(ping0->uid()), -1);
+    POTHOS_TEST_EQUAL(placementNode(pong0->uid()), -1);
+    POTHOS_TEST_EQUAL(placementNode(pong1->uid()), -1);
+}
+
+/***********************************************************************
+ * Test the NUMA node assignment for any number of nodes
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_numa_assign_nodes)
+{
+    //two connected pairs a-b and c-d
+    const std::vector<std::string> pairs{"a", "b", "c", "d"};
+    std::map<std::string, std::set<std::string>> neighbors;
+    neighbors["a"].insert("b");
+    neighbors["b"].insert("a");
+    neighbors["c"].insert("d");
+    neighbors["d"].insert("c");
+
+    //a single node takes every block
+    {
+        const auto result = assignNumaNodes(1, pairs, neighbors, {});
+        POTHOS_TEST_EQUAL(result.size(), 4);
+        for (const auto &pair : result) POTHOS_TEST_EQUAL(pair.second, 0);
+    }
+
+    //each pair is kept together on its own node
+    {
+        auto result = assignNumaNodes(2, pairs, neighbors, {});
+        POTHOS_TEST_EQUAL(result.size(), 4);
+        POTHOS_TEST_EQUAL(result["a"], result["b"]);
+        POTHOS_TEST_EQUAL(result["c"], result["d"]);
+        POTHOS_TEST_TRUE(result["a"] != result["c"]);
+    }
+
+    //fixed blocks keep their node and pull their neighbors
+    {
+        std::map<std::string, size_t> fixed;
+        fixed["c"] = 1;
+        auto result = assignNumaNodes(2, pairs, neighbors, fixed);
+        POTHOS_TEST_EQUAL(result.size(), 3);
+        POTHOS_TEST_EQUAL(result.count("c"), 0);
+        POTHOS_TEST_EQUAL(result["d"], 1);
+        POTHOS_TEST_EQUAL(result["a"], 0);
+        POTHOS_TEST_EQUAL(result["b"], 0);
+    }
+
+    //a long chain is split over the nodes within the capacity
+    {
+        std::vector<std::string> chain;
+        std::map<std::string, std::set<std::string>> links;
+        for (size_t i = 0; i < 8; i++)
+        {
+            chain.push_back(std::to_string(i));
+            if (i == 0) continue;
+            links[chain[i-1]].insert(chain[i]);
+            links[chain[i]].insert(chain[i-1]);
+        }
+        const auto result = assignNumaNodes(4, chain, links, {});
+        POTHOS_TEST_EQUAL(result.size(), 8);
+        std::vector<size_t> loads(4, 0);
+        for (const auto &pair : result) loads.at(pair.second)++;
+        for (const auto load : loads) POTHOS_TEST_TRUE(load <= 3);
+    }
+}
+
+/***********************************************************************
+ * Helper blocks for data-parallel replication and shm flows:
+ * The source produces a sequence of integers with labels,
+ * the worker copies the sequence after some computations,
+ * and the checker verifies the order of the sequence and labels.
+ * The worker optionally drops the labels like a block
+ * which overrides propagateLabels() for its own labels.
+ **********************************************************************/
+struct LabeledSource : Pothos::Block
+{
+    static Pothos::Block *make(const unsigned total)
+    {
+        return new LabeledSource(total);
+    }
+
+    LabeledSource(const unsigned total):
+        next(0),
+        total(total)
+    {
+        this->setupOutput(0, "uint32");
+    }
+
+    void work(void)
+    {
+        auto out0 = this->output(0);
+        const size_t n = std::min<size_t>(out0->elements(), total-next);
+        auto p = out0->buffer().as<unsigned *>();
+        for (size_t i = 0; i < n; i++)
+        {
+            if ((next+i)%100 == 0) out0->postLabel(Pothos::Label("mark", unsigned(next+i), i));
+            p[i] = unsigned(next+i);
+        }
+        next += unsigned(n);
+        out0->produce(n);
+    }
+
+    unsigned next;
+    const unsigned total;
+};
+
+//registered for the flows from another process
+static Pothos::BlockRegistry registerLabeledSource("/tests/labeled_source", &LabeledSource::make);
+
+struct ReplicableWorker : Pothos::Block
+{
+    ReplicableWorker(const size_t rounds, const bool dropLabels = false):
+        rounds(rounds),
+        dropLabels(dropLabels),
+        scratch(0)
+    {
+        this->setupInput(0, "uint32");
+        this->setupOutput(0, "uint32");
+    }
+
+    std::shared_ptr<Pothos::Block> replicate(void)
+    {
+        return std::shared_ptr<Pothos::Block>(new ReplicableWorker(rounds, dropLabels));
+    }
+
+    void propagateLabels(const Pothos::InputPort *input)
+    {
+        if (not dropLabels) Pothos::Block::propagateLabels(input);
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        auto out0 = this->output(0);
+        const size_t n = std::min(in0->elements(), out0->elements());
+        const auto in = in0->buffer().as<const unsigned *>();
+        auto out = out0->buffer().as<unsigned *>();
+        for (size_t i = 0; i < n; i++)
+        {
+            unsigned x = in[i];
+            for (size_t r = 0; r < rounds; r++) x = x*1664525u + 1013904223u;
+            scratch += x;
+            out[i] = in[i];
+        }
+        in0->consume(n);
+        out0->produce(n);
+    }
+
+    const size_t rounds;
+    const bool dropLabels;
+    unsigned scratch;
+};
+
+struct FixedWorker : ReplicableWorker
+{
+    FixedWorker(void):
+        ReplicableWorker(1)
+    {
+        return;
+    }
+
+    std::shared_ptr<Pothos::Block> replicate(void)
+    {
+        return nullptr; //does not opt into replication
+    }
+};
+
+struct RateWorker : Pothos::Block
+{
+    RateWorker(const bool interpolate):
+        interpolate(interpolate)
+    {
+        this->setupInput(0, "uint32");
+        this->setupOutput(0, "uint32");
+    }
+
+    std::shared_ptr<Pothos::Block> replicate(void)
+    {
+        return std::shared_ptr<Pothos::Block>(new RateWorker(interpolate));
+    }
+
+    void propagateLabels(const Pothos::InputPort *)
+    {
+        //the labels are not adjusted for the rate
+    }
+
+    void work(void)
+    {
+        //interpolate x to 2x, 2x+1 or decimate even x to x/2,
+        //so that the output remains a sequence of integers
+        auto in0 = this->input(0);
+        auto out0 = this->output(0);
+        const auto in = in0->buffer().as<const unsigned *>();
+        auto out = out0->buffer().as<unsigned *>();
+        size_t n = 0, m = 0;
+        if (interpolate) for (; n < in0->elements() and m+2 <= out0->elements(); n++)
+        {
+            out[m++] = in[n]*2;
+            out[m++] = in[n]*2+1;
+        }
+        else for (; n < in0->elements() and m < out0->elements(); n++)
+        {
+            if (in[n]%2 == 0) out[m++] = in[n]/2;
+        }
+        in0->consume(n);
+        out0->produce(m);
+    }
+
+    const bool interpolate;
+};
+
+struct LabeledChecker : Pothos::Block
+{
+    LabeledChecker(void):
+        count(0),
+        numLabels(0),
+        numErrors(0)
+    {
+        this->setupInput(0, "uint32");
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        const size_t n = in0->elements();
+        const auto p = in0->buffer().as<const unsigned *>();
+        for (const auto &label : in0->labels())
+        {
+            if (label.index >= n) break;
+            if (label.id != "mark" or label.data.extract<unsigned>() != p[label.index]) numErrors++;
+            else numLabels++;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (p[i] != count++) numErrors++;
+        }
+        in0->consume(n);
+    }
+
+    std::atomic<unsigned> count;
+    std::atomic<unsigned> numLabels;
+    std::atomic<unsigned> numErrors;
+};
+
+/***********************************************************************
+ * Replicate a block across the pool and reassemble its output in order
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_replication)
+{
+    for (const bool dropLabels : {false, true})
+    for (const size_t frameSize : {0, 64})
+    {
+        std::shared_ptr<LabeledSource> source(new LabeledSource(100000));
+        std::shared_ptr<Pothos::Block> worker(new ReplicableWorker(1, dropLabels));
+        std::shared_ptr<LabeledChecker> checker(new LabeledChecker());
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(4/*threads*/)));
+            topology.connect(source, 0, worker, 0);
+            topology.connect(worker, 0, checker, 0);
+            POTHOS_TEST_EQUAL(topology.getReplication(Pothos::Object(worker)), 1);
+            topology.setReplication(Pothos::Object(worker), 4, frameSize);
+            POTHOS_TEST_EQUAL(topology.getReplication(Pothos::Object(worker)), 4);
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+
+        //the merge does not depend on the labels of the replicas
+        POTHOS_TEST_EQUAL(checker->count.load(), 100000);
+        POTHOS_TEST_EQUAL(checker->numLabels.load(), dropLabels?0:1000);
+        POTHOS_TEST_EQUAL(checker->numErrors.load(), 0);
+    }
+
+    //replicas which change the rate are merged in order
+    for (const bool interpolate : {false, true})
+    for (const size_t frameSize : {0, 64})
+    {
+        std::shared_ptr<LabeledSource> source(new LabeledSource(100000));
+        std::shared_ptr<Pothos::Block> worker(new RateWorker(interpolate));
+        std::shared_ptr<LabeledChecker> checker(new LabeledChecker());
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(4/*threads*/)));
+            topology.connect(source, 0, worker, 0);
+            topology.connect(worker, 0, checker, 0);
+            topology.setReplication(Pothos::Object(worker), 4, frameSize);
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+        POTHOS_TEST_EQUAL(checker->count.load(), interpolate?200000:50000);
+        POTHOS_TEST_EQUAL(checker->numErrors.load(), 0);
+    }
+
+    //a block which does not opt into replication throws on commit
+    {
+        std::shared_ptr<Pothos::Block> source(new LabeledSource(100));
+        std::shared_ptr<Pothos::Block> worker(new FixedWorker());
+        std::shared_ptr<Pothos::Block> checker(new LabeledChecker());
+        Pothos::Topology topology;
+        topology.connect(source, 0, worker, 0);
+        topology.connect(worker, 0, checker, 0);
+        topology.setReplication(Pothos::Object(worker), 2);
+        POTHOS_TEST_THROWS(topology.commit(), Pothos::TopologyConnectError);
+    }
+}
+
+/***********************************************************************
+ * Measure the scaling of a computational block from 1 to 4 replicas
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_replication_scaling)
+{
+    for (const size_t numReplicas : {1, 2, 4})
+    {
+        std::shared_ptr<LabeledSource> source(new LabeledSource(~0u));
+        std::shared_ptr<Pothos::Block> worker(new ReplicableWorker(64));
+        std::shared_ptr<LabeledChecker> checker(new LabeledChecker());
+        double bytesPerSec = 0.0;
+        {
+            Pothos::Topology topology;
+            topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(numReplicas+2)));
+            topology.connect(source, 0, worker, 0);
+            topology.connect(worker, 0, checker, 0);
+            topology.setReplication(Pothos::Object(worker), numReplicas, 4096);
+            topology.commit();
+            const auto startTime = std::chrono::high_resolution_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            const auto totalBytes = checker->count.load()*sizeof(unsigned);
+            const auto elapsed = std::chrono::high_resolution_clock::now() - startTime;
+            bytesPerSec = totalBytes/std::chrono::duration<double>(elapsed).count();
+        }
+        std::cout << numReplicas << " replicas throughput: " << (bytesPerSec/1e6) << " MB/s" << std::endl;
+        POTHOS_TEST_TRUE(bytesPerSec > 0.0);
+        POTHOS_TEST_EQUAL(checker->numErrors.load(), 0);
+    }
+}
+
+/***********************************************************************
+ * The task of a placed block is shared by the threads of its node
+ **********************************************************************/
+struct ThreadRecorder : Pothos::Block
+{
+    ThreadRecorder(void):
+        count(0),
+        record(false)
+    {
+        this->setupInput(0, "uint32");
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        if (in0->elements() == 0) return;
+        count += unsigned(in0->elements());
+        in0->consume(in0->elements());
+        if (record) threads.insert(std::this_thread::get_id());
+    }
+
+    unsigned count;
+    std::atomic<bool> record;
+    std::set<std::thread::id> threads;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_numa_thread_placement)
+{
+    //two nodes of the system, the affinity of a missing node only logs
+    const auto numaInfo = Pothos::System::NumaInfo::get();
+    const long node0 = long(numaInfo.at(0).nodeNumber);
+    const long node1 = (numaInfo.size() < 2)?(node0+1):long(numaInfo.at(1).nodeNumber);
+
+    //place each chain on a node like the automatic placement
+    std::vector<std::shared_ptr<Pothos::Block>> sources;
+    std::vector<std::shared_ptr<ThreadRecorder>> recorders;
+    for (const long node : {node0, node1})
+    {
+        sources.emplace_back(new LabeledSource(10000000));
+        recorders.emplace_back(new ThreadRecorder());
+        sources.back()->_actor->placementNode = node;
+        recorders.back()->_actor->placementNode = node;
+    }
+
+    {
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(4/*threads*/)));
+        for (size_t i = 0; i < sources.size(); i++) topology.connect(sources[i], 0, recorders[i], 0);
+        topology.commit();
+
+        //record once every task was registered with the final threads
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (const auto &recorder : recorders) recorder->record = true;
+        POTHOS_TEST_TRUE(topology.waitInactive(0.1, 10.0));
+    }
+
+    //each node has its own threads, and a block may run on several of them
+    for (const auto &recorder : recorders)
+    {
+        POTHOS_TEST_EQUAL(recorder->count, 10000000);
+        POTHOS_TEST_TRUE(not recorder->threads.empty());
+        POTHOS_TEST_TRUE(recorder->threads.size() <= 2);
+    }
+    for (const auto &id : recorders[0]->threads)
+    {
+        POTHOS_TEST_EQUAL(recorders[1]->threads.count(id), 0);
+    }
+}
+
+/***********************************************************************
+ * A flow from a second process on the same host passes through
+ * shared memory, or through the network without shm flows
+ **********************************************************************/
+POTHOS_TEST_BLOCK("/framework/tests/topology", test_shm_flow)
+{
+    Pothos::RemoteServer server("tcp://"+Pothos::Util::getWildcardAddr());
+    Pothos::RemoteClient client("tcp://"+Pothos::Util::getLoopbackAddr(server.getActualPort()));
+    auto env = client.makeEnvironment("managed");
+    POTHOS_TEST_TRUE(env->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid());
+    POTHOS_TEST_EQUAL(env->getNodeId(), Pothos::ProxyEnvironment::make("managed")->getNodeId());
+
+    auto source = env->findProxy("Pothos/BlockRegistry").callProxy("/tests/labeled_source", 100000);
+    std::shared_ptr<LabeledChecker> checker(new LabeledChecker());
+    bool usesShm = false, usesNetwork = false;
+    {
+        Pothos::Topology topology;
+        topology.connect(source, 0, checker, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+
+        //the rendered topology has the blocks which carry the flow
+        const auto result = Poco::JSON::Parser().parse(topology.dumpJSON("{\"mode\":\"rendered\"}"));
+        const auto blocks = result.extract<Poco::JSON::Object::Ptr>()->getObject("blocks");
+        std::vector<std::string> uids; blocks->getNames(uids);
+        for (const auto &uid : uids)
+        {
+            const auto name = blocks->getObject(uid)->getValue<std::string>("name");
+            if (name.find("ShmFrom: ") == 0) usesShm = true;
+            if (name.find("NetFrom: ") == 0) usesNetwork = true;
+        }
+    }
+
+    #ifdef __linux__
+    POTHOS_TEST_TRUE(usesShm);
+    POTHOS_TEST_TRUE(not usesNetwork);
+    #else
+    POTHOS_TEST_TRUE(usesNetwork);
+    #endif
+    POTHOS_TEST_EQUAL(checker->count.load(), 100000);
+    POTHOS_TEST_EQUAL(checker->numLabels.load(), 1000);
+    POTHOS_TEST_EQUAL(checker->numErrors.load(), 0);
+}
@@ -1,8 +1,12 @@
-// Copyright (c) 2014-2014 Josh Blum
+// Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework.hpp>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Parser.h>
+#include <algorithm> //min
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <iostream>
@@ -125,3 +129,283 @@ POTHOS_TEST_BLOCK("/framework/tests", test_activate_throw)
         POTHOS_TEST_THROWS(t.commit(), Pothos::TopologyConnectError);
     }
 }
+
+/***********************************************************************
+ * Helper blocks for the buffer handoff:
+ * The source produces a sequence of integers with labels,
+ * and the checker verifies the order of the sequence and labels.
+ **********************************************************************/
+struct SequenceSource : Pothos::Block
+{
+    SequenceSource(const unsigned total):
+        next(0),
+        total(total)
+    {
+        this->setupOutput(0, "uint32");
+    }
+
+    void work(void)
+    {
+        auto out0 = this->output(0);
+        const size_t n = std::min<size_t>(out0->elements(), total-next);
+        auto p = out0->buffer().as<unsigned *>();
+        for (size_t i = 0; i < n; i++)
+        {
+            if ((next+i)%100 == 0) out0->postLabel(Pothos::Label("mark", unsigned(next+i), i));
+            p[i] = unsigned(next+i);
+        }
+        next += unsigned(n);
+        out0->produce(n);
+    }
+
+    unsigned next;
+    const unsigned total;
+};
+
+struct SequenceChecker : Pothos::Block
+{
+    SequenceChecker(void):
+        count(0),
+        numLabels(0),
+        numErrors(0)
+    {
+        this->setupInput(0, "uint32");
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        const size_t n = in0->elements();
+        const auto p = in0->buffer().as<const unsigned *>();
+        for (const auto &label : in0->labels())
+        {
+            if (label.index >= n) break;
+            if (label.id != "mark" or label.data.extract<unsigned>() != p[label.index]) numErrors++;
+            else numLabels++;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (p[i] != count++) numErrors++;
+        }
+        in0->consume(n);
+    }
+
+    std::atomic<unsigned> count;
+    std::atomic<unsigned> numLabels;
+    std::atomic<unsigned> numErrors;
+};
+
+/***********************************************************************
+ * The only subscriber of an input hands off buffers without a lock,
+ * and inputs with fan-in fall back to the locked handoff
+ **********************************************************************/
+static bool hasLockFreeHandoff(Pothos::Topology &topology, const std::string &uid)
+{
+    const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+    const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(uid);
+    return stats->getArray("inputStats")->getObject(0)->getValue<bool>("lockFreeHandoff");
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_buffer_handoff)
+{
+    std::shared_ptr<SequenceSource> source0(new SequenceSource(100000));
+    std::shared_ptr<SequenceSource> source1(new SequenceSource(100000));
+    std::shared_ptr<SequenceChecker> checker0(new SequenceChecker());
+    std::shared_ptr<SequenceChecker> checker1(new SequenceChecker());
+    {
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(2/*threads*/)));
+
+        //a single edge keeps the order of the buffers and labels
+        topology.connect(source0, 0, checker0, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+        POTHOS_TEST_TRUE(hasLockFreeHandoff(topology, checker0->uid()));
+
+        //the finished source and another source make fan-in on the other checker
+        topology.connect(source0, 0, checker1, 0);
+        topology.connect(source1, 0, checker1, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+        POTHOS_TEST_TRUE(not hasLockFreeHandoff(topology, checker1->uid()));
+    }
+    POTHOS_TEST_EQUAL(checker0->count.load(), 100000);
+    POTHOS_TEST_EQUAL(checker0->numLabels.load(), 1000);
+    POTHOS_TEST_EQUAL(checker0->numErrors.load(), 0);
+    POTHOS_TEST_EQUAL(checker1->count.load(), 100000);
+}
+
+/***********************************************************************
+ * A full message queue drops or blocks according to the overflow policy
+ **********************************************************************/
+struct MessagePoster : Pothos::Block
+{
+    MessagePoster(const int numMessages):
+        numMessages(numMessages),
+        count(0)
+    {
+        this->setupOutput(0);
+    }
+
+    void work(void)
+    {
+        if (count == numMessages) return;
+        this->output(0)->postMessage(count++);
+    }
+
+    const int numMessages;
+    int count;
+};
+
+struct MessageStall : Pothos::Block
+{
+    MessageStall(const size_t capacity, const std::string &overflowPolicy)
+    {
+        this->setupInput(0);
+        this->input(0)->setMessageQueue(capacity, overflowPolicy);
+    }
+
+    void work(void)
+    {
+        //never pop the messages so that the queue fills
+    }
+};
+
+static Poco::JSON::Object::Ptr getInputStats(Pothos::Topology &topology, const std::string &uid)
+{
+    const auto result = Poco::JSON::Parser().parse(topology.queryJSONStats());
+    const auto stats = result.extract<Poco::JSON::Object::Ptr>()->getObject(uid);
+    return stats->getArray("inputStats")->getObject(0);
+}
+
+POTHOS_TEST_BLOCK("/framework/tests", test_message_overflow)
+{
+    //invalid settings throw
+    MessageStall stall(4, "BLOCK");
+    POTHOS_TEST_THROWS(stall.input(0)->setMessageQueue(4, "FAIL"), Pothos::PortAccessError);
+    POTHOS_TEST_THROWS(stall.input(0)->setMessageQueue(0, "BLOCK"), Pothos::PortAccessError);
+
+    for (const auto &policy : {"BLOCK", "DROP_OLDEST", "DROP_NEWEST"})
+    {
+        std::shared_ptr<MessagePoster> source(new MessagePoster(100));
+        std::shared_ptr<MessageStall> sink(new MessageStall(4, policy));
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(2/*threads*/)));
+        topology.connect(source, 0, sink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+
+        const auto stats = getInputStats(topology, sink->uid());
+        std::cout << policy << " overflow: " << source->count << " posted, "
+            << stats->getValue<Poco::UInt64>("droppedMessages") << " dropped" << std::endl;
+        POTHOS_TEST_EQUAL(stats->getValue<Poco::UInt64>("enqueuedMessages"), 4);
+        if (std::string(policy) == "BLOCK")
+        {
+            //the source is held back while the queue is full
+            POTHOS_TEST_EQUAL(source->count, 4);
+            POTHOS_TEST_EQUAL(stats->getValue<Poco::UInt64>("droppedMessages"), 0);
+        }
+        else
+        {
+            //dropped messages return their tokens to the source
+            POTHOS_TEST_EQUAL(source->count, 100);
+            POTHOS_TEST_EQUAL(stats->getValue<Poco::UInt64>("droppedMessages"), 96);
+        }
+    }
+}
+
+/***********************************************************************
+ * A burst of messages larger than the queue within one work call
+ **********************************************************************/
+struct MessageBurster : Pothos::Block
+{
+    MessageBurster(const int numMessages):
+        numMessages(numMessages),
+        count(0)
+    {
+        this->setupOutput(0);
+    }
+
+    void work(void)
+    {
+        while (count < numMessages) this->output(0)->postMessage(count++);
+    }
+
+    const int numMessages;
+    int count;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests", test_message_overflow_burst)
+{
+    //the upstream block is only held back between work calls,
+    //so the messages beyond the capacity are dropped as the newest
+    for (const auto &policy : {"DROP_NEWEST", "BLOCK"})
+    {
+        std::shared_ptr<MessageBurster> source(new MessageBurster(100));
+        std::shared_ptr<MessageStall> sink(new MessageStall(4, policy));
+
+        Pothos::Topology topology;
+        topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(2/*threads*/)));
+        topology.connect(source, 0, sink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+
+        const auto stats = getInputStats(topology, sink->uid());
+        POTHOS_TEST_EQUAL(source->count, 100);
+        POTHOS_TEST_EQUAL(stats->getValue<Poco::UInt64>("enqueuedMessages"), 4);
+        POTHOS_TEST_EQUAL(stats->getValue<Poco::UInt64>("droppedMessages"), 96);
+    }
+}
+
+/***********************************************************************
+ * A feedback loop of messages keeps running with the default policy
+ **********************************************************************/
+struct MessageLoop : Pothos::Block
+{
+    MessageLoop(const int numSeeds):
+        numSeeds(numSeeds),
+        count(0)
+    {
+        this->setupInput(0);
+        this->setupOutput(0);
+        this->input(0)->setMessageQueue(4);
+    }
+
+    void work(void)
+    {
+        //seed the loop with a burst larger than the queue
+        for (; numSeeds > 0; numSeeds--) this->output(0)->postMessage(numSeeds);
+
+        auto inPort = this->input(0);
+        while (inPort->hasMessage())
+        {
+            this->output(0)->postMessage(inPort->popMessage());
+            count++;
+        }
+    }
+
+    int numSeeds;
+    std::atomic<unsigned long long> count;
+};
+
+POTHOS_TEST_BLOCK("/framework/tests", test_message_feedback_loop)
+{
+    std::shared_ptr<MessageLoop> loop0(new MessageLoop(16));
+    std::shared_ptr<MessageLoop> loop1(new MessageLoop(16));
+
+    Pothos::Topology topology;
+    topology.setThreadPool(Pothos::ThreadPool(Pothos::ThreadPoolArgs(2/*threads*/)));
+    topology.connect(loop0, 0, loop1, 0);
+    topology.connect(loop1, 0, loop0, 0);
+    topology.commit();
+
+    //both blocks keep forwarding messages rather than waiting on each other
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto count0 = loop0->count.load();
+    const auto count1 = loop1->count.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::cout << "feedback loop: " << loop0->count.load() << ", " << loop1->count.load() << " messages" << std::endl;
+    POTHOS_TEST_TRUE(loop0->count.load() > count0);
+    POTHOS_TEST_TRUE(loop1->count.load() > count1);
+}
@@ -289,6 +289,7 @@ static auto managedDtype = Pothos::ManagedClass()
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, dimension))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, size))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, toString))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, toMarkup))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, isCustom))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, isFloat))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::DType, isInteger))
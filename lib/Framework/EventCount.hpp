@@ -0,0 +1,99 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits> //INT_MAX
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/*!
+ * EventCount is a lock-free wait and notify primitive.
+ * The notifier never takes a lock, and skips the wake-up
+ * system call entirely when there are no waiting threads.
+ *
+ * The waiter protocol is prepareWait(), check the condition,
+ * then cancelWait() when satisfied or wait() otherwise.
+ * A notify() after prepareWait() causes wait() to return.
+ * The notifier must update the condition before notify().
+ *
+ * On Linux the waiting is implemented with a futex,
+ * other systems fall back to a condition variable
+ * which is only used when there is a waiting thread.
+ */
+class EventCount
+{
+public:
+    typedef std::uint32_t Key;
+
+    EventCount(void):
+        _epoch(0),
+        _waiters(0)
+    {
+        return;
+    }
+
+    //! Register the caller as a waiter and get the current epoch
+    Key prepareWait(void)
+    {
+        _waiters.fetch_add(1);
+        return _epoch.load();
+    }
+
+    //! The condition was satisfied after prepareWait()
+    void cancelWait(void)
+    {
+        _waiters.fetch_sub(1);
+    }
+
+    //! Wait for a notification after prepareWait(key)
+    void wait(const Key key)
+    {
+        #ifdef __linux__
+        while (_epoch.load() == key)
+        {
+            syscall(SYS_futex, reinterpret_cast<int *>(&_epoch), FUTEX_WAIT_PRIVATE, int(key), nullptr, nullptr, 0);
+        }
+        #else
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_epoch.load() == key) _cond.wait(lock);
+        #endif
+        _waiters.fetch_sub(1);
+    }
+
+    //! Wake all threads waiting on the event
+    void notify(void)
+    {
+        //pairs with the waiter count increment in prepareWait()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiters.load(std::memory_order_relaxed) == 0) return;
+
+        #ifdef __linux__
+        _epoch.fetch_add(1);
+        syscall(SYS_futex, reinterpret_cast<int *>(&_epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        #else
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _epoch.fetch_add(1);
+        }
+        _cond.notify_all();
+        #endif
+    }
+
+private:
+    std::atomic<Key> _epoch;
+    std::atomic<Key> _waiters;
+    #ifndef __linux__
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    #endif
+};
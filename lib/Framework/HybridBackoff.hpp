@@ -0,0 +1,97 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <algorithm> //min/max
+#include <chrono>
+#include <thread>
+
+/*!
+ * HybridBackoff tracks the idle state of a worker thread.
+ * When no work is available, the thread spins for a while,
+ * then yields the CPU for a while, and finally waits.
+ *
+ * The spin and yield limits adapt to the recently observed
+ * time between running out of work and receiving new work,
+ * so that the thread does not spin or yield for much longer
+ * than twice the average gap, but never beyond the budgets.
+ */
+class HybridBackoff
+{
+public:
+    typedef std::chrono::high_resolution_clock::duration Duration;
+
+    /*!
+     * Create a backoff state for a worker thread.
+     * Budgets of zero will wait immediately when idle.
+     * \param spinBudgetNs the maximum time to spin
+     * \param yieldBudgetNs the maximum time to yield
+     */
+    HybridBackoff(const long long spinBudgetNs, const long long yieldBudgetNs):
+        _spinBudget(std::chrono::nanoseconds(spinBudgetNs)),
+        _yieldBudget(std::chrono::nanoseconds(yieldBudgetNs)),
+        _spinLimit(_spinBudget),
+        _yieldLimit(_yieldBudget),
+        _averageGap(_spinBudget),
+        _idle(false)
+    {
+        return;
+    }
+
+    /*!
+     * Call when the thread performed work.
+     * This ends the idle state and updates the limits.
+     */
+    void reset(void)
+    {
+        if (not _idle) return;
+        _idle = false;
+
+        //moving average of the time spent without work
+        const auto gap = std::chrono::high_resolution_clock::now() - _idleStart;
+        _averageGap += (gap - _averageGap)/8;
+
+        _spinLimit = limit(_spinBudget);
+        _yieldLimit = limit(_yieldBudget);
+    }
+
+    /*!
+     * Call when the thread found no work to perform.
+     * This call yields the CPU after the spin limit expired.
+     * \return true when the caller should wait for work
+     */
+    bool idle(void)
+    {
+        const auto now = std::chrono::high_resolution_clock::now();
+        if (not _idle)
+        {
+            _idle = true;
+            _idleStart = now;
+        }
+
+        const auto elapsed = now - _idleStart;
+        if (elapsed < _spinLimit) return false;
+        if (elapsed < _spinLimit + _yieldLimit)
+        {
+            std::this_thread::yield();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    //! Twice the average gap clamped to a fraction of the budget and the budget
+    Duration limit(const Duration &budget) const
+    {
+        return std::min(budget, std::max(budget/16, 2*_averageGap));
+    }
+
+    const Duration _spinBudget;
+    const Duration _yieldBudget;
+    Duration _spinLimit;
+    Duration _yieldLimit;
+    Duration _averageGap;
+    bool _idle;
+    std::chrono::high_resolution_clock::time_point _idleStart;
+};
@@ -3,15 +3,16 @@
 
 #include <Pothos/Framework/InputPortImpl.hpp>
 #include "Framework/WorkerActor.hpp"
+#include <thread> //yield
 
 /*!
- * An arbitrary bound on the queue size to detect buggy situations
+ * The default capacity of the message queues.
+ * The queues are bounded to detect buggy situations
  * where the downstream block is not consuming an input resource
  * and an upstream block is able to produce without back-pressure.
- * This should probably be a configurable system-wide value,
- * but for now the detection itself is more valuable to have.
+ * The capacity and overflow policy are configurable per port.
  */
-static const size_t MaxQueueCapacity = 1024;
+static const size_t DefaultMessageCapacity = 1024;
 
 Pothos::InputPort::InputPort(void):
     _actor(nullptr),
@@ -24,7 +25,16 @@ Pothos::InputPort::InputPort(void):
     _totalMessages(0),
     _pendingElements(0),
     _reserveElements(0),
-    _workEvents(0)
+    _workEvents(0),
+    _messageOverflowPolicy(MESSAGE_OVERFLOW_DROP_NEWEST),
+    _droppedMessages(0),
+    _asyncMessages(DefaultMessageCapacity),
+    _hasPeekedMessage(false),
+    _slotCalls(DefaultMessageCapacity),
+    _handoffProducer(nullptr),
+    _handoffPushers(0),
+    _handoffSequence(0),
+    _numStagedBatches(0)
 {
     return;
 }
@@ -73,23 +83,59 @@ void Pothos::InputPort::clear(void)
     this->slotCallsClear();
 }
 
-void Pothos::InputPort::asyncMessagesPush(const Pothos::Object &message, const Pothos::BufferChunk &token)
+void Pothos::InputPort::setMessageQueue(const size_t capacity, const std::string &overflowPolicy)
+{
+    if (overflowPolicy == "BLOCK") _messageOverflowPolicy = MESSAGE_OVERFLOW_BLOCK;
+    else if (overflowPolicy == "DROP_OLDEST") _messageOverflowPolicy = MESSAGE_OVERFLOW_DROP_OLDEST;
+    else if (overflowPolicy == "DROP_NEWEST") _messageOverflowPolicy = MESSAGE_OVERFLOW_DROP_NEWEST;
+    else throw PortAccessError("Pothos::InputPort::setMessageQueue()", "unknown overflow policy " + overflowPolicy);
+    if (capacity == 0) throw PortAccessError("Pothos::InputPort::setMessageQueue()", "capacity must be non-zero");
+
+    std::lock_guard<Util::SpinLock> lock(_peekedMessageLock);
+    _peekedMessage = std::pair<Object, BufferChunk>();
+    _hasPeekedMessage = false;
+    _asyncMessages.reset(capacity);
+    _slotCalls.reset(capacity);
+}
+
+bool Pothos::InputPort::messageQueuePush(MessageQueue &queue, const std::pair<Object, BufferChunk> &entry)
 {
+    while (not queue.push(entry))
     {
-        std::lock_guard<Util::SpinLock> lock(_asyncMessagesLock);
-        if (_asyncMessages.full())
-        {
-            if (_asyncMessages.size() >= MaxQueueCapacity)
-            {
-                _asyncMessages.clear();
-                poco_error_f2(Poco::Logger::get("Pothos.InputPort.messages"),
-                    "%s[%s] detected input message overflow condition",
-                    _actor->block->getName(), this->alias());
-            }
-            else _asyncMessages.set_capacity(_asyncMessages.capacity()*2);
-        }
-        _asyncMessages.emplace_back(message, token);
+        if (_messageOverflowPolicy != MESSAGE_OVERFLOW_DROP_OLDEST) return false;
+
+        //drop the oldest message to make room, the token goes back upstream
+        std::pair<Object, BufferChunk> oldest;
+        if (queue.pop(oldest)) this->messageDropped();
     }
+    return true;
+}
+
+bool Pothos::InputPort::messageQueuePop(MessageQueue &queue, std::pair<Object, BufferChunk> &entry)
+{
+    const bool wasFull = queue.full();
+    if (not queue.pop(entry)) return false;
+
+    //upstream blocks are not scheduled while the queue is full, wake them
+    if (wasFull and _messageOverflowPolicy == MESSAGE_OVERFLOW_BLOCK)
+    {
+        for (const auto &subscriber : _subscribers) subscriber->_actor->flagExternalChange();
+    }
+    return true;
+}
+
+void Pothos::InputPort::messageDropped(void)
+{
+    //log the first overflow, the port stats count every dropped message
+    if (_droppedMessages.fetch_add(1) != 0) return;
+    poco_error_f2(Poco::Logger::get("Pothos.InputPort.messages"),
+        "%s[%s] detected input message overflow condition",
+        _actor->block->getName(), this->alias());
+}
+
+void Pothos::InputPort::asyncMessagesPush(const Pothos::Object &message, const Pothos::BufferChunk &token)
+{
+    if (not this->messageQueuePush(_asyncMessages, std::make_pair(message, token))) this->messageDropped();
 
     assert(_actor != nullptr);
     _actor->flagExternalChange();
@@ -97,27 +143,16 @@ void Pothos::InputPort::asyncMessagesPush(const Pothos::Object &message, const P
 
 void Pothos::InputPort::asyncMessagesClear(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_asyncMessagesLock);
-    _asyncMessages.clear();
+    std::pair<Object, BufferChunk> entry;
+    std::lock_guard<Util::SpinLock> lock(_peekedMessageLock);
+    while (_asyncMessages.pop(entry)){}
+    _peekedMessage = std::pair<Object, BufferChunk>();
+    _hasPeekedMessage = false;
 }
 
 void Pothos::InputPort::slotCallsPush(const Pothos::Object &args, const Pothos::BufferChunk &token)
 {
-    {
-        std::lock_guard<Util::SpinLock> lock(_slotCallsLock);
-        if (_slotCalls.full())
-        {
-            if (_slotCalls.size() >= MaxQueueCapacity)
-            {
-                _slotCalls.clear();
-                poco_error_f2(Poco::Logger::get("Pothos.InputPort.slots"),
-                    "%s[%s] detected input slot overflow condition",
-                    _actor->block->getName(), this->alias());
-            }
-            else _slotCalls.set_capacity(_slotCalls.capacity()*2);
-        }
-        _slotCalls.emplace_back(args, token);
-    }
+    if (not this->messageQueuePush(_slotCalls, std::make_pair(args, token))) this->messageDropped();
 
     assert(_actor != nullptr);
     _actor->flagExternalChange();
@@ -125,23 +160,20 @@ void Pothos::InputPort::slotCallsPush(const Pothos::Object &args, const Pothos::
 
 bool Pothos::InputPort::slotCallsEmpty(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_slotCallsLock);
     return _slotCalls.empty();
 }
 
 Pothos::Object Pothos::InputPort::slotCallsPop(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_slotCallsLock);
-    assert(not _slotCalls.empty());
-    auto args = _slotCalls.front().first;
-    _slotCalls.pop_front();
-    return args;
+    std::pair<Object, BufferChunk> entry;
+    this->messageQueuePop(_slotCalls, entry);
+    return entry.first;
 }
 
 void Pothos::InputPort::slotCallsClear(void)
 {
-    std::lock_guard<Util::SpinLock> lock(_slotCallsLock);
-    _slotCalls.clear();
+    std::pair<Object, BufferChunk> entry;
+    while (_slotCalls.pop(entry)){}
 }
 
 void Pothos::InputPort::bufferAccumulatorPushNoLock(const BufferChunk &buffer_)
@@ -165,7 +197,6 @@ void Pothos::InputPort::bufferAccumulatorPushNoLock(const BufferChunk &buffer_)
 void Pothos::InputPort::bufferAccumulatorPop(const size_t numBytes)
 {
     std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
-
     if (numBytes > _bufferAccumulator.getTotalBytesAvailable())
     {
         poco_error_f4(Poco::Logger::get("Pothos.Block.consume"), "%s[%s] overconsumed %z bytes, %z available",
@@ -186,32 +217,119 @@ void Pothos::InputPort::bufferAccumulatorPop(const size_t numBytes)
 
 void Pothos::InputPort::bufferLabelPush(
     const std::vector<Pothos::Label> &postedLabels,
-    const Pothos::Util::RingDeque<Pothos::BufferChunk> &postedBuffers)
+    const Pothos::Util::RingDeque<Pothos::BufferChunk> &postedBuffers,
+    const OutputPort *producer)
 {
+    //the only subscribed output port hands off without a lock,
+    //fan-in and a full handoff queue fall back to the staged batches
+    //the pusher count lets setHandoffProducer() wait for this call
+    _handoffPushers++;
+    auto batch = (producer != nullptr and producer == _handoffProducer.load())?
+        _handoffQueue.back() : nullptr;
+    BufferLabelBatch stagedBatch;
+    if (batch == nullptr) batch = &stagedBatch;
+
+    batch->absoluteLabels = false;
+    batch->labels.assign(postedLabels.begin(), postedLabels.end());
+    batch->buffers.clear();
+    for (size_t i = 0; i < postedBuffers.size(); i++)
     {
-        std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
+        batch->buffers.push_back(postedBuffers[i]);
+    }
 
-        const size_t currentBytes = _bufferAccumulator.getTotalBytesAvailable();
-        const size_t requiredLabelSize = _inputInlineMessages.size() + postedLabels.size();
-        if (_inputInlineMessages.capacity() < requiredLabelSize) _inputInlineMessages.set_capacity(requiredLabelSize);
+    if (batch == &stagedBatch) this->bufferLabelStage(stagedBatch);
+    else
+    {
+        batch->sequence = _handoffSequence.fetch_add(1, std::memory_order_relaxed);
+        _handoffQueue.push();
+    }
+    _handoffPushers--;
 
-        //insert labels (in order) and adjust for the current offset
-        for (const auto &byteOffsetLabel : postedLabels)
-        {
-            auto label = byteOffsetLabel;
-            label.index += currentBytes; //increment by enqueued bytes
-            _inputInlineMessages.push_back(label);
-        }
+    assert(_actor != nullptr);
+    _actor->flagExternalChange();
+}
+
+void Pothos::InputPort::setHandoffProducer(const OutputPort *producer)
+{
+    //disable the lock-free handoff and wait for pushes which may use it,
+    //so that the queue never has two producers during the switch
+    _handoffProducer.store(nullptr);
+    while (_handoffPushers.load() != 0) std::this_thread::yield();
+    _handoffProducer.store(producer);
+}
+
+void Pothos::InputPort::bufferLabelStage(BufferLabelBatch &batch)
+{
+    std::lock_guard<Util::SpinLock> lock(_bufferAccumulatorLock);
+    batch.sequence = _handoffSequence.fetch_add(1, std::memory_order_relaxed);
+    if (_stagedBatches.full()) _stagedBatches.set_capacity(_stagedBatches.capacity()*2);
+    _stagedBatches.push_back(std::move(batch));
+    _numStagedBatches.fetch_add(1, std::memory_order_release);
+}
+
+void Pothos::InputPort::bufferLabelApply(BufferLabelBatch &batch)
+{
+    const size_t currentBytes = _bufferAccumulator.getTotalBytesAvailable();
+    const size_t requiredLabelSize = _inputInlineMessages.size() + batch.labels.size();
+    if (_inputInlineMessages.capacity() < requiredLabelSize) _inputInlineMessages.set_capacity(requiredLabelSize);
+
+    //insert labels (in order) and adjust for the current offset
+    for (const auto &byteOffsetLabel : batch.labels)
+    {
+        auto label = byteOffsetLabel;
+        if (not batch.absoluteLabels) label.index += currentBytes; //increment by enqueued bytes
+        _inputInlineMessages.push_back(label);
+    }
 
-        //push all buffers into the accumulator
-        for (size_t i = 0; i < postedBuffers.size(); i++)
+    //push all buffers into the accumulator
+    for (const auto &buffer : batch.buffers)
+    {
+        this->bufferAccumulatorPushNoLock(buffer);
+    }
+
+    //release the references but keep the capacity for reuse
+    batch.labels.clear();
+    batch.buffers.clear();
+}
+
+void Pothos::InputPort::bufferLabelDrainNoLock(void)
+{
+    //The caller holds the lock: the handoff queue has a single consumer,
+    //and the lock serializes the worker with an external clear().
+
+    //Fast path: only the handoff queue has batches.
+    //The staged count is checked after the batch was observed:
+    //an earlier staged batch from the same producer is then visible.
+    while (true)
+    {
+        auto batch = _handoffQueue.front();
+        if (_numStagedBatches.load(std::memory_order_acquire) != 0) break;
+        if (batch == nullptr) return;
+        this->bufferLabelApply(*batch);
+        _handoffQueue.pop();
+    }
+
+    //Slow path: merge both queues in the order of the batch sequence,
+    //so that the handoff producer's batches remain in order
+    //when the producer switched between the queues.
+    while (not _stagedBatches.empty())
+    {
+        auto batch = _handoffQueue.front();
+        if (batch != nullptr and batch->sequence < _stagedBatches.front().sequence)
         {
-            this->bufferAccumulatorPushNoLock(postedBuffers[i]);
+            this->bufferLabelApply(*batch);
+            _handoffQueue.pop();
+            continue;
         }
+        this->bufferLabelApply(_stagedBatches.front());
+        _stagedBatches.pop_front();
+        _numStagedBatches.fetch_sub(1, std::memory_order_relaxed);
+    }
+    while (auto batch = _handoffQueue.front())
+    {
+        this->bufferLabelApply(*batch);
+        _handoffQueue.pop();
     }
-
-    assert(_actor != nullptr);
-    _actor->flagExternalChange();
 }
 
 #include <Pothos/Managed.hpp>
@@ -233,6 +351,8 @@ static auto managedInputPort = Pothos::ManagedClass()
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, popMessage))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, peekMessage))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, setReserve))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, setMessageQueue))
+    .registerMethod("setMessageQueue", Pothos::Callable(&Pothos::InputPort::setMessageQueue).bind(std::string("DROP_NEWEST"), 2))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, isSlot))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, pushBuffer))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::InputPort, pushLabel))
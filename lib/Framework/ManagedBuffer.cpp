@@ -3,6 +3,8 @@
 
 #include <Pothos/Framework/ManagedBuffer.hpp>
 #include <Pothos/Framework/BufferManager.hpp>
+#include <Pothos/Util/SpinLock.hpp>
+#include <mutex> //lock_guard
 
 Pothos::ManagedBuffer::Impl::Impl(void):
     counter(0),
@@ -12,9 +14,71 @@ Pothos::ManagedBuffer::Impl::Impl(void):
     return;
 }
 
+/***********************************************************************
+ * Pool of Impl objects:
+ * Impls are carved from slabs and recycled through a free list
+ * which is linked through the nextBuffer pointer of each free Impl.
+ * Making and releasing managed buffers only touches the heap
+ * when the pool grows past the number of Impls in use.
+ **********************************************************************/
+static const size_t ImplsPerSlab = 64;
+
+struct ManagedBufferImplPool
+{
+    ManagedBufferImplPool(void):
+        freeList(nullptr)
+    {
+        return;
+    }
+
+    Pothos::Util::SpinLock lock;
+    void *freeList;
+};
+
+static ManagedBufferImplPool &getImplPool(void)
+{
+    //never destroyed, buffers released during static destruction still return Impls
+    static ManagedBufferImplPool *pool = new ManagedBufferImplPool();
+    return *pool;
+}
+
+Pothos::ManagedBuffer::Impl *Pothos::ManagedBuffer::Impl::make(void)
+{
+    auto &pool = getImplPool();
+    std::lock_guard<Util::SpinLock> lock(pool.lock);
+    if (pool.freeList == nullptr)
+    {
+        //the slab is never freed, its Impls are only recycled
+        auto slab = new Impl[ImplsPerSlab];
+        for (size_t i = 0; i < ImplsPerSlab; i++)
+        {
+            slab[i].nextBuffer = static_cast<Impl *>(pool.freeList);
+            pool.freeList = slab+i;
+        }
+    }
+    auto impl = static_cast<Impl *>(pool.freeList);
+    pool.freeList = impl->nextBuffer;
+    impl->nextBuffer = nullptr;
+    return impl;
+}
+
+void Pothos::ManagedBuffer::Impl::recycle(void)
+{
+    //release the memory and manager before recycling
+    counter = 0;
+    weakManager.reset();
+    buffer = SharedBuffer();
+    slabIndex = 0;
+
+    auto &pool = getImplPool();
+    std::lock_guard<Util::SpinLock> lock(pool.lock);
+    nextBuffer = static_cast<Impl *>(pool.freeList);
+    pool.freeList = this;
+}
+
 void Pothos::ManagedBuffer::Impl::cleanup(void)
 {
-    //there is a manager to push to, otherwise delete
+    //there is a manager to push to, otherwise recycle
     std::shared_ptr<BufferManager> manager = weakManager.lock();
     if (manager)
     {
@@ -23,14 +87,18 @@ void Pothos::ManagedBuffer::Impl::cleanup(void)
         manager->pushExternal(mb);
         mb._impl = nullptr;
     }
-    else delete this;
+    else this->recycle();
 }
 
 void Pothos::ManagedBuffer::reset(BufferManager::Sptr manager, const SharedBuffer &buff, const size_t slabIndex)
 {
-    if (_impl == nullptr) _impl = new Impl();
+    if (_impl == nullptr) _impl = Impl::make();
     _impl->buffer = buff;
     _impl->slabIndex = slabIndex;
-    _impl->weakManager = manager;
-}
 
+    //the circular manager resets buffers on every cycle, skip re-assigning the same manager
+    if (_impl->weakManager.owner_before(manager) or manager.owner_before(_impl->weakManager))
+    {
+        _impl->weakManager = manager;
+    }
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+/*!
+ * Assign the blocks of a topology to NUMA nodes:
+ * The algorithm only depends on the arguments, so that it
+ * can be tested for any number of nodes (see TopologyNumaPlacement.cpp).
+ * \param numNodes the number of NUMA nodes to fill
+ * \param blocks the uids of all blocks to consider
+ * \param neighbors the uids of the connected blocks per block uid
+ * \param fixed the node index per uid of blocks which keep their node
+ * \return the node index per uid of the blocks which were assigned
+ */
+std::map<std::string, size_t> assignNumaNodes(
+    const size_t numNodes,
+    const std::vector<std::string> &blocks,
+    const std::map<std::string, std::set<std::string>> &neighbors,
+    const std::map<std::string, size_t> &fixed);
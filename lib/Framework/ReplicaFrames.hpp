@@ -0,0 +1,55 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <utility> //pair
+
+namespace Pothos {
+    class InputPort;
+    class OutputPort;
+}
+
+/*!
+ * The frames of a replicated block which are shared
+ * by the splitter, the replicas, and the merger:
+ * The splitter records the size of each frame dealt to a replica.
+ * The worker of each replica reports the elements which it consumed
+ * and produced after every work call (see WorkerActor::postWorkTasks).
+ * When a replica consumed the whole frame, the output of the frame
+ * is complete, and the merger forwards that many output elements.
+ * The output of a work call which spans frames is shared
+ * in proportion to the consumed elements of each frame.
+ * This carries the frame boundaries through replicas
+ * which change the rate, like decimators and interpolators.
+ */
+struct ReplicaFrames
+{
+    ReplicaFrames(const size_t numReplicas);
+
+    //! set the connected ports of a replica before it runs
+    void setReplicaPorts(const size_t index, Pothos::InputPort *input, Pothos::OutputPort *output);
+
+    //! record a frame of the given size which was dealt to a replica
+    void frameDealt(const size_t index, const size_t size);
+
+    //! account a work call of a replica, with the total produced on its output
+    void workDone(const size_t index, const size_t consumed, const unsigned long long totalProduced);
+
+    //! pop the output size of the next complete frame of a replica
+    bool popOutputFrame(const size_t index, size_t &size);
+
+    //! the input and output port of each replica
+    std::vector<std::pair<Pothos::InputPort *, Pothos::OutputPort *>> ports;
+
+private:
+    std::mutex _mutex;
+    std::vector<std::deque<size_t>> _inputSizes; //frames dealt and not yet consumed
+    std::vector<size_t> _consumed; //consumed elements of the front frame
+    std::vector<size_t> _produced; //produced elements of the front frame
+    std::vector<unsigned long long> _totalProduced; //last reported output total
+    std::vector<std::deque<size_t>> _outputSizes; //complete output frames
+};
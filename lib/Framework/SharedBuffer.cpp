@@ -3,27 +3,26 @@
 
 #include <Pothos/Framework/SharedBuffer.hpp>
 #include <Pothos/Framework/Exception.hpp>
-#include <Poco/SingletonHolder.h>
+#include "Framework/SharedBufferArena.hpp"
 #include <algorithm> //min/max
-#include <mutex>
 
 /***********************************************************************
  * shared buffer implementation
  **********************************************************************/
 Pothos::SharedBuffer::SharedBuffer(void):
-    _address(0), _length(0), _alias(0)
+    _address(0), _length(0), _alias(0), _backing(nullptr)
 {
     return;
 }
 
 Pothos::SharedBuffer::SharedBuffer(const size_t address, const size_t length, std::shared_ptr<void> container):
-    _address(address), _length(length), _alias(0), _container(container)
+    _address(address), _length(length), _alias(0), _backing(nullptr), _container(container)
 {
     return;
 }
 
 Pothos::SharedBuffer::SharedBuffer(const size_t address, const size_t length, const SharedBuffer &buffer):
-    _address(address), _length(length), _alias(buffer._alias), _container(buffer._container)
+    _address(address), _length(length), _alias(buffer._alias), _backing(buffer._backing), _container(buffer._container)
 {
     if (_alias != 0) _alias += _address - buffer.getAddress();
     const bool beginInRange = (_address >= buffer.getAddress())/* and (_address < buffer.getAddress() + buffer.getLength())*/;
@@ -35,32 +34,56 @@ Pothos::SharedBuffer::SharedBuffer(const size_t address, const size_t length, co
 }
 
 /***********************************************************************
- * circular buffer implementation
+ * arena implementation
+ **********************************************************************/
+Pothos::SharedBuffer Pothos::SharedBuffer::make(const size_t numBytes, const long nodeAffinity)
+{
+    //the arena returns a null buffer for an unknown node
+    if (numBytes <= SharedBufferArena::MaxBlockSize)
+    {
+        auto buff = SharedBufferArena::make(numBytes, nodeAffinity);
+        if (buff) return buff;
+    }
+    return SharedBuffer::makeSystem(numBytes, nodeAffinity);
+}
+
+std::string Pothos::SharedBuffer::queryArenaStats(void)
+{
+    return SharedBufferArena::queryStats();
+}
+
+/***********************************************************************
+ * huge page implementation
  **********************************************************************/
-static std::mutex &getCircMutex(void)
+static void checkHugePages(const std::string &hugePages, const std::string &what)
 {
-    static Poco::SingletonHolder<std::mutex> sh;
-    return *sh.get();
+    if (hugePages == "NONE" or hugePages == "TRANSPARENT" or hugePages == "HUGETLB") return;
+    throw Pothos::SharedBufferError(what, "unknown huge pages mode " + hugePages);
 }
 
+Pothos::SharedBuffer Pothos::SharedBuffer::make(const size_t numBytes, const long nodeAffinity, const std::string &hugePages)
+{
+    checkHugePages(hugePages, "Pothos::SharedBuffer::make()");
+    if (hugePages == "NONE") return SharedBuffer::make(numBytes, nodeAffinity);
+
+    //fall back to regular pages when huge pages are not available
+    auto buff = SharedBuffer::makeHugePages(numBytes, nodeAffinity, hugePages == "HUGETLB");
+    if (not buff) buff = SharedBuffer::make(numBytes, nodeAffinity);
+    return buff;
+}
+
+/***********************************************************************
+ * circular buffer implementation
+ **********************************************************************/
 Pothos::SharedBuffer Pothos::SharedBuffer::makeCirc(const size_t numBytes, const long nodeAffinity)
 {
-    //circular buffer implementations form a natural race condition
-    //combine a mutex with retry logic to ensure the call succeeds
-    const size_t numRetries = 7;
-    for (size_t i = 0; i < numRetries; i++)
-    {
-        std::lock_guard<std::mutex> lock(getCircMutex());
-        try
-        {
-            SharedBuffer buff = SharedBuffer::makeCircUnprotected(numBytes, nodeAffinity);
-            buff._alias = buff.getAddress() + buff.getLength();
-            return buff;
-        }
-        catch(const SharedBufferError &ex)
-        {
-            if (i == numRetries-1) throw ex;
-        }
-    }
-    throw SharedBufferError("Pothos::SharedBuffer::makeCirc()", "invalid code path");
+    return SharedBuffer::makeCirc(numBytes, nodeAffinity, "NONE");
+}
+
+Pothos::SharedBuffer Pothos::SharedBuffer::makeCirc(const size_t numBytes, const long nodeAffinity, const std::string &hugePages)
+{
+    checkHugePages(hugePages, "Pothos::SharedBuffer::makeCirc()");
+    SharedBuffer buff = SharedBuffer::makeCircUnprotected(numBytes, nodeAffinity, hugePages);
+    buff._alias = buff.getAddress() + buff.getLength();
+    return buff;
 }
@@ -0,0 +1,400 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/SharedBufferArena.hpp"
+#include <Pothos/System/NumaInfo.hpp>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Array.h>
+#include <algorithm> //min/max
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <new> //operator new
+#include <utility> //move
+#ifdef __linux__
+#include <sched.h> //sched_getcpu
+#endif
+
+/***********************************************************************
+ * Size classes:
+ * The payload sizes are powers of two from 64 bytes to MaxBlockSize.
+ * Each block has a 64 byte header in front of the payload,
+ * so the payload of every block is aligned to 64 bytes.
+ **********************************************************************/
+static const size_t MinClassShift = 6;
+static const size_t NumSizeClasses = 13;
+static const size_t HeaderBytes = 64;
+static const size_t SlabBytes = 1024*1024;
+static const size_t MaxThreadCacheBytes = 1024*1024;
+
+static size_t classPayload(const size_t sizeClass)
+{
+    return size_t(1) << (sizeClass + MinClassShift);
+}
+
+static size_t sizeToClass(const size_t numBytes)
+{
+    size_t sizeClass = 0;
+    while (classPayload(sizeClass) < numBytes) sizeClass++;
+    return sizeClass;
+}
+
+//! The maximum number of blocks per size class in a thread cache
+static size_t cacheLimit(const size_t sizeClass)
+{
+    return std::min<size_t>(64, std::max<size_t>(2, MaxThreadCacheBytes/classPayload(sizeClass)));
+}
+
+/***********************************************************************
+ * Block header and arena
+ **********************************************************************/
+class Arena;
+
+struct ArenaBlock
+{
+    //space for the shared pointer control block, see ArenaAllocator
+    alignas(16) char control[32];
+    Arena *arena;
+    ArenaBlock *next;
+    size_t sizeClass;
+
+    size_t payload(void) const
+    {
+        return size_t(this) + HeaderBytes;
+    }
+};
+
+static_assert(sizeof(ArenaBlock) <= HeaderBytes, "ArenaBlock header too large");
+
+class Arena
+{
+public:
+    Arena(const long node):
+        node(node),
+        bytesInUse(0),
+        highWaterBytes(0),
+        slabBytes(0)
+    {
+        for (size_t i = 0; i < NumSizeClasses; i++) _freeLists[i] = nullptr;
+    }
+
+    //! Take a chain of up to maxCount blocks, carve a new slab when empty
+    ArenaBlock *take(const size_t sizeClass, const size_t maxCount, size_t &count)
+    {
+        std::lock_guard<std::mutex> lock(_mutexes[sizeClass]);
+        if (_freeLists[sizeClass] == nullptr) this->carve(sizeClass);
+        ArenaBlock *head = _freeLists[sizeClass];
+        ArenaBlock *tail = head;
+        for (count = 1; count < maxCount and tail->next != nullptr; count++) tail = tail->next;
+        _freeLists[sizeClass] = tail->next;
+        tail->next = nullptr;
+        return head;
+    }
+
+    //! Give back a chain of blocks of the same size class
+    void give(ArenaBlock *head, ArenaBlock *tail)
+    {
+        std::lock_guard<std::mutex> lock(_mutexes[head->sizeClass]);
+        tail->next = _freeLists[head->sizeClass];
+        _freeLists[head->sizeClass] = head;
+    }
+
+    //! Account for the payload bytes handed out or returned
+    void addInUse(const long long delta)
+    {
+        const auto inUse = size_t(bytesInUse.fetch_add(size_t(delta), std::memory_order_relaxed) + size_t(delta));
+        auto highWater = highWaterBytes.load(std::memory_order_relaxed);
+        while (inUse > highWater and not highWaterBytes.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)){}
+    }
+
+    const long node;
+    std::atomic<size_t> bytesInUse;
+    std::atomic<size_t> highWaterBytes;
+    std::atomic<size_t> slabBytes;
+
+private:
+    void carve(const size_t sizeClass)
+    {
+        //the slab is allocated on the node of this arena and is never freed
+        const size_t blockBytes = HeaderBytes + classPayload(sizeClass);
+        const size_t numBlocks = std::max<size_t>(1, SlabBytes/blockBytes);
+        auto slab = Pothos::SharedBufferArena::makeSlab(numBlocks*blockBytes, node);
+        slabBytes += slab.getLength();
+
+        for (size_t i = 0; i < numBlocks; i++)
+        {
+            auto block = reinterpret_cast<ArenaBlock *>(slab.getAddress() + i*blockBytes);
+            block->arena = this;
+            block->sizeClass = sizeClass;
+            block->next = _freeLists[sizeClass];
+            _freeLists[sizeClass] = block;
+        }
+
+        std::lock_guard<std::mutex> lock(_slabsMutex);
+        _slabs.push_back(slab);
+    }
+
+    std::mutex _mutexes[NumSizeClasses];
+    ArenaBlock *_freeLists[NumSizeClasses];
+    std::mutex _slabsMutex;
+    std::vector<Pothos::SharedBuffer> _slabs;
+};
+
+/***********************************************************************
+ * Arena per NUMA node
+ **********************************************************************/
+class ArenaRegistry
+{
+public:
+    ArenaRegistry(void)
+    {
+        size_t numNodes = 1;
+        for (const auto &info : Pothos::System::NumaInfo::get())
+        {
+            numNodes = std::max(numNodes, info.nodeNumber+1);
+            for (const auto cpu : info.cpus)
+            {
+                if (_cpuToNode.size() <= cpu) _cpuToNode.resize(cpu+1, 0);
+                _cpuToNode[cpu] = info.nodeNumber;
+            }
+        }
+        for (size_t i = 0; i < numNodes; i++) arenas.push_back(new Arena(long(i)));
+    }
+
+    //! Get the arena of a node or nullptr when it does not exist
+    Arena *get(const long node) const
+    {
+        if (node < 0 or size_t(node) >= arenas.size()) return nullptr;
+        return arenas[node];
+    }
+
+    //! Get the arena of the node of the calling thread
+    Arena *local(void) const
+    {
+        #ifdef __linux__
+        const int cpu = sched_getcpu();
+        if (cpu >= 0 and size_t(cpu) < _cpuToNode.size()) return arenas[_cpuToNode[cpu]];
+        #endif
+        return arenas.front();
+    }
+
+    std::vector<Arena *> arenas;
+
+private:
+    std::vector<size_t> _cpuToNode;
+};
+
+static ArenaRegistry &getArenaRegistry(void)
+{
+    //never destroyed, buffers released during static destruction still return blocks
+    static ArenaRegistry *registry = new ArenaRegistry();
+    return *registry;
+}
+
+/***********************************************************************
+ * Thread cache of free blocks
+ **********************************************************************/
+struct ThreadCache
+{
+    ThreadCache(void):
+        arena(nullptr)
+    {
+        for (size_t i = 0; i < NumSizeClasses; i++)
+        {
+            lists[i] = nullptr;
+            counts[i] = 0;
+        }
+    }
+
+    ~ThreadCache(void);
+
+    //! Give back count blocks from the front of a size class
+    void release(const size_t sizeClass, const size_t count)
+    {
+        if (count == 0) return;
+        ArenaBlock *head = lists[sizeClass];
+        ArenaBlock *tail = head;
+        for (size_t i = 1; i < count; i++) tail = tail->next;
+        lists[sizeClass] = tail->next;
+        counts[sizeClass] -= count;
+        arena->give(head, tail);
+    }
+
+    //! Give back all cached blocks to the arena
+    void flush(void)
+    {
+        for (size_t i = 0; i < NumSizeClasses; i++) this->release(i, counts[i]);
+    }
+
+    Arena *arena;
+    ArenaBlock *lists[NumSizeClasses];
+    size_t counts[NumSizeClasses];
+};
+
+//blocks freed during thread exit bypass the destroyed cache
+static thread_local bool threadCacheDestroyed(false);
+static thread_local ThreadCache threadCache;
+
+ThreadCache::~ThreadCache(void)
+{
+    this->flush();
+    threadCacheDestroyed = true;
+}
+
+static ArenaBlock *allocateBlock(const size_t sizeClass, const long nodeAffinity)
+{
+    const auto &registry = getArenaRegistry();
+    size_t count = 0;
+
+    //without a thread cache, take directly from the arena
+    if (threadCacheDestroyed)
+    {
+        auto arena = (nodeAffinity < 0)?registry.local():registry.get(nodeAffinity);
+        return (arena == nullptr)?nullptr:arena->take(sizeClass, 1, count);
+    }
+
+    //an explicit node other than the thread's node bypasses the cache
+    auto &cache = threadCache;
+    if (cache.arena == nullptr) cache.arena = registry.local();
+    auto arena = (nodeAffinity < 0)?cache.arena:registry.get(nodeAffinity);
+    if (arena == nullptr) return nullptr;
+    if (arena != cache.arena) return arena->take(sizeClass, 1, count);
+
+    if (cache.lists[sizeClass] == nullptr)
+    {
+        //the thread may have moved to another node since the last refill
+        auto local = registry.local();
+        if (nodeAffinity < 0 and local != cache.arena)
+        {
+            cache.flush();
+            cache.arena = arena = local;
+        }
+        cache.lists[sizeClass] = arena->take(sizeClass, (cacheLimit(sizeClass)+1)/2, cache.counts[sizeClass]);
+    }
+
+    auto block = cache.lists[sizeClass];
+    cache.lists[sizeClass] = block->next;
+    cache.counts[sizeClass]--;
+    return block;
+}
+
+static void freeBlock(ArenaBlock *block)
+{
+    auto arena = block->arena;
+    arena->addInUse(-(long long)(classPayload(block->sizeClass)));
+
+    //blocks of other nodes go back to the arena which owns them
+    if (threadCacheDestroyed or threadCache.arena != arena)
+    {
+        arena->give(block, block);
+        return;
+    }
+
+    //keep the block in the cache, and give back half when over the limit
+    auto &cache = threadCache;
+    const auto sizeClass = block->sizeClass;
+    block->next = cache.lists[sizeClass];
+    cache.lists[sizeClass] = block;
+    if (++cache.counts[sizeClass] > cacheLimit(sizeClass))
+    {
+        cache.release(sizeClass, cache.counts[sizeClass]/2);
+    }
+}
+
+/***********************************************************************
+ * Shared pointer support:
+ * The allocator places the control block into the header of the block,
+ * and frees the block when the control block is deallocated.
+ * The deleter does nothing because the block outlives the payload.
+ **********************************************************************/
+template <typename T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+
+    ArenaAllocator(ArenaBlock *block):
+        block(block)
+    {
+        return;
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other):
+        block(other.block)
+    {
+        return;
+    }
+
+    T *allocate(const size_t n)
+    {
+        //fall back to the heap when the control block does not fit
+        if (n*sizeof(T) <= sizeof(block->control) and alignof(T) <= 16) return reinterpret_cast<T *>(block->control);
+        return static_cast<T *>(::operator new(n*sizeof(T)));
+    }
+
+    void deallocate(T *p, const size_t)
+    {
+        if (reinterpret_cast<char *>(p) != block->control) ::operator delete(p);
+        freeBlock(block);
+    }
+
+    ArenaBlock *block;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+{
+    return lhs.block == rhs.block;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+{
+    return lhs.block != rhs.block;
+}
+
+struct ArenaDeleter
+{
+    void operator()(void *) const
+    {
+        return;
+    }
+};
+
+/***********************************************************************
+ * Arena factory and stats
+ **********************************************************************/
+Pothos::SharedBuffer Pothos::SharedBufferArena::make(const size_t numBytes, const long nodeAffinity)
+{
+    const size_t sizeClass = sizeToClass(numBytes);
+    auto block = allocateBlock(sizeClass, nodeAffinity);
+    if (block == nullptr) return SharedBuffer();
+    block->arena->addInUse(classPayload(sizeClass));
+
+    std::shared_ptr<void> container(reinterpret_cast<void *>(block->payload()), ArenaDeleter(), ArenaAllocator<char>(block));
+    SharedBuffer buff(block->payload(), numBytes, std::move(container));
+    buff._backing = "ARENA";
+    return buff;
+}
+
+Pothos::SharedBuffer Pothos::SharedBufferArena::makeSlab(const size_t numBytes, const long nodeAffinity)
+{
+    return SharedBuffer::makeSystem(numBytes, nodeAffinity);
+}
+
+std::string Pothos::SharedBufferArena::queryStats(void)
+{
+    Poco::JSON::Array::Ptr stats(new Poco::JSON::Array());
+    for (const auto arena : getArenaRegistry().arenas)
+    {
+        Poco::JSON::Object::Ptr arenaStats(new Poco::JSON::Object());
+        arenaStats->set("nodeAffinity", Poco::Int64(arena->node));
+        arenaStats->set("bytesInUse", Poco::UInt64(arena->bytesInUse.load()));
+        arenaStats->set("highWaterBytes", Poco::UInt64(arena->highWaterBytes.load()));
+        arenaStats->set("slabBytes", Poco::UInt64(arena->slabBytes.load()));
+        stats->add(arenaStats);
+    }
+    std::stringstream ss; stats->stringify(ss, 4);
+    return ss.str();
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <Pothos/Framework/SharedBuffer.hpp>
+#include <string>
+
+namespace Pothos {
+
+/*!
+ * SharedBufferArena is a thread-caching slab allocator for SharedBuffer::make().
+ * Allocations are rounded up to a power of two size class, and the blocks
+ * are carved from large slabs which are allocated on a NUMA node.
+ * Each thread caches freed blocks per size class, so the common cycle
+ * of making and releasing buffers neither locks nor uses the system heap.
+ * The shared pointer control block is stored in the header of each block,
+ * so a buffer from the arena costs a single block allocation.
+ * Blocks always return to the arena of the node which owns their slab,
+ * so freed memory is only reused by threads on the same node.
+ */
+class SharedBufferArena
+{
+public:
+    //! The largest allocation in bytes which is served by the arenas
+    static const size_t MaxBlockSize = 256*1024;
+
+    /*!
+     * Make a buffer from the arena of a NUMA node.
+     * \param numBytes the number of bytes (up to MaxBlockSize)
+     * \param nodeAffinity the node, or -1 for the node of the calling thread
+     * \return a new buffer, or a null buffer for an unknown node
+     */
+    static SharedBuffer make(const size_t numBytes, const long nodeAffinity);
+
+    //! Make a slab from the system allocator for an arena
+    static SharedBuffer makeSlab(const size_t numBytes, const long nodeAffinity);
+
+    //! Get a JSON array with the stats of each arena
+    static std::string queryStats(void);
+};
+
+} //namespace Pothos
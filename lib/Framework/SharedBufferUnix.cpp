@@ -1,4 +1,4 @@
-// Copyright (c) 2013-2015 Josh Blum
+// Copyright (c) 2013-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include <Pothos/Framework/SharedBuffer.hpp>
@@ -6,17 +6,30 @@
 #include <Poco/TemporaryFile.h>
 #include <Poco/Format.h>
 #include <cassert>
+#include <algorithm> //max
 #include <fcntl.h> //open
 #include <unistd.h> //close
 #include <cerrno> //errno
 #include <cstring> //strerror
 #include <sys/mman.h> //mmap
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <iterator> //prev
+#include <tuple>
 
 //MAP_ANON is deprecated - this supports older headers
 #ifndef MAP_ANONYMOUS
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
+//MAP_NORESERVE is not available on all systems
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
 #if HAVE_LIBNUMA
 #include <numa.h>
 #endif
@@ -25,6 +38,104 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef __linux__
+#include <sys/syscall.h> //SYS_memfd_create
+#endif
+
+//memfd flags are missing from older headers
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+/***********************************************************************
+ * huge page helpers
+ **********************************************************************/
+static size_t readHugePageSize(void)
+{
+    //the default huge page size from the kernel, or the common 2 MiB
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    size_t value = 0;
+    while (meminfo >> key)
+    {
+        if (key == "Hugepagesize:" and meminfo >> value) return value*1024;
+        meminfo.ignore(256, '\n');
+    }
+    return 2*1024*1024;
+}
+
+static size_t getHugePageSize(void)
+{
+    static const size_t hugePageSize = readHugePageSize();
+    return hugePageSize;
+}
+
+static size_t roundUpTo(const size_t value, const size_t multiple)
+{
+    return ((value + multiple - 1)/multiple)*multiple;
+}
+
+static int memfdCreate(const char *name, const unsigned int flags)
+{
+    #ifdef SYS_memfd_create
+    return int(syscall(SYS_memfd_create, name, flags));
+    #else
+    (void)name; (void)flags;
+    errno = ENOSYS;
+    return -1;
+    #endif
+}
+
+/***********************************************************************
+ * NUMA node placement helpers
+ **********************************************************************/
+//memory policy constants from numaif.h, which needs the libnuma headers
+#define POTHOS_MPOL_PREFERRED 1
+#define POTHOS_NODE_MASK_BITS (8*sizeof(unsigned long))
+
+static bool bindToNode(void *mem, const size_t numBytes, const long nodeAffinity)
+{
+    //set the policy of the memory before the first touch places the pages
+    if (nodeAffinity < 0 or size_t(nodeAffinity) >= POTHOS_NODE_MASK_BITS) return false;
+    #ifdef SYS_mbind
+    const unsigned long nodeMask = 1UL << nodeAffinity;
+    return syscall(SYS_mbind, mem, numBytes, POTHOS_MPOL_PREFERRED, &nodeMask, POTHOS_NODE_MASK_BITS+1, 0) == 0;
+    #else
+    (void)mem; (void)numBytes;
+    return false;
+    #endif
+}
+
+static void touchOnNode(void *mem, const size_t numBytes, const long nodeAffinity, const bool bound)
+{
+    if (nodeAffinity < 0 or size_t(nodeAffinity) >= POTHOS_NODE_MASK_BITS) return;
+
+    //without a memory policy, the policy of the touching thread places the pages
+    #if defined(SYS_get_mempolicy) && defined(SYS_set_mempolicy)
+    int oldMode = 0;
+    unsigned long oldMask[16] = {};
+    bool threadPolicy = false;
+    if (not bound and syscall(SYS_get_mempolicy, &oldMode, oldMask, 16*POTHOS_NODE_MASK_BITS, nullptr, 0) == 0)
+    {
+        const unsigned long nodeMask = 1UL << nodeAffinity;
+        threadPolicy = syscall(SYS_set_mempolicy, POTHOS_MPOL_PREFERRED, &nodeMask, POTHOS_NODE_MASK_BITS+1) == 0;
+    }
+    #else
+    (void)bound;
+    #endif
+
+    //touch each page so the pages are placed now rather than in the first work()
+    volatile char *p = reinterpret_cast<volatile char *>(mem);
+    for (size_t i = 0; i < numBytes; i += size_t(getpagesize())) p[i] = p[i];
+
+    #if defined(SYS_get_mempolicy) && defined(SYS_set_mempolicy)
+    if (threadPolicy) syscall(SYS_set_mempolicy, oldMode, oldMask, 16*POTHOS_NODE_MASK_BITS);
+    #endif
+}
+
 /***********************************************************************
  * aligned allocator for a generic memory slab (uses new/delete)
  **********************************************************************/
@@ -91,117 +202,304 @@ private:
 };
 
 /***********************************************************************
- * numa allocator for an affinitized memory slab
+ * huge page allocator for a memory slab (uses mmap)
  **********************************************************************/
-class CircularBufferContainer
+class HugePageBufferContainer
 {
 public:
-    CircularBufferContainer(const size_t numBytes);
-    ~CircularBufferContainer(void)
+    HugePageBufferContainer(const size_t numBytes, const long nodeAffinity, const bool hugetlb):
+        _mem(MAP_FAILED),
+        _len(roundUpTo(std::max<size_t>(numBytes, 1), getHugePageSize())),
+        _backing(nullptr)
+    {
+        //explicit huge pages fail when the reserved pool is exhausted
+        #ifdef MAP_HUGETLB
+        if (hugetlb)
+        {
+            _mem = mmap(nullptr, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, off_t(0));
+            if (_mem != MAP_FAILED) _backing = "HUGETLB";
+        }
+        #else
+        (void)hugetlb;
+        #endif
+
+        //transparent huge pages need a region aligned to the huge page size
+        #ifdef MADV_HUGEPAGE
+        if (_mem == MAP_FAILED)
+        {
+            const size_t align = getHugePageSize();
+            void *mem = mmap(nullptr, _len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, off_t(0));
+            if (mem == MAP_FAILED) return;
+            const size_t addr = size_t(mem);
+            const size_t aligned = roundUpTo(addr, align);
+            if (aligned != addr) munmap(mem, aligned - addr);
+            munmap((void *)(aligned + _len), addr + align - aligned);
+            _mem = (void *)aligned;
+            if (madvise(_mem, _len, MADV_HUGEPAGE) == 0) _backing = "TRANSPARENT";
+            else this->cleanup();
+        }
+        #endif
+
+        if (_mem != MAP_FAILED) bindToNode(_mem, _len, nodeAffinity);
+    }
+
+    ~HugePageBufferContainer(void)
     {
         this->cleanup();
     }
 
     size_t getAddress(void) const
     {
-        return size_t(virtualAddr2X);
+        return (_mem == MAP_FAILED)?0:size_t(_mem);
     }
 
-private:
-    void errorOut(const std::string &what)
+    const char *getBacking(void) const
     {
-        const int errnoSave = errno;
-        this->cleanup();
-        throw Pothos::SharedBufferError(
-            "Pothos::CircularBufferContainer::"+what,
-            Poco::format("errno %d - %s", errnoSave, std::string(strerror(errnoSave))));
+        return _backing;
     }
 
+private:
     void cleanup(void)
     {
-        if (mapPtr1 != MAP_FAILED) munmap(mapPtr1, _numBytes);
-        mapPtr1 = MAP_FAILED;
+        if (_mem != MAP_FAILED) munmap(_mem, _len);
+        _mem = MAP_FAILED;
+    }
 
-        if (mapPtr0 != MAP_FAILED) munmap(mapPtr0, _numBytes);
-        mapPtr0 = MAP_FAILED;
+    void *_mem;
+    const size_t _len;
+    const char *_backing;
+};
 
-        if (tmpFd >= 0)
-        {
-            close(tmpFd);
-        }
-        tmpFd = -1;
+/***********************************************************************
+ * double mapped allocator for a circular memory slab
+ **********************************************************************/
+struct CircularMapping
+{
+    CircularMapping(void):
+        addr(nullptr),
+        numBytes(0),
+        nodeAffinity(-1),
+        backing(nullptr)
+    {
+        return;
     }
 
-    const size_t _numBytes;
-    void *virtualAddr2X;
-    int tmpFd;
-    void *mapPtr0;
-    void *mapPtr1;
+    void *addr; //start of the 2X region
+    size_t numBytes; //length of each mapping
+    long nodeAffinity; //node of the physical pages or -1
+    const char *backing;
 };
 
-CircularBufferContainer::CircularBufferContainer(const size_t numBytes):
-    _numBytes(numBytes),
-    virtualAddr2X(nullptr),
-    tmpFd(-1),
-    mapPtr0(MAP_FAILED),
-    mapPtr1(MAP_FAILED)
+static void circularErrorOut(const std::string &what, const CircularMapping &mapping = CircularMapping())
 {
-    int ret = 0;
+    const int errnoSave = errno;
+    if (mapping.addr != nullptr) munmap(mapping.addr, mapping.numBytes*2);
+    throw Pothos::SharedBufferError(
+        "Pothos::CircularBufferContainer::"+what,
+        Poco::format("errno %d - %s", errnoSave, std::string(strerror(errnoSave))));
+}
+
+static CircularMapping mapCircular(const size_t numBytes, const long nodeAffinity, const std::string &hugePages)
+{
+    CircularMapping mapping;
+    mapping.numBytes = numBytes;
+    mapping.nodeAffinity = nodeAffinity;
+    const bool hugetlb = (hugePages == "HUGETLB");
+    const size_t align = (hugePages == "NONE")?0:getHugePageSize();
 
     /*******************************************************************
-     * Step 1) open a temp file for physical memory
+     * Step 1) open a memfd or a temp file for physical memory
      ******************************************************************/
-    Poco::TemporaryFile tmpFile;
-    tmpFd = open(
-        tmpFile.path().c_str(),
-        O_RDWR | O_CREAT | O_EXCL,
-        S_IRUSR | S_IWUSR);
-    if (tmpFd < 0) this->errorOut("open("+ tmpFile.path() +")");
+    int fd = memfdCreate("pothos_circ", MFD_CLOEXEC | (hugetlb?MFD_HUGETLB:0));
+    if (fd >= 0) mapping.backing = (align == 0)?"MEMFD":(hugetlb?"HUGETLB":"TRANSPARENT");
+    else if (align != 0) circularErrorOut("memfd_create()");
+    else
+    {
+        //the file is removed with tmpFile, the descriptor keeps the memory
+        Poco::TemporaryFile tmpFile;
+        fd = open(
+            tmpFile.path().c_str(),
+            O_RDWR | O_CREAT | O_EXCL,
+            S_IRUSR | S_IWUSR);
+        if (fd < 0) circularErrorOut("open("+ tmpFile.path() +")");
+        mapping.backing = "FILE";
+    }
+
+    //the mappings keep the memory after the descriptor is closed
+    struct FdCloser
+    {
+        ~FdCloser(void){close(fd);}
+        const int fd;
+    } fdCloser{fd};
 
-    ret = ftruncate(tmpFd, numBytes*2);
-    if (ret != 0) this->errorOut("ftruncate("+ tmpFile.path() +")");
+    if (ftruncate(fd, off_t(numBytes)) != 0) circularErrorOut("ftruncate()");
 
     /*******************************************************************
-     * Step 2) find a 2X chunk of virtual memory
+     * Step 2) reserve a 2X chunk of virtual memory
      ******************************************************************/
-    virtualAddr2X = mmap(
+    const size_t reserveBytes = numBytes*2 + align;
+    void *reserve = mmap(
         nullptr,
-        numBytes*2,
+        reserveBytes,
         PROT_NONE,
-        MAP_PRIVATE | MAP_ANONYMOUS,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
         -1, off_t(0));
-    if (virtualAddr2X == MAP_FAILED) this->errorOut("mmap(2x)");
+    if (reserve == MAP_FAILED) circularErrorOut("mmap(2x)");
 
-    ret = munmap(virtualAddr2X, numBytes*2);
-    if (ret != 0) this->errorOut("munmap(2x)");
+    //trim the reservation to start on a huge page boundary
+    const size_t reserveAddr = size_t(reserve);
+    const size_t base = (align == 0)?reserveAddr:roundUpTo(reserveAddr, align);
+    if (base != reserveAddr) munmap(reserve, base - reserveAddr);
+    if (base + numBytes*2 != reserveAddr + reserveBytes)
+    {
+        munmap((void *)(base + numBytes*2), reserveAddr + reserveBytes - (base + numBytes*2));
+    }
+    mapping.addr = (void *)base;
 
     /*******************************************************************
      * Step 3) perform overlapping virtual mappings
      ******************************************************************/
-    mapPtr0 = mmap(
-        virtualAddr2X,
-        numBytes,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        tmpFd, off_t(0));
-    if (mapPtr0 == MAP_FAILED) this->errorOut("mmap(0)");
-
-    mapPtr1 = mmap(
-        (void *)(size_t(virtualAddr2X) + numBytes),
-        numBytes,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        tmpFd, off_t(0));
-    if (mapPtr1 == MAP_FAILED) this->errorOut("mmap(1)");
+    //MAP_FIXED only replaces the reservation which this call owns,
+    //so other threads cannot race for the region in between
+    for (size_t i = 0; i < 2; i++)
+    {
+        void *ptr = mmap(
+            (void *)(base + i*numBytes),
+            numBytes,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED,
+            fd, off_t(0));
+        if (ptr == MAP_FAILED) circularErrorOut("mmap("+std::to_string(i)+")", mapping);
+    }
+
+    /*******************************************************************
+     * Step 4) advise transparent huge pages for the shmem file
+     ******************************************************************/
+    #ifdef MADV_HUGEPAGE
+    if (hugePages == "TRANSPARENT" and madvise(mapping.addr, numBytes*2, MADV_HUGEPAGE) != 0)
+    {
+        circularErrorOut("madvise()", mapping);
+    }
+    #endif
+
+    /*******************************************************************
+     * Step 5) place the physical pages on the NUMA node
+     ******************************************************************/
+    //the policy of a shared mapping applies to the memfd pages,
+    //and both views share the pages, so the first view is enough
+    if (nodeAffinity >= 0)
+    {
+        const bool bound = bindToNode(mapping.addr, numBytes, nodeAffinity);
+        touchOnNode(mapping.addr, numBytes, nodeAffinity, bound);
+    }
+
+    return mapping;
+}
+
+/***********************************************************************
+ * process-wide cache of released circular mappings
+ *
+ * Topology commits and reconfigurations release and create
+ * many circular buffers of the same few sizes. Released mappings
+ * are kept up to a total size so that the next buffer of the same
+ * size, huge page mode, and NUMA node reuses the mapping
+ * without system calls.
+ **********************************************************************/
+static const size_t MaxCachedCircularBytes = 64*1024*1024;
+
+class CircularMappingCache
+{
+public:
+    CircularMappingCache(void):
+        _totalBytes(0)
+    {
+        return;
+    }
+
+    bool take(const size_t numBytes, const long nodeAffinity, const std::string &hugePages, CircularMapping &mapping)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto range = _mappings.equal_range(std::make_tuple(numBytes, nodeAffinity, hugePages));
+        if (range.first == range.second) return false;
+
+        //the most recently released mapping is the most likely in cache
+        auto it = std::prev(range.second);
+        mapping = it->second;
+        _totalBytes -= numBytes;
+        _mappings.erase(it);
+        return true;
+    }
+
+    void release(const std::string &hugePages, const CircularMapping &mapping)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_totalBytes + mapping.numBytes <= MaxCachedCircularBytes)
+            {
+                _totalBytes += mapping.numBytes;
+                _mappings.emplace(std::make_tuple(mapping.numBytes, mapping.nodeAffinity, hugePages), mapping);
+                return;
+            }
+        }
+        munmap(mapping.addr, mapping.numBytes*2);
+    }
+
+private:
+    std::mutex _mutex;
+    size_t _totalBytes;
+    std::multimap<std::tuple<size_t, long, std::string>, CircularMapping> _mappings;
+};
+
+static CircularMappingCache &getCircularMappingCache(void)
+{
+    //never destroyed, buffers released during static destruction still return mappings
+    static CircularMappingCache *cache = new CircularMappingCache();
+    return *cache;
 }
 
+class CircularBufferContainer
+{
+public:
+    CircularBufferContainer(const std::string &hugePages, const CircularMapping &mapping):
+        _hugePages(hugePages),
+        _mapping(mapping)
+    {
+        return;
+    }
+
+    ~CircularBufferContainer(void)
+    {
+        getCircularMappingCache().release(_hugePages, _mapping);
+    }
+
+    size_t getAddress(void) const
+    {
+        return size_t(_mapping.addr);
+    }
+
+    size_t getLength(void) const
+    {
+        return _mapping.numBytes;
+    }
+
+    const char *getBacking(void) const
+    {
+        return _mapping.backing;
+    }
+
+private:
+    const std::string _hugePages;
+    const CircularMapping _mapping;
+};
+
 /***********************************************************************
  * shared buffer implementation
  **********************************************************************/
-Pothos::SharedBuffer Pothos::SharedBuffer::make(const size_t numBytes, const long nodeAffinity)
+Pothos::SharedBuffer Pothos::SharedBuffer::makeSystem(const size_t numBytes, const long nodeAffinity)
 {
     size_t address = 0;
     std::shared_ptr<void> deleter;
+    const char *backing = "NUMA";
 
     //node affinity specified, perform allocation on node
     if (nodeAffinity >= 0)
@@ -217,14 +515,52 @@ Pothos::SharedBuffer Pothos::SharedBuffer::make(const size_t numBytes, const lon
         std::shared_ptr<GenericBufferContainer> sharedAlloc(new GenericBufferContainer(numBytes));
         address = sharedAlloc->getAddress();
         deleter = sharedAlloc;
+        backing = "HEAP";
     }
 
-    return SharedBuffer(address, numBytes, deleter);
+    SharedBuffer buff(address, numBytes, deleter);
+    buff._backing = backing;
+    return buff;
 }
 
-Pothos::SharedBuffer Pothos::SharedBuffer::makeCircUnprotected(const size_t numBytesIn, const long)
+Pothos::SharedBuffer Pothos::SharedBuffer::makeHugePages(const size_t numBytes, const long nodeAffinity, const bool hugetlb)
 {
-    const size_t numBytes = ((numBytesIn + getpagesize() - 1)/getpagesize())*getpagesize();
-    std::shared_ptr<CircularBufferContainer> container(new CircularBufferContainer(numBytes));
-    return SharedBuffer(container->getAddress(), numBytes, container);
+    std::shared_ptr<HugePageBufferContainer> container(new HugePageBufferContainer(numBytes, nodeAffinity, hugetlb));
+    if (container->getAddress() == 0) return SharedBuffer();
+    SharedBuffer buff(container->getAddress(), numBytes, container);
+    buff._backing = container->getBacking();
+    return buff;
+}
+
+Pothos::SharedBuffer Pothos::SharedBuffer::makeCircUnprotected(const size_t numBytesIn, const long nodeAffinity, const std::string &hugePages)
+{
+    //huge pages fall back to transparent and then regular pages
+    std::vector<std::string> modes;
+    if (hugePages == "HUGETLB") modes.push_back("HUGETLB");
+    if (hugePages != "NONE") modes.push_back("TRANSPARENT");
+    modes.push_back("NONE");
+
+    for (const auto &mode : modes)
+    {
+        const size_t pageSize = (mode == "NONE")?size_t(getpagesize()):getHugePageSize();
+        const size_t numBytes = roundUpTo(std::max<size_t>(numBytesIn, 1), pageSize);
+
+        //reuse a released mapping or make a new one
+        CircularMapping mapping;
+        if (not getCircularMappingCache().take(numBytes, nodeAffinity, mode, mapping))
+        {
+            try {mapping = mapCircular(numBytes, nodeAffinity, mode);}
+            catch (const SharedBufferError &)
+            {
+                if (mode == "NONE") throw;
+                continue;
+            }
+        }
+
+        std::shared_ptr<CircularBufferContainer> container(new CircularBufferContainer(mode, mapping));
+        SharedBuffer buff(container->getAddress(), container->getLength(), container);
+        buff._backing = container->getBacking();
+        return buff;
+    }
+    throw SharedBufferError("Pothos::SharedBuffer::makeCirc()", "invalid code path");
 }
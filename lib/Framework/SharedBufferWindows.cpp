@@ -4,8 +4,10 @@
 #include <Pothos/Framework/SharedBuffer.hpp>
 #include <Pothos/Framework/Exception.hpp>
 #include <Poco/Format.h>
+#include <Poco/SingletonHolder.h>
 #include <windows.h>
 #include <algorithm> //min/max
+#include <mutex>
 
 //delay loaded symbols for windows backwards compatibility
 LPVOID DL_VirtualAllocExNuma(HANDLE hProcess, LPVOID lpAddress, SIZE_T dwSize, DWORD flAllocationType, DWORD flProtect, DWORD nndPreferred);
@@ -181,15 +183,47 @@ CircularBufferContainer::CircularBufferContainer(const size_t numBytes, const lo
 /***********************************************************************
  * shared buffer factory functions
  **********************************************************************/
-Pothos::SharedBuffer Pothos::SharedBuffer::make(const size_t numBytes, const long nodeAffinity)
+Pothos::SharedBuffer Pothos::SharedBuffer::makeSystem(const size_t numBytes, const long nodeAffinity)
 {
     std::shared_ptr<GenericBufferContainer> container(new GenericBufferContainer(std::max<size_t>(1, numBytes), nodeAffinity));
-    return SharedBuffer(container->getAddress(), numBytes, container);
+    SharedBuffer buff(container->getAddress(), numBytes, container);
+    buff._backing = "VIRTUAL";
+    return buff;
 }
 
-Pothos::SharedBuffer Pothos::SharedBuffer::makeCircUnprotected(const size_t numBytesIn, const long nodeAffinity)
+Pothos::SharedBuffer Pothos::SharedBuffer::makeHugePages(const size_t, const long, const bool)
+{
+    //large pages require the lock pages privilege, use regular pages
+    return SharedBuffer();
+}
+
+static std::mutex &getCircMutex(void)
+{
+    static Poco::SingletonHolder<std::mutex> sh;
+    return *sh.get();
+}
+
+Pothos::SharedBuffer Pothos::SharedBuffer::makeCircUnprotected(const size_t numBytesIn, const long nodeAffinity, const std::string &)
 {
     const size_t numBytes = ((numBytesIn + getregionsize() - 1)/getregionsize())*getregionsize();
-    std::shared_ptr<CircularBufferContainer> container(new CircularBufferContainer(numBytes, nodeAffinity));
-    return SharedBuffer(container->getAddress(), numBytes, container);
+
+    //the reserved region is released before it is mapped, which races with other mappings
+    //combine a mutex with retry logic to ensure the call succeeds
+    const size_t numRetries = 7;
+    for (size_t i = 0; i < numRetries; i++)
+    {
+        std::lock_guard<std::mutex> lock(getCircMutex());
+        try
+        {
+            std::shared_ptr<CircularBufferContainer> container(new CircularBufferContainer(numBytes, nodeAffinity));
+            SharedBuffer buff(container->getAddress(), numBytes, container);
+            buff._backing = "FILE";
+            return buff;
+        }
+        catch(const SharedBufferError &ex)
+        {
+            if (i == numRetries-1) throw ex;
+        }
+    }
+    throw SharedBufferError("Pothos::SharedBuffer::makeCirc()", "invalid code path");
 }
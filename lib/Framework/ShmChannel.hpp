@@ -0,0 +1,201 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Config.hpp>
+#include <Pothos/Framework/SharedBuffer.hpp>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <map>
+#include <cstdint>
+
+/*!
+ * ShmSegment is a shared memory mapping which another process
+ * on the same host can map into its own address space.
+ * Anonymous segments are passed to the other process by descriptor,
+ * so the memory is released by the kernel even when a process crashes.
+ * A named segment is opened by name, and the name is removed
+ * once it is opened or when its creator destroys the segment.
+ * Every mapping stays valid for as long as its segment is referenced.
+ * The segments of this process are registered by address,
+ * so the segment which holds an arbitrary buffer can be found.
+ */
+class ShmSegment
+{
+public:
+    //! Create a new anonymous segment of at least numBytes
+    static std::shared_ptr<ShmSegment> make(const size_t numBytes);
+
+    //! Create a new segment of at least numBytes which can be opened by name once
+    static std::shared_ptr<ShmSegment> makeNamed(const size_t numBytes);
+
+    //! Open and map a segment by the name from its creator
+    static std::shared_ptr<ShmSegment> open(const std::string &name);
+
+    //! Map a segment from a descriptor (the segment closes the descriptor)
+    static std::shared_ptr<ShmSegment> open(const int fd);
+
+    //! Find the segment which holds the range, or null
+    static std::shared_ptr<ShmSegment> lookup(const size_t address, const size_t length);
+
+    //! Make a buffer over the entire segment which holds a reference
+    static Pothos::SharedBuffer makeBuffer(const std::shared_ptr<ShmSegment> &segment);
+
+    ~ShmSegment(void);
+
+    //! The identifier of this segment, unique in this process
+    uint64_t getId(void) const
+    {
+        return _id;
+    }
+
+    //! The descriptor of an anonymous segment from make(), or -1
+    int getDescriptor(void) const
+    {
+        return _fd;
+    }
+
+    const std::string &getName(void) const
+    {
+        return _name;
+    }
+
+    size_t getAddress(void) const
+    {
+        return _address;
+    }
+
+    size_t getLength(void) const
+    {
+        return _length;
+    }
+
+private:
+    ShmSegment(void);
+    uint64_t _id;
+    int _fd;
+    std::string _name;
+    size_t _address;
+    size_t _length;
+    bool _owner;
+};
+
+/*!
+ * ShmChannel connects a producer and a consumer process on the same host.
+ * The channel lives in a shared memory segment with two rings:
+ *  - a packet ring from the producer to the consumer
+ *  - a return ring of sequence numbers from the consumer to the producer
+ * The consumer connects a sequenced packet socket to the producer,
+ * which serves as the doorbell of both sides and passes the descriptors
+ * of the segments which hold the buffers from the producer.
+ * A side which runs out of work marks itself as waiting before it sleeps,
+ * and the other side only rings the doorbell of a waiting side,
+ * so a busy channel passes packets without any system calls.
+ * The socket hangs up when the other process closes it or exits,
+ * which makes the doorbell readable and marks the peer as closed.
+ */
+class ShmChannel
+{
+public:
+
+    //! The types of packets on the packet ring
+    enum PacketType
+    {
+        PACKET_BUFFER = 1, //!< a buffer in a segment passed by the producer
+        PACKET_LABELS = 2, //!< serialized labels for the next buffer
+        PACKET_MESSAGE = 3, //!< a serialized message
+    };
+
+    //! The fixed part of a packet, followed by the payload
+    struct Packet
+    {
+        uint32_t type;
+        uint32_t payloadSize;
+        uint64_t sequence;
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    //! Create a new channel as the producer
+    static std::shared_ptr<ShmChannel> make(void);
+
+    //! Open the channel by name as the consumer and connect to the producer
+    static std::shared_ptr<ShmChannel> open(const std::string &name);
+
+    //! Close this side of the channel
+    ~ShmChannel(void);
+
+    //! Get the name which the consumer opens
+    const std::string &getName(void) const;
+
+    /*!
+     * Producer: accept the connection from the consumer.
+     * The doorbell of the producer is valid after this call.
+     * 	hrows SharedBufferError when the consumer did not connect
+     */
+    void accept(void);
+
+    //! The doorbell of this side (readable when rung or closed)
+    int getDoorbell(void) const;
+
+    //! Drain the doorbell of this side and receive passed segments
+    void clearDoorbell(void);
+
+    //! Sleep until the doorbell is readable or the timeout expires
+    void sleep(const long timeoutMs);
+
+    /*!
+     * Mark this side as waiting for the other side to ring the doorbell.
+     * The consumer waits for packets, and the producer waits for returns.
+     * eturn false when there is already work to do
+     */
+    bool wait(void);
+
+    //! Has the other side closed the channel or exited?
+    bool isPeerClosed(void) const;
+
+    //! The largest payload size of a single packet
+    size_t getMaxPayloadSize(void) const;
+
+    //! The most sequence numbers outstanding at the consumer
+    size_t getMaxReturns(void) const;
+
+    //! Producer: pass the descriptor of a segment before its first buffer
+    void sendSegment(const std::shared_ptr<ShmSegment> &segment);
+
+    //! Consumer: get a segment passed by the producer by its identifier
+    std::shared_ptr<ShmSegment> getSegment(const uint64_t id);
+
+    //! Producer: can the packets of these payload sizes be written?
+    bool writable(const size_t *payloadSizes, const size_t numPackets) const;
+
+    //! Producer: write a packet (check writable() first)
+    void write(const Packet &packet, const std::string &payload);
+
+    //! Consumer: read the next packet or return false when empty
+    bool read(Packet &packet, std::string &payload);
+
+    //! Consumer: return a sequence number from any thread
+    void pushReturn(const uint64_t sequence);
+
+    //! Producer: pop a returned sequence number or return false when empty
+    bool popReturn(uint64_t &sequence);
+
+private:
+    struct Header;
+    ShmChannel(const std::shared_ptr<ShmSegment> &segment, const size_t side);
+    void ringPeer(void);
+    std::shared_ptr<ShmSegment> _segment;
+    Header *_header;
+    const size_t _side;
+    int _listener;
+    int _doorbell;
+    std::atomic<bool> _peerClosed;
+    std::mutex _returnMutex;
+    std::set<uint64_t> _sentSegments;
+    std::map<uint64_t, std::shared_ptr<ShmSegment>> _segments;
+};
@@ -0,0 +1,556 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/ShmChannel.hpp"
+#include <Pothos/Framework/Exception.hpp>
+#include <atomic>
+#include <map>
+#include <algorithm> //min/max
+#include <new> //placement new
+#include <cstring> //memcpy, strerror
+#include <cerrno> //errno
+#include <cstddef> //offsetof
+#include <fcntl.h> //O_* constants
+#include <unistd.h> //close, getpid
+#include <sys/mman.h> //shm_open, mmap
+#include <sys/stat.h> //fstat
+#include <sys/socket.h> //socket
+#include <sys/un.h> //sockaddr_un
+#include <poll.h> //poll
+
+/***********************************************************************
+ * segment registry by address
+ **********************************************************************/
+static std::mutex &getSegmentsMutex(void)
+{
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::map<size_t, std::weak_ptr<ShmSegment>> &getSegments(void)
+{
+    static auto segments = new std::map<size_t, std::weak_ptr<ShmSegment>>();
+    return *segments;
+}
+
+static std::shared_ptr<ShmSegment> registerSegment(ShmSegment *segment)
+{
+    std::shared_ptr<ShmSegment> sptr(segment);
+    std::lock_guard<std::mutex> lock(getSegmentsMutex());
+    getSegments()[segment->getAddress()] = sptr;
+    return sptr;
+}
+
+static std::string makeUniqueName(void)
+{
+    static std::atomic<size_t> counter(0);
+    return "/pothos_shm_" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+}
+
+static uint64_t makeUniqueId(void)
+{
+    static std::atomic<uint64_t> counter(0);
+    return counter++;
+}
+
+/***********************************************************************
+ * ShmSegment implementation
+ **********************************************************************/
+ShmSegment::ShmSegment(void):
+    _id(makeUniqueId()),
+    _fd(-1),
+    _address(0),
+    _length(0),
+    _owner(false)
+{
+    return;
+}
+
+ShmSegment::~ShmSegment(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(getSegmentsMutex());
+        getSegments().erase(_address);
+    }
+    if (_address != 0) munmap(reinterpret_cast<void *>(_address), _length);
+    if (_fd >= 0) close(_fd);
+    if (_owner) shm_unlink(_name.c_str());
+}
+
+static void *mapDescriptor(const int fd, const size_t length, const std::string &what)
+{
+    void *mem = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) throw Pothos::SharedBufferError(what, "mmap: " + std::string(strerror(errno)));
+    return mem;
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::make(const size_t numBytes)
+{
+    const size_t pageSize = size_t(getpagesize());
+    std::unique_ptr<ShmSegment> segment(new ShmSegment());
+    segment->_length = ((std::max<size_t>(numBytes, 1) + pageSize - 1)/pageSize)*pageSize;
+
+    //the segment has no name which could outlive the processes
+    #if defined(__linux__) && defined(MFD_CLOEXEC)
+    segment->_fd = memfd_create("pothos_shm", MFD_CLOEXEC);
+    #else
+    const auto name = makeUniqueName();
+    segment->_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (segment->_fd >= 0) shm_unlink(name.c_str());
+    if (segment->_fd >= 0) fcntl(segment->_fd, F_SETFD, FD_CLOEXEC);
+    #endif
+    if (segment->_fd < 0) throw Pothos::SharedBufferError("ShmSegment::make()", "create: " + std::string(strerror(errno)));
+    if (ftruncate(segment->_fd, off_t(segment->_length)) != 0)
+    {
+        throw Pothos::SharedBufferError("ShmSegment::make()", "ftruncate: " + std::string(strerror(errno)));
+    }
+
+    segment->_address = size_t(mapDescriptor(segment->_fd, segment->_length, "ShmSegment::make()"));
+    return registerSegment(segment.release());
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::makeNamed(const size_t numBytes)
+{
+    const size_t pageSize = size_t(getpagesize());
+    std::unique_ptr<ShmSegment> segment(new ShmSegment());
+    segment->_name = makeUniqueName();
+    segment->_length = ((std::max<size_t>(numBytes, 1) + pageSize - 1)/pageSize)*pageSize;
+
+    const int fd = shm_open(segment->_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) throw Pothos::SharedBufferError("ShmSegment::makeNamed("+segment->_name+")", "shm_open: " + std::string(strerror(errno)));
+    segment->_owner = true;
+    if (ftruncate(fd, off_t(segment->_length)) != 0)
+    {
+        const std::string error(strerror(errno));
+        close(fd);
+        throw Pothos::SharedBufferError("ShmSegment::makeNamed("+segment->_name+")", "ftruncate: " + error);
+    }
+
+    void *mem = mmap(nullptr, segment->_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const std::string error(strerror(errno));
+    close(fd);
+    if (mem == MAP_FAILED) throw Pothos::SharedBufferError("ShmSegment::makeNamed("+segment->_name+")", "mmap: " + error);
+    segment->_address = size_t(mem);
+    return registerSegment(segment.release());
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::open(const std::string &name)
+{
+    const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) throw Pothos::SharedBufferError("ShmSegment::open("+name+")", "shm_open: " + std::string(strerror(errno)));
+
+    //a named segment has one consumer, so the name is no longer needed
+    shm_unlink(name.c_str());
+    auto segment = ShmSegment::open(fd);
+    segment->_name = name;
+    return segment;
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::open(const int fd)
+{
+    std::unique_ptr<ShmSegment> segment(new ShmSegment());
+    segment->_fd = fd; //closed by the segment
+    struct stat st;
+    if (fstat(fd, &st) != 0 or st.st_size <= 0)
+    {
+        throw Pothos::SharedBufferError("ShmSegment::open()", "empty segment");
+    }
+    segment->_length = size_t(st.st_size);
+    segment->_address = size_t(mapDescriptor(fd, segment->_length, "ShmSegment::open()"));
+
+    //the mapping remains valid without the descriptor
+    close(segment->_fd);
+    segment->_fd = -1;
+    return registerSegment(segment.release());
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::lookup(const size_t address, const size_t length)
+{
+    std::lock_guard<std::mutex> lock(getSegmentsMutex());
+    const auto &segments = getSegments();
+    auto it = segments.upper_bound(address);
+    if (it == segments.begin()) return std::shared_ptr<ShmSegment>();
+    auto segment = (--it)->second.lock();
+    if (not segment or address + length > segment->getAddress() + segment->getLength()) return std::shared_ptr<ShmSegment>();
+    return segment;
+}
+
+Pothos::SharedBuffer ShmSegment::makeBuffer(const std::shared_ptr<ShmSegment> &segment)
+{
+    //the container aliases the segment so the buffer holds the mapping
+    std::shared_ptr<void> container(segment, reinterpret_cast<void *>(segment->getAddress()));
+    return Pothos::SharedBuffer(segment->getAddress(), segment->getLength(), container);
+}
+
+/***********************************************************************
+ * Channel layout in the shared segment:
+ * Each index is only written by one side and sits on its own cache line.
+ * The packet ring holds 8-byte aligned records of a packet and payload,
+ * and a record which does not fit before the end of the ring
+ * starts over at the beginning after a padding packet (type 0).
+ **********************************************************************/
+static const size_t PacketRingSize = 256*1024;
+static const size_t ReturnRingSize = 4096;
+static const size_t ProducerSide = 0;
+static const size_t ConsumerSide = 1;
+
+struct ShmChannel::Header
+{
+    alignas(64) std::atomic<uint64_t> packetHead;
+    alignas(64) std::atomic<uint64_t> packetTail;
+    alignas(64) std::atomic<uint64_t> returnHead;
+    alignas(64) std::atomic<uint64_t> returnTail;
+    alignas(64) std::atomic<uint32_t> waiting[2];
+    uint64_t returns[ReturnRingSize];
+    alignas(64) char packets[PacketRingSize];
+};
+
+static size_t recordSize(const size_t payloadSize)
+{
+    return sizeof(ShmChannel::Packet) + ((payloadSize + 7) & ~size_t(7));
+}
+
+/***********************************************************************
+ * The producer listens on a socket bound to the channel name:
+ * Linux has an abstract namespace which needs no cleanup,
+ * other systems bind a socket file in the temp directory.
+ * The sends do not raise SIGPIPE when the peer has exited.
+ **********************************************************************/
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static socklen_t makeDoorbellAddress(const std::string &name, sockaddr_un &addr)
+{
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    #ifdef __linux__
+    std::memcpy(addr.sun_path+1, name.data(), std::min(name.size(), sizeof(addr.sun_path)-1));
+    return socklen_t(offsetof(sockaddr_un, sun_path) + 1 + std::min(name.size(), sizeof(addr.sun_path)-1));
+    #else
+    const std::string path = "/tmp" + name;
+    std::memcpy(addr.sun_path, path.data(), std::min(path.size(), sizeof(addr.sun_path)-1));
+    return socklen_t(sizeof(addr));
+    #endif
+}
+
+static int makeDoorbellSocket(const std::string &name)
+{
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) throw Pothos::SharedBufferError("ShmChannel("+name+")", "socket: " + std::string(strerror(errno)));
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+static bool isPeerGone(const int error)
+{
+    return error == EPIPE or error == ECONNRESET or error == ENOTCONN;
+}
+
+/***********************************************************************
+ * ShmChannel implementation
+ **********************************************************************/
+ShmChannel::ShmChannel(const std::shared_ptr<ShmSegment> &segment, const size_t side):
+    _segment(segment),
+    _header(reinterpret_cast<Header *>(segment->getAddress())),
+    _side(side),
+    _listener(-1),
+    _doorbell(-1),
+    _peerClosed(false)
+{
+    sockaddr_un addr;
+    const auto addrLen = makeDoorbellAddress(this->getName(), addr);
+
+    //the producer listens until the consumer connects
+    if (_side == ProducerSide)
+    {
+        _listener = makeDoorbellSocket(this->getName());
+        fcntl(_listener, F_SETFL, fcntl(_listener, F_GETFL) | O_NONBLOCK);
+        if (bind(_listener, reinterpret_cast<const sockaddr *>(&addr), addrLen) != 0 or listen(_listener, 1) != 0)
+        {
+            const std::string error(strerror(errno));
+            close(_listener);
+            throw Pothos::SharedBufferError("ShmChannel("+this->getName()+")", "bind: " + error);
+        }
+    }
+
+    //the consumer connects, the listen backlog holds the connection
+    else
+    {
+        _doorbell = makeDoorbellSocket(this->getName());
+        if (connect(_doorbell, reinterpret_cast<const sockaddr *>(&addr), addrLen) != 0)
+        {
+            const std::string error(strerror(errno));
+            close(_doorbell);
+            throw Pothos::SharedBufferError("ShmChannel("+this->getName()+")", "connect: " + error);
+        }
+    }
+}
+
+ShmChannel::~ShmChannel(void)
+{
+    //closing the socket hangs up the peer's doorbell
+    if (_doorbell >= 0) close(_doorbell);
+    if (_listener >= 0) close(_listener);
+    #ifndef __linux__
+    if (_side == ProducerSide)
+    {
+        sockaddr_un addr;
+        makeDoorbellAddress(this->getName(), addr);
+        unlink(addr.sun_path);
+    }
+    #endif
+}
+
+std::shared_ptr<ShmChannel> ShmChannel::make(void)
+{
+    //the consumer removes the name once it opened the channel
+    auto segment = ShmSegment::makeNamed(sizeof(Header));
+    new (reinterpret_cast<void *>(segment->getAddress())) Header();
+    return std::shared_ptr<ShmChannel>(new ShmChannel(segment, ProducerSide));
+}
+
+std::shared_ptr<ShmChannel> ShmChannel::open(const std::string &name)
+{
+    auto segment = ShmSegment::open(name);
+    if (segment->getLength() < sizeof(Header)) throw Pothos::SharedBufferError("ShmChannel::open("+name+")", "segment too small");
+    return std::shared_ptr<ShmChannel>(new ShmChannel(segment, ConsumerSide));
+}
+
+const std::string &ShmChannel::getName(void) const
+{
+    return _segment->getName();
+}
+
+void ShmChannel::accept(void)
+{
+    if (_doorbell >= 0) return;
+    _doorbell = ::accept(_listener, nullptr, nullptr);
+    if (_doorbell < 0) throw Pothos::SharedBufferError("ShmChannel::accept("+this->getName()+")", "no consumer: " + std::string(strerror(errno)));
+    fcntl(_doorbell, F_SETFD, FD_CLOEXEC);
+    fcntl(_doorbell, F_SETFL, fcntl(_doorbell, F_GETFL) & ~O_NONBLOCK);
+    close(_listener);
+    _listener = -1;
+}
+
+int ShmChannel::getDoorbell(void) const
+{
+    return _doorbell;
+}
+
+void ShmChannel::clearDoorbell(void)
+{
+    if (_doorbell < 0) return;
+    while (true)
+    {
+        //a ring is one byte, a passed segment is its identifier and descriptor
+        uint64_t id(0);
+        iovec iov;
+        iov.iov_base = &id;
+        iov.iov_len = sizeof(id);
+        union {cmsghdr align; char buff[CMSG_SPACE(sizeof(int))];} control;
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buff;
+        msg.msg_controllen = sizeof(control.buff);
+
+        const ssize_t ret = recvmsg(_doorbell, &msg, MSG_DONTWAIT);
+        if (ret < 0 and errno == EINTR) continue;
+        if (ret < 0 and isPeerGone(errno)) _peerClosed = true;
+        if (ret == 0) _peerClosed = true;
+        if (ret <= 0) return;
+
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == nullptr or cmsg->cmsg_level != SOL_SOCKET or cmsg->cmsg_type != SCM_RIGHTS) continue;
+        int fd(-1);
+        std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        _segments[id] = ShmSegment::open(fd);
+    }
+}
+
+void ShmChannel::sleep(const long timeoutMs)
+{
+    pollfd pfd;
+    pfd.fd = _doorbell;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll(&pfd, 1, int(timeoutMs));
+    this->clearDoorbell();
+}
+
+bool ShmChannel::wait(void)
+{
+    //announce the wait before checking, the peer writes before checking
+    _header->waiting[_side].store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_side == ProducerSide) return _header->returnHead.load(std::memory_order_acquire) == _header->returnTail.load(std::memory_order_relaxed);
+    return _header->packetHead.load(std::memory_order_acquire) == _header->packetTail.load(std::memory_order_relaxed);
+}
+
+bool ShmChannel::isPeerClosed(void) const
+{
+    return _peerClosed.load();
+}
+
+size_t ShmChannel::getMaxPayloadSize(void) const
+{
+    return PacketRingSize/4;
+}
+
+size_t ShmChannel::getMaxReturns(void) const
+{
+    return ReturnRingSize;
+}
+
+void ShmChannel::ringPeer(void)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto &waiting = _header->waiting[1-_side];
+    if (waiting.load(std::memory_order_relaxed) == 0) return;
+    if (waiting.exchange(0) == 0) return;
+
+    //a full socket buffer means the peer was already rung
+    const char ring(0);
+    if (send(_doorbell, &ring, 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 and isPeerGone(errno)) _peerClosed = true;
+}
+
+void ShmChannel::sendSegment(const std::shared_ptr<ShmSegment> &segment)
+{
+    const uint64_t id = segment->getId();
+    if (_sentSegments.count(id) != 0) return;
+    if (segment->getDescriptor() < 0) throw Pothos::SharedBufferError("ShmChannel::sendSegment("+this->getName()+")", "segment has no descriptor");
+
+    uint64_t payload(id);
+    iovec iov;
+    iov.iov_base = &payload;
+    iov.iov_len = sizeof(payload);
+    union {cmsghdr align; char buff[CMSG_SPACE(sizeof(int))];} control;
+    std::memset(&control, 0, sizeof(control));
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buff;
+    msg.msg_controllen = sizeof(control.buff);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    const int fd = segment->getDescriptor();
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+    //the segment is sent before the packets which refer to it
+    ssize_t ret(0);
+    do ret = sendmsg(_doorbell, &msg, MSG_NOSIGNAL);
+    while (ret < 0 and errno == EINTR);
+    if (ret < 0 and isPeerGone(errno)) _peerClosed = true;
+    else if (ret < 0) throw Pothos::SharedBufferError("ShmChannel::sendSegment("+this->getName()+")", "sendmsg: " + std::string(strerror(errno)));
+    else _sentSegments.insert(id);
+}
+
+std::shared_ptr<ShmSegment> ShmChannel::getSegment(const uint64_t id)
+{
+    //the segment was sent before the packet, so it is in the socket
+    auto it = _segments.find(id);
+    if (it == _segments.end())
+    {
+        this->clearDoorbell();
+        it = _segments.find(id);
+    }
+    if (it == _segments.end()) throw Pothos::SharedBufferError("ShmChannel::getSegment("+this->getName()+")", "unknown segment " + std::to_string(id));
+    return it->second;
+}
+
+bool ShmChannel::writable(const size_t *payloadSizes, const size_t numPackets) const
+{
+    uint64_t end = _header->packetHead.load(std::memory_order_relaxed);
+    const uint64_t tail = _header->packetTail.load(std::memory_order_acquire);
+    for (size_t i = 0; i < numPackets; i++)
+    {
+        if (payloadSizes[i] > this->getMaxPayloadSize()) return false;
+        const size_t size = recordSize(payloadSizes[i]);
+        const size_t pos = size_t(end % PacketRingSize);
+        if (PacketRingSize - pos < size) end += PacketRingSize - pos;
+        end += size;
+    }
+    return end - tail <= PacketRingSize;
+}
+
+void ShmChannel::write(const Packet &packet, const std::string &payload)
+{
+    uint64_t head = _header->packetHead.load(std::memory_order_relaxed);
+    const size_t size = recordSize(payload.size());
+    size_t pos = size_t(head % PacketRingSize);
+
+    //pad the end of the ring when the record does not fit
+    if (PacketRingSize - pos < size)
+    {
+        if (PacketRingSize - pos >= sizeof(Packet))
+        {
+            Packet padding = Packet();
+            std::memcpy(_header->packets+pos, &padding, sizeof(padding));
+        }
+        head += PacketRingSize - pos;
+        pos = 0;
+    }
+
+    Packet record(packet);
+    record.payloadSize = uint32_t(payload.size());
+    std::memcpy(_header->packets+pos, &record, sizeof(record));
+    std::memcpy(_header->packets+pos+sizeof(record), payload.data(), payload.size());
+    _header->packetHead.store(head+size, std::memory_order_release);
+    this->ringPeer();
+}
+
+bool ShmChannel::read(Packet &packet, std::string &payload)
+{
+    auto &tailIndex = _header->packetTail;
+    while (true)
+    {
+        const uint64_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (_header->packetHead.load(std::memory_order_acquire) == tail) return false;
+        const size_t pos = size_t(tail % PacketRingSize);
+
+        //skip the padding at the end of the ring
+        if (PacketRingSize - pos < sizeof(Packet))
+        {
+            tailIndex.store(tail + PacketRingSize - pos, std::memory_order_release);
+            continue;
+        }
+        std::memcpy(&packet, _header->packets+pos, sizeof(packet));
+        if (packet.type == 0)
+        {
+            tailIndex.store(tail + PacketRingSize - pos, std::memory_order_release);
+            continue;
+        }
+
+        if (packet.payloadSize > this->getMaxPayloadSize()) throw Pothos::SharedBufferError("ShmChannel::read("+this->getName()+")", "corrupt packet");
+        payload.assign(_header->packets+pos+sizeof(packet), packet.payloadSize);
+        tailIndex.store(tail + recordSize(packet.payloadSize), std::memory_order_release);
+        this->ringPeer();
+        return true;
+    }
+}
+
+void ShmChannel::pushReturn(const uint64_t sequence)
+{
+    {
+        std::lock_guard<std::mutex> lock(_returnMutex);
+        const uint64_t head = _header->returnHead.load(std::memory_order_relaxed);
+        _header->returns[head % ReturnRingSize] = sequence;
+        _header->returnHead.store(head+1, std::memory_order_release);
+    }
+    this->ringPeer();
+}
+
+bool ShmChannel::popReturn(uint64_t &sequence)
+{
+    const uint64_t tail = _header->returnTail.load(std::memory_order_relaxed);
+    if (_header->returnHead.load(std::memory_order_acquire) == tail) return false;
+    sequence = _header->returns[tail % ReturnRingSize];
+    _header->returnTail.store(tail+1, std::memory_order_release);
+    return true;
+}
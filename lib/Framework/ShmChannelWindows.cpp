@@ -0,0 +1,149 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/ShmChannel.hpp"
+#include <Pothos/Framework/Exception.hpp>
+
+/***********************************************************************
+ * Shared memory channels are only implemented on Unix systems,
+ * the topology keeps the network flows on this platform.
+ **********************************************************************/
+ShmSegment::ShmSegment(void):
+    _id(0),
+    _fd(-1),
+    _address(0),
+    _length(0),
+    _owner(false)
+{
+    return;
+}
+
+ShmSegment::~ShmSegment(void)
+{
+    return;
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::make(const size_t)
+{
+    throw Pothos::SharedBufferError("ShmSegment::make()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::makeNamed(const size_t)
+{
+    throw Pothos::SharedBufferError("ShmSegment::makeNamed()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::open(const std::string &)
+{
+    throw Pothos::SharedBufferError("ShmSegment::open()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::open(const int)
+{
+    throw Pothos::SharedBufferError("ShmSegment::open()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::lookup(const size_t, const size_t)
+{
+    return std::shared_ptr<ShmSegment>();
+}
+
+Pothos::SharedBuffer ShmSegment::makeBuffer(const std::shared_ptr<ShmSegment> &)
+{
+    throw Pothos::SharedBufferError("ShmSegment::makeBuffer()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmChannel> ShmChannel::make(void)
+{
+    throw Pothos::SharedBufferError("ShmChannel::make()", "not supported on this platform");
+}
+
+std::shared_ptr<ShmChannel> ShmChannel::open(const std::string &)
+{
+    throw Pothos::SharedBufferError("ShmChannel::open()", "not supported on this platform");
+}
+
+ShmChannel::~ShmChannel(void)
+{
+    return;
+}
+
+const std::string &ShmChannel::getName(void) const
+{
+    return _segment->getName();
+}
+
+void ShmChannel::accept(void)
+{
+    return;
+}
+
+int ShmChannel::getDoorbell(void) const
+{
+    return _doorbell;
+}
+
+void ShmChannel::clearDoorbell(void)
+{
+    return;
+}
+
+void ShmChannel::sleep(const long)
+{
+    return;
+}
+
+bool ShmChannel::wait(void)
+{
+    return true;
+}
+
+bool ShmChannel::isPeerClosed(void) const
+{
+    return true;
+}
+
+size_t ShmChannel::getMaxPayloadSize(void) const
+{
+    return 0;
+}
+
+size_t ShmChannel::getMaxReturns(void) const
+{
+    return 0;
+}
+
+void ShmChannel::sendSegment(const std::shared_ptr<ShmSegment> &)
+{
+    return;
+}
+
+std::shared_ptr<ShmSegment> ShmChannel::getSegment(const uint64_t)
+{
+    throw Pothos::SharedBufferError("ShmChannel::getSegment()", "not supported on this platform");
+}
+
+bool ShmChannel::writable(const size_t *, const size_t) const
+{
+    return false;
+}
+
+void ShmChannel::write(const Packet &, const std::string &)
+{
+    return;
+}
+
+bool ShmChannel::read(Packet &, std::string &)
+{
+    return false;
+}
+
+void ShmChannel::pushReturn(const uint64_t)
+{
+    return;
+}
+
+bool ShmChannel::popReturn(uint64_t &)
+{
+    return false;
+}
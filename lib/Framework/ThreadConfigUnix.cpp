@@ -5,6 +5,8 @@
 #include <Poco/Logger.h>
 #include <Poco/Environment.h>
 #include <sched.h>
+#include <sys/mman.h> //mlockall
+#include <unistd.h> //sysconf
 #ifdef HAVE_LIBNUMA
 #include <numa.h>
 #endif
@@ -103,3 +105,15 @@ std::string ThreadEnvironment::setNodeAffinity(const std::vector<size_t> &affini
     return "numa_bind() not available";
     #endif
 }
+
+std::string ThreadEnvironment::lockMemory(const bool lock)
+{
+    if (lock and mlockall(MCL_CURRENT | MCL_FUTURE) != 0) return strerror(errno);
+    if (not lock and munlockall() != 0) return strerror(errno);
+    return "";
+}
+
+size_t ThreadEnvironment::getPageSize(void)
+{
+    return size_t(sysconf(_SC_PAGESIZE));
+}
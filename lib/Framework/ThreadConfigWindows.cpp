@@ -53,3 +53,17 @@ std::string ThreadEnvironment::setNodeAffinity(const std::vector<size_t> &affini
     if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask)) != 0) return "";
     return "SetThreadAffinityMask() fail";
 }
+
+std::string ThreadEnvironment::lockMemory(const bool lock)
+{
+    //there is no process-wide equivalent of mlockall()
+    if (not lock) return "";
+    return "memory locking not supported";
+}
+
+size_t ThreadEnvironment::getPageSize(void)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return size_t(systemInfo.dwPageSize);
+}
@@ -1,62 +1,180 @@
-// Copyright (c) 2015-2015 Josh Blum
+// Copyright (c) 2015-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/ThreadEnvironment.hpp"
 #include <Poco/Logger.h>
+#include <Poco/Environment.h>
 #include <iostream>
+#include <algorithm> //remove, find_if, min, max
 #include <cassert>
 
+/***********************************************************************
+ * The process memory is locked while any realtime pool exists:
+ * Pools count their references under the mutex,
+ * and the last pool to be destroyed unlocks the memory.
+ **********************************************************************/
+static std::mutex &getMemoryLockMutex(void)
+{
+    static std::mutex *mutex = new std::mutex(); //leaked for use at exit
+    return *mutex;
+}
+
+static size_t numMemoryLocks = 0;
+
 ThreadEnvironment::ThreadEnvironment(const Pothos::ThreadPoolArgs &args):
     _args(args),
     _waitModeEnabled(_args.yieldMode != "SPIN"),
-    _configurationSignature(0)
+    _memoryLocked(false),
+    _numReadyTasks(0),
+    _numUrgentTasks(0),
+    _numWaitingThreads(0),
+    _numRegistrations(0),
+    _configurationSignature(0),
+    _numPoolThreads(_args.numThreads),
+    _elasticEnabled(_args.numThreads != 0 and _args.maxThreads != 0),
+    _elasticDone(false),
+    _timerDone(false),
+    _epollFd(-1),
+    _epollWakeFd(-1)
 {
-    return;
+    //elastic mode: start with numThreads within the min and max thread counts
+    size_t maxPoolThreads = _args.numThreads;
+    if (_elasticEnabled)
+    {
+        _numPoolThreads = std::min(std::max(_args.numThreads, std::max<size_t>(_args.minThreads, 1)), _args.maxThreads);
+        maxPoolThreads = _args.maxThreads;
+    }
+
+    //pool mode: create a ready queue per thread when stealing, otherwise one shared queue
+    size_t numQueues = (_args.schedulerMode == "STEALING")?maxPoolThreads:1;
+    if (_args.numThreads == 0) numQueues = 0;
+    for (size_t i = 0; i < numQueues; i++)
+    {
+        _readyQueues.emplace_back(new ReadyQueue());
+    }
+
+    //pool mode: per-thread stats for every possible thread
+    if (_args.numThreads == 0) maxPoolThreads = 0;
+    for (size_t i = 0; i < maxPoolThreads; i++)
+    {
+        _threadStats.emplace_back(new PoolThreadStats());
+    }
+
+    //realtime profile: lock memory -- log message only on first failure
+    if (_args.profile == "REALTIME")
+    {
+        std::lock_guard<std::mutex> lock(getMemoryLockMutex());
+        const auto errorMsg = (numMemoryLocks == 0)?ThreadEnvironment::lockMemory(true):"";
+        static bool showErrorMsg = true;
+        if (not errorMsg.empty() and showErrorMsg)
+        {
+            showErrorMsg = false;
+            poco_error_f1(Poco::Logger::get("Pothos.ThreadPool"), "Failed to lock memory %s", errorMsg);
+        }
+        _memoryLocked = errorMsg.empty();
+        if (_memoryLocked) numMemoryLocks++;
+    }
+
+    //elastic mode: start the monitor thread
+    if (_elasticEnabled)
+    {
+        _elasticMonitor = std::thread(&ThreadEnvironment::elasticMonitorLoop, this);
+    }
 }
 
 ThreadEnvironment::~ThreadEnvironment(void)
 {
+    //stop the timer service, pending timers are discarded
+    if (_timerThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_timerMutex);
+            _timerDone = true;
+        }
+        _timerCond.notify_one();
+        _timerThread.join();
+    }
+
+    //stop the readiness service, descriptors are no longer monitored
+    this->stopDescriptorService();
+
+    //stop the elastic monitor before the tasks are removed
+    if (_elasticMonitor.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_elasticMutex);
+            _elasticDone = true;
+        }
+        _elasticCond.notify_one();
+        _elasticMonitor.join();
+    }
+
     //tear-down all tasks if not done by caller
     while (not _handleToTask.empty())
     {
         this->unregisterTask(_handleToTask.begin()->first);
     }
+
+    //realtime profile: the last locked pool unlocks memory
+    if (_memoryLocked)
+    {
+        std::lock_guard<std::mutex> lock(getMemoryLockMutex());
+        if (--numMemoryLocks == 0) ThreadEnvironment::lockMemory(false);
+    }
 }
 
-void ThreadEnvironment::registerTask(void *handle, TaskData::Task task, TaskData::Wake wake)
+TaskData *ThreadEnvironment::registerTask(void *handle, TaskData::Task task, TaskData::Wake wake, const TaskHints &hints)
 {
     std::lock_guard<std::mutex> lock(_registrationMutex);
 
-    //disable wait mode
-    bool waitModeEnabled = false;
-    std::swap(waitModeEnabled, _waitModeEnabled);
+    //assign the ready queues to new tasks in turn
+    const size_t queueIndex = _readyQueues.empty()?0:(_numRegistrations++ % _readyQueues.size());
+
+    //tasks with the same placement hint share a placement group,
+    //tasks without a hint share the group of their automatic node
+    std::shared_ptr<PlacementGroup> placement;
+    const auto placementKey = std::make_pair(hints.affinityMode, hints.affinity);
+    const bool hasPlacement = not hints.affinityMode.empty() and hints.affinityMode != "ALL" and not hints.affinity.empty();
+    const bool hasNode = not hasPlacement and hints.nodeAffinity >= 0;
+    if (hasPlacement and _placements.count(placementKey) != 0) placement = _placements.at(placementKey);
+    else if (hasPlacement) placement.reset(new PlacementGroup(hints.affinityMode, hints.affinity));
+    else if (hasNode and _nodePlacements.count(hints.nodeAffinity) != 0) placement = _nodePlacements.at(hints.nodeAffinity);
+    else if (hasNode) placement.reset(new PlacementGroup("NUMA", std::vector<size_t>(1, size_t(hints.nodeAffinity)), true));
+    if (placement) placement->numTasks++;
+    std::shared_ptr<TaskData> data(new TaskData(task, wake, this, queueIndex, placement, hints));
 
-    //register the new task and bump the signature to notify threads
+    //register the new task, only a new placement group changes the pool configuration
+    const bool newPlacement = placement and placement->numTasks == 1 and _args.numThreads != 0;
     {
         std::lock_guard<std::mutex> lock0(_handleUpdateMutex);
-        _handleToTask[handle].reset(new TaskData(task, wake));
-        _configurationSignature++;
+        _handleToTask[handle] = data;
+        if (newPlacement)
+        {
+            if (hasNode) _nodePlacements[hints.nodeAffinity] = placement;
+            else _placements[placementKey] = placement;
+            _configurationSignature++;
+        }
+    }
+
+    //wake every pool thread to accept the new config state
+    if (newPlacement)
+    {
+        std::lock_guard<std::mutex> lock0(_readyMutex);
+        _readyCond.notify_all();
     }
 
     //single task mode: spawn a new thread for this task
     if (_args.numThreads == 0)
     {
-        _handleToThread[handle] = std::thread(std::bind(&ThreadEnvironment::singleProcessLoop, this, handle));
+        _handleToThread[handle] = std::thread(std::bind(&ThreadEnvironment::singleProcessLoop, this, data));
     }
 
     //pool mode: start a thread if the pool size is too small
-    else
-    {
-        if (_threadPool.size() < _args.numThreads)
-        {
-            size_t index = _threadPool.size();
-            _threadPool.push_back(std::thread(std::bind(&ThreadEnvironment::poolProcessLoop, this, index)));
-        }
-        assert(_threadPool.size() <= _args.numThreads);
-    }
+    else this->resizeThreadPool();
 
-    //restore wait mode
-    std::swap(waitModeEnabled, _waitModeEnabled);
+    //the caller notifies the ready queue in pool mode
+    if (_args.numThreads == 0) return nullptr;
+    return data.get();
 }
 
 void ThreadEnvironment::unregisterTask(void *handle)
@@ -64,99 +182,457 @@ void ThreadEnvironment::unregisterTask(void *handle)
     std::lock_guard<std::mutex> lock(_registrationMutex);
     std::shared_ptr<TaskData> data;
 
-    //disable wait mode
-    bool waitModeEnabled = false;
-    std::swap(waitModeEnabled, _waitModeEnabled);
-
-    //unregister the new task and bump the signature to notify threads
+    //unregister the task, only a removed placement group changes the pool configuration
+    bool oldPlacement = false;
     {
         std::lock_guard<std::mutex> lock0(_handleUpdateMutex);
-        std::swap(data, _handleToTask[handle]);
-        _handleToTask.erase(handle);
-        _configurationSignature++;
+        auto it = _handleToTask.find(handle);
+        std::swap(data, it->second);
+        _handleToTask.erase(it);
+        const auto &placement = data->placement;
+        if (placement and --placement->numTasks == 0 and _args.numThreads != 0)
+        {
+            if (placement->shared) _nodePlacements.erase(long(placement->affinity.front()));
+            else _placements.erase(std::make_pair(placement->affinityMode, placement->affinity));
+            _configurationSignature++;
+            oldPlacement = true;
+        }
     }
 
-    //wake every known task to accept the new config state
-    data->wake();
-    for (const auto &pair : _handleToTask) pair.second->wake();
+    //pairs with the epoch increment in the pool process loop
+    data->registered.store(false, std::memory_order_seq_cst);
 
-    //single task mode: stop the explicit task for this handle
+    //single task mode: stop the explicit task for this handle,
+    //wake the task until its thread observes the unregistration
     if (_args.numThreads == 0)
     {
-        _handleToThread[handle].join();
-        _handleToThread.erase(handle);
+        auto it = _handleToThread.find(handle);
+        while (not data->exited)
+        {
+            data->wake();
+            std::this_thread::yield();
+        }
+        it->second.join();
+        _handleToThread.erase(it);
+        return;
+    }
+
+    //wake every pool thread to accept the new config state
+    if (oldPlacement)
+    {
+        std::lock_guard<std::mutex> lock0(_readyMutex);
+        _readyCond.notify_all();
     }
 
     //pool mode: stop a thread if the pool size is too large
-    else
+    this->resizeThreadPool();
+
+    //wait for the threads which may be processing the task,
+    //stale entries in the ready queues are skipped by the threads
+    this->waitQuiescentThreads();
+}
+
+/*!
+ * Task table reclamation mechanics:
+ * Registration and unregistration never copy the task table
+ * and never stall the pool threads which are processing tasks.
+ *
+ * Each pool thread has an epoch counter which is incremented
+ * before a task is processed (odd) and after it completes (even).
+ * The registered flag of the task is checked within the epoch.
+ * Unregistration clears the registered flag, and then waits
+ * for the threads that were inside of an epoch at that time.
+ * A thread which enters an epoch after the flag was cleared
+ * observes the cleared flag and skips the task, so once the
+ * waited epochs have completed, the task is never called again.
+ * The wait is bound by the duration of a single task call.
+ *
+ * In thread-per-block mode, each thread holds its own task data,
+ * and exits once it observes the cleared registered flag.
+ */
+void ThreadEnvironment::waitQuiescentThreads(void)
+{
+    for (const auto &stats : _threadStats)
+    {
+        const size_t epoch = stats->epoch.load(std::memory_order_seq_cst);
+        if ((epoch & 1) == 0) continue; //not in a task
+        while (stats->epoch.load() == epoch) std::this_thread::yield();
+    }
+}
+
+/*!
+ * Thread pool ready queue mechanics:
+ * The goal is to only dispatch tasks which have a pending change,
+ * so that the cost of idle tasks is zero for the pool threads,
+ * and so that a change is dispatched without sweeping all tasks.
+ *
+ * The actor calls notifyReady() after flagging an external change.
+ * The queued flag ensures that a task is queued at most once,
+ * and it remains set while the task is being processed,
+ * so the same task is never processed by two pool threads.
+ *
+ * Once a task was successfully acquired and completed,
+ * it is pushed back into the ready queue, because the task
+ * may have flagged an internal change for itself during work.
+ * Otherwise the queued flag is released and the task is tried
+ * once more to catch changes flagged before the flag release.
+ *
+ * In the default scheduler mode, all threads share one queue,
+ * so that the ready tasks are processed in a round-robin order.
+ * In the work-stealing scheduler mode, each task is assigned
+ * to the queue of one thread, and idle threads steal tasks
+ * from the back of the other thread's queues.
+ *
+ * Tasks with a placement hint are queued in a placement group.
+ * Each group is designated to one pool thread, which pins itself
+ * to the hinted CPUs or NUMA nodes, and which checks its groups
+ * before the other queues. Other threads never steal these tasks.
+ * Tasks which were placed on a NUMA node by the topology are queued
+ * in the shared group of the node. The group is designated to all
+ * pool threads of the node, which share and steal its tasks.
+ *
+ * Tasks in the high priority and deadline scheduling classes
+ * are queued in a shared urgent queue which every thread checks
+ * before its own queue. Deadline tasks are ordered by absolute
+ * deadline (the time when queued plus the relative deadline),
+ * ahead of the high priority tasks, which are ordered first-in.
+ * A deadline task which is dispatched late counts a deadline miss.
+ *
+ * When no tasks are ready, the threads wait on a condition.
+ * In the hybrid yield mode, threads spin and then yield first.
+ * A pushed task only signals the condition when threads wait,
+ * so the spinning threads pick up tasks without a system call.
+ */
+
+void ThreadEnvironment::notifyReady(TaskData *task)
+{
+    //pairs with the fence after the queued flag release in processReadyTask()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (task->queued.test_and_set()) return; //already queued
+    this->pushReadyTask(task->shared_from_this());
+}
+
+void ThreadEnvironment::pushReadyTask(std::shared_ptr<TaskData> &&data)
+{
+    //only the designated thread can process a placed task
+    const bool placed = bool(data->placement);
+
+    //urgent tasks are ordered by deadline, then by arrival
+    if (not placed and data->urgent)
     {
-        if (_threadPool.size() > _handleToTask.size())
         {
-            _threadPool.back().join();
-            _threadPool.resize(_handleToTask.size());
+            std::lock_guard<Pothos::Util::SpinLock> lock(_urgentQueue.lock);
+            auto &tasks = _urgentQueue.tasks;
+            auto it = tasks.end();
+            if (data->deadline.count() != 0)
+            {
+                data->absoluteDeadline = std::chrono::high_resolution_clock::now() + data->deadline;
+                it = std::find_if(tasks.begin(), tasks.end(), [&data](const std::shared_ptr<TaskData> &other){
+                    return other->deadline.count() == 0 or other->absoluteDeadline > data->absoluteDeadline;
+                });
+            }
+            _numUrgentTasks++;
+            tasks.insert(it, std::move(data));
+        }
+        if (_numWaitingThreads != 0)
+        {
+            std::lock_guard<std::mutex> lock(_readyMutex);
+            _readyCond.notify_one();
         }
-        assert(_threadPool.size() <= _args.numThreads);
+        return;
     }
 
-    //wait for all threads to relinquish the old configuration
-    while (not data.unique()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    {
+        auto &queue = placed?data->placement->queue:*_readyQueues[data->queueIndex];
+        std::lock_guard<Pothos::Util::SpinLock> lock(queue.lock);
+        if (placed) data->placement->numReadyTasks++;
+        else _numReadyTasks++;
+        queue.tasks.push_back(std::move(data));
+    }
 
-    //restore wait mode
-    std::swap(waitModeEnabled, _waitModeEnabled);
+    //wake a waiting thread to process the ready task
+    if (_numWaitingThreads != 0)
+    {
+        std::lock_guard<std::mutex> lock(_readyMutex);
+        if (placed) _readyCond.notify_all();
+        else _readyCond.notify_one();
+    }
 }
 
-/*!
- * Call wake on all tasks that are busy:
- * Busy tasks will fail the test and set and may be in a CV wait state.
- * Do not call wake on the caller task since that would have no effect.
- * \param tasks a map of all tasks from the caller task
- * \param self the caller task itself to avoid self-wake
- */
-template <typename TasksType>
-void wakeAllBusyTasks(const TasksType &tasks, void *self)
+bool ThreadEnvironment::popReadyTask(const size_t index, const std::vector<std::shared_ptr<PlacementGroup>> &placements, std::shared_ptr<TaskData> &data)
 {
-    for (const auto &task : tasks)
+    //the designated placement groups take precedence
+    for (const auto &placement : placements)
+    {
+        if (placement->numReadyTasks == 0) continue;
+        auto &queue = placement->queue;
+        std::lock_guard<Pothos::Util::SpinLock> lock(queue.lock);
+        if (queue.tasks.empty()) continue;
+        data = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        placement->numReadyTasks--;
+        return true;
+    }
+
+    //urgent tasks are served by any thread before the normal queues
+    if (_numUrgentTasks != 0)
     {
-        if (task.first == self) continue;
+        std::lock_guard<Pothos::Util::SpinLock> lock(_urgentQueue.lock);
+        if (not _urgentQueue.tasks.empty())
+        {
+            data = std::move(_urgentQueue.tasks.front());
+            _urgentQueue.tasks.pop_front();
+            _numUrgentTasks--;
+            return true;
+        }
+    }
+
+    if (_numReadyTasks == 0) return false;
 
-        //if we fail to get the lock, a thread may be waiting
-        if (task.second->flag.test_and_set(std::memory_order_acquire))
+    const size_t numQueues = _readyQueues.size();
+    for (size_t i = 0; i < numQueues; i++)
+    {
+        //visit the thread's own queue first, then the neighbors
+        auto &queue = *_readyQueues[(index+i) % numQueues];
         {
-            task.second->wake();
+            std::lock_guard<Pothos::Util::SpinLock> lock(queue.lock);
+            if (queue.tasks.empty()) continue;
+
+            //pop from the front of the own queue, steal from the back of others
+            if (i == 0)
+            {
+                data = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                data = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
         }
-        //got the lock, so there is nothing to wake -> unlock
-        else
+        _numReadyTasks--;
+        if (i != 0 and data->taskStolen) data->taskStolen();
+        return true;
+    }
+    return false;
+}
+
+void ThreadEnvironment::processReadyTask(std::shared_ptr<TaskData> &&data)
+{
+    //the task was unregistered while in the queue
+    if (not data->registered) return;
+
+    //count a deadline miss when dispatched late
+    if (data->deadline.count() != 0 and not data->placement and
+        std::chrono::high_resolution_clock::now() > data->absoluteDeadline)
+    {
+        if (data->deadlineMissed) data->deadlineMissed();
+    }
+
+    //the task was acquired, check it again for internal changes
+    if (data->task(false))
+    {
+        this->pushReadyTask(std::move(data));
+        return;
+    }
+
+    //release the queued flag so new changes will queue the task
+    data->queued.clear();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    //a change flagged before the release did not queue the task
+    if (not data->task(false)) return;
+    if (data->queued.test_and_set()) return; //already queued
+    this->pushReadyTask(std::move(data));
+}
+
+void ThreadEnvironment::waitReadyTask(const size_t localSignature, const std::vector<std::shared_ptr<PlacementGroup>> &placements)
+{
+    std::unique_lock<std::mutex> lock(_readyMutex);
+    _numWaitingThreads++;
+    _readyCond.wait(lock, [this, localSignature, &placements]{
+        for (const auto &placement : placements)
         {
-            task.second->flag.clear(std::memory_order_release);
+            if (placement->numReadyTasks != 0) return true;
         }
+        return _numReadyTasks != 0 or _numUrgentTasks != 0 or _configurationSignature != localSignature;
+    });
+    _numWaitingThreads--;
+}
+
+std::vector<std::shared_ptr<PlacementGroup>> ThreadEnvironment::getPlacements(const size_t index) const
+{
+    //designate the placement groups to the running threads in turn,
+    //the running threads are the smaller of the thread count
+    //and the number of tasks, so the designated index is running
+    const size_t numThreads = std::min<size_t>(_numPoolThreads, _handleToTask.size());
+    std::vector<std::shared_ptr<PlacementGroup>> placements;
+    size_t i = 0;
+    for (const auto &pair : _placements)
+    {
+        if ((i++ % numThreads) == index) placements.push_back(pair.second);
+    }
+
+    //the running threads are divided among the shared node groups,
+    //and each group has at least one thread when there are fewer threads
+    const size_t numNodes = _nodePlacements.size();
+    size_t j = 0;
+    for (const auto &pair : _nodePlacements)
+    {
+        if ((index % numNodes) == j or (j % numThreads) == index) placements.push_back(pair.second);
+        j++;
+    }
+    return placements;
+}
+
+void ThreadEnvironment::resizeThreadPool(void)
+{
+    const size_t numThreads = std::min<size_t>(_numPoolThreads, _handleToTask.size());
+    if (_threadPool.size() == numThreads) return;
+
+    //a new thread count changes the designated placement groups,
+    //and threads out of range exit on the new signature
+    {
+        std::lock_guard<std::mutex> lock(_handleUpdateMutex);
+        _configurationSignature++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_readyMutex);
+        _readyCond.notify_all();
+    }
+
+    //start threads until the pool has the desired size
+    while (_threadPool.size() < numThreads)
+    {
+        const size_t index = _threadPool.size();
+        _threadPool.push_back(std::thread(std::bind(&ThreadEnvironment::poolProcessLoop, this, index)));
+    }
+
+    //stop threads from the back
+    while (_threadPool.size() > numThreads)
+    {
+        _threadPool.back().join();
+        _threadPool.pop_back();
     }
 }
 
 /*!
- * Thread pool wait and wake-up mechanics:
- * The goal is to ensure that when wait mode is enabled,
- * threads are not allowed to wait in a task when another
- * task is immediately capable of performing useful work.
- *
- * Threads are given a chance to wait in a task only after
- * failing to acquire N times, where N is the number of tasks.
- * Once a task is successfully acquired and completed,
- * or once the attempted acquisition with "wait" returns,
- * the failure count reset and the mechanism begins again.
- *
- * After a thread successfully acquires the task context,
- * it must wake up all other potentially waiting threads.
- * This ensures that threads will be available to process
- * new tasks that are capable of performing useful work.
+ * Elastic thread pool mechanics:
+ * Each pool thread accumulates the time spent processing tasks.
+ * Once per period, the monitor computes the utilization,
+ * the busy time over the elapsed time of the running threads.
+ * Above the target band, a thread is added (up to maxThreads),
+ * below the band, the last thread is retired (down to minThreads).
+ * A single step per period gives the new thread count a period
+ * to take effect before the next decision, avoiding oscillation.
+ * Tasks in the queue of a retired thread are stolen by the others.
  */
+void ThreadEnvironment::elasticMonitorLoop(void)
+{
+    const std::chrono::nanoseconds period(_args.elasticPeriodNs);
+    auto lastTime = std::chrono::high_resolution_clock::now();
+    unsigned long long lastBusyNs = 0;
+
+    std::unique_lock<std::mutex> lock(_elasticMutex);
+    while (not _elasticCond.wait_for(lock, period, [this]{return _elasticDone;}))
+    {
+        //sample the busy time of all threads since the last period
+        const auto time = std::chrono::high_resolution_clock::now();
+        unsigned long long busyNs = 0;
+        for (const auto &stats : _threadStats) busyNs += stats->busyNs;
+        const double elapsedNs = std::chrono::duration<double, std::nano>(time - lastTime).count();
+        const double deltaNs = double(busyNs - lastBusyNs);
+        lastTime = time;
+        lastBusyNs = busyNs;
+
+        std::lock_guard<std::mutex> lock0(_registrationMutex);
+        const size_t numRunning = _threadPool.size();
+        if (numRunning == 0 or elapsedNs <= 0.0) continue;
+        const double utilization = deltaNs/(elapsedNs*numRunning);
+
+        //step the thread count by one when outside of the band
+        size_t numThreads = numRunning;
+        if (utilization > _args.utilizationHigh and numRunning < _args.maxThreads) numThreads++;
+        else if (utilization < _args.utilizationLow and numRunning > std::max<size_t>(_args.minThreads, 1)) numThreads--;
+        else continue;
+
+        _numPoolThreads = numThreads;
+        this->resizeThreadPool();
+    }
+}
+
+/*!
+ * Timer service mechanics:
+ * Blocks which have nothing to do until a known time, like paced
+ * sources and periodic probes, schedule a timer instead of yielding.
+ * The block is not processed again until the timer callback flags
+ * a change on its actor, or until another change arrives first.
+ * One timer thread per environment sleeps until the earliest pending
+ * time, so idle timed blocks do not cost the pool threads any CPU.
+ * The callbacks are made without the timer lock held.
+ */
+void ThreadEnvironment::scheduleTimer(const std::chrono::steady_clock::time_point &when, const std::function<void(void)> &callback)
+{
+    std::lock_guard<std::mutex> lock(_timerMutex);
+
+    //the timer thread is started on first use
+    if (not _timerThread.joinable())
+    {
+        _timerThread = std::thread(&ThreadEnvironment::timerLoop, this);
+    }
+
+    //only a new earliest time changes the timer thread's sleep
+    const auto it = _timers.emplace(when, callback);
+    if (it == _timers.begin()) _timerCond.notify_one();
+}
+
+void ThreadEnvironment::timerLoop(void)
+{
+    this->applyThreadConfig();
+
+    std::unique_lock<std::mutex> lock(_timerMutex);
+    while (not _timerDone)
+    {
+        if (_timers.empty())
+        {
+            _timerCond.wait(lock);
+            continue;
+        }
+
+        //sleep until the earliest time or until a new earliest time
+        const auto it = _timers.begin();
+        if (std::chrono::steady_clock::now() < it->first)
+        {
+            _timerCond.wait_until(lock, it->first);
+            continue;
+        }
+
+        //the timer is due, call it without holding the lock
+        const auto callback = std::move(it->second);
+        _timers.erase(it);
+        lock.unlock();
+        callback();
+        lock.lock();
+    }
+}
+
+HybridBackoff ThreadEnvironment::makeBackoff(void) const
+{
+    //only the hybrid mode spins and yields before waiting
+    if (_args.yieldMode != "HYBRID") return HybridBackoff(0, 0);
+
+    //spinning only delays the notifying thread on a single processor
+    if (Poco::Environment::processorCount() < 2) return HybridBackoff(0, _args.yieldBudgetNs);
+    return HybridBackoff(_args.spinBudgetNs, _args.yieldBudgetNs);
+}
 
 void ThreadEnvironment::poolProcessLoop(size_t index)
 {
     this->applyThreadConfig();
-    size_t failAcquireCount = 0;
-    size_t localSignature = 0;
-    std::map<void *, std::shared_ptr<TaskData>> localTasks;
-    auto it = localTasks.end();
+    size_t localSignature = ~_configurationSignature.load(); //forces the initial update
+    std::vector<std::shared_ptr<PlacementGroup>> localPlacements;
+    std::shared_ptr<TaskData> data;
+    auto backoff = this->makeBackoff();
 
     while (true)
     {
@@ -164,59 +640,72 @@ void ThreadEnvironment::poolProcessLoop(size_t index)
         if (_configurationSignature != localSignature)
         {
             std::lock_guard<std::mutex> lock(_handleUpdateMutex);
-            localTasks = _handleToTask;
-            it = localTasks.end();
             localSignature = _configurationSignature;
-            failAcquireCount = 0; //reset fail count
 
             //pool mode, index out of range
-            if (index >= localTasks.size()) return;
+            if (index >= std::min<size_t>(_numPoolThreads, _handleToTask.size())) return;
+
+            //pin to the first designated placement group or restore the pool affinity
+            auto placements = this->getPlacements(index);
+            const auto oldPlacement = localPlacements.empty()?nullptr:localPlacements.front();
+            const auto newPlacement = placements.empty()?nullptr:placements.front();
+            if (newPlacement and newPlacement != oldPlacement)
+            {
+                ThreadEnvironment::applyAffinity(newPlacement->affinityMode, newPlacement->affinity);
+            }
+            else if (oldPlacement and not newPlacement)
+            {
+                ThreadEnvironment::applyAffinity(_args.affinityMode, _args.affinity);
+            }
+            localPlacements = std::move(placements);
         }
 
-        //perform a task and increment
-        if (it == localTasks.end()) it = localTasks.begin();
-        if (not it->second->flag.test_and_set(std::memory_order_acquire))
+        //perform the next ready task
+        if (this->popReadyTask(index, localPlacements, data))
         {
-            const bool waitOnce = _waitModeEnabled and failAcquireCount >= localTasks.size();
-            if (it->second->task(waitOnce))
+            backoff.reset();
+            auto &stats = *_threadStats[index];
+            stats.epoch.fetch_add(1, std::memory_order_seq_cst); //odd: in a task
+            if (_elasticEnabled)
             {
-                //the task was successfully executed, wake all other potential blockers
-                if (_waitModeEnabled) wakeAllBusyTasks(localTasks, it->first);
-                failAcquireCount = 0; //reset fail count
+                //accumulate the busy time for the elastic monitor
+                const auto startTime = std::chrono::high_resolution_clock::now();
+                this->processReadyTask(std::move(data));
+                const auto busyTime = std::chrono::high_resolution_clock::now() - startTime;
+                stats.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(busyTime).count();
             }
-            else failAcquireCount++;
-            if (waitOnce) failAcquireCount = 0; //reset fail count
-            it->second->flag.clear(std::memory_order_release);
+            else this->processReadyTask(std::move(data));
+            data.reset();
+            stats.epoch.fetch_add(1, std::memory_order_release); //even: quiescent
         }
-        else failAcquireCount++;
-        it++;
+
+        //no tasks are ready, wait for a notification after the backoff
+        else if (_waitModeEnabled and backoff.idle()) this->waitReadyTask(localSignature, localPlacements);
     }
 }
 
-void ThreadEnvironment::singleProcessLoop(void *handle)
+void ThreadEnvironment::singleProcessLoop(std::shared_ptr<TaskData> data)
 {
     this->applyThreadConfig();
-    size_t localSignature = 0;
-    std::map<void *, std::shared_ptr<TaskData>> localTasks;
-    auto it = localTasks.end();
+    auto backoff = this->makeBackoff();
+    bool waitOnce = false;
 
-    while (true)
+    //pin this thread to the task's placement hint
+    const auto &placement = data->placement;
+    if (placement) ThreadEnvironment::applyAffinity(placement->affinityMode, placement->affinity);
+
+    //perform the task until unregistered, wait in the task after the backoff
+    while (data->registered.load(std::memory_order_acquire))
     {
-        //check for a configuration change and update the local state
-        if (_configurationSignature != localSignature)
+        if (data->task(_waitModeEnabled and waitOnce))
         {
-            std::lock_guard<std::mutex> lock(_handleUpdateMutex);
-            localTasks = _handleToTask;
-            it = localTasks.find(handle);
-            localSignature = _configurationSignature;
-
-            //handle mode, handle not in tasks
-            if (it == localTasks.end()) return;
+            backoff.reset();
+            waitOnce = false;
         }
-
-        //perform the task
-        it->second->task(_waitModeEnabled);
+        else waitOnce = backoff.idle();
     }
+
+    data->exited = true;
 }
 
 void ThreadEnvironment::applyThreadConfig(void)
@@ -232,10 +721,19 @@ void ThreadEnvironment::applyThreadConfig(void)
         }
     }
 
+    //set CPU or NUMA affinity
+    if (_args.affinityMode == "CPU" or _args.affinityMode == "NUMA")
+    {
+        ThreadEnvironment::applyAffinity(_args.affinityMode, _args.affinity);
+    }
+}
+
+void ThreadEnvironment::applyAffinity(const std::string &affinityMode, const std::vector<size_t> &affinity)
+{
     //set CPU affinity -- log message only on first failure
-    if (_args.affinityMode == "CPU")
+    if (affinityMode == "CPU")
     {
-        const auto errorMsg = ThreadEnvironment::setCPUAffinity(_args.affinity);
+        const auto errorMsg = ThreadEnvironment::setCPUAffinity(affinity);
         static bool showErrorMsg = true;
         if (not errorMsg.empty() and showErrorMsg)
         {
@@ -245,9 +743,9 @@ void ThreadEnvironment::applyThreadConfig(void)
     }
 
     //set NUMA affinity -- log message only on first failure
-    if (_args.affinityMode == "NUMA")
+    else if (affinityMode == "NUMA")
     {
-        const auto errorMsg = ThreadEnvironment::setNodeAffinity(_args.affinity);
+        const auto errorMsg = ThreadEnvironment::setNodeAffinity(affinity);
         static bool showErrorMsg = true;
         if (not errorMsg.empty() and showErrorMsg)
         {
@@ -255,4 +753,12 @@ void ThreadEnvironment::applyThreadConfig(void)
             poco_error_f1(Poco::Logger::get("Pothos.ThreadPool"), "Failed to set NUMA affinity %s", errorMsg);
         }
     }
+
+    //restore affinity to all available CPUs
+    else
+    {
+        std::vector<size_t> allCPUs(Poco::Environment::processorCount());
+        for (size_t i = 0; i < allCPUs.size(); i++) allCPUs[i] = i;
+        ThreadEnvironment::applyAffinity("CPU", allCPUs);
+    }
 }
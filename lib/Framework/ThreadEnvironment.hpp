@@ -1,36 +1,189 @@
-// Copyright (c) 2015-2015 Josh Blum
+// Copyright (c) 2015-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include <Pothos/Config.hpp>
 #include <Pothos/Framework/ThreadPool.hpp>
+#include <Pothos/Util/SpinLock.hpp>
+#include "Framework/HybridBackoff.hpp"
 #include <memory>
+#include <chrono>
 #include <mutex>
+#include <condition_variable>
 #include <functional>
 #include <atomic>
 #include <thread>
 #include <vector>
+#include <deque>
 #include <map>
+#include <unordered_map>
+
+class ThreadEnvironment;
+struct TaskData;
+
+/*!
+ * A queue of ready tasks used in thread pool mode.
+ * The owner thread pops tasks from the front,
+ * idle threads steal tasks from the back.
+ */
+struct ReadyQueue
+{
+    Pothos::Util::SpinLock lock;
+    std::deque<std::shared_ptr<TaskData>> tasks;
+};
+
+/*!
+ * Per-thread state of a pool thread.
+ * The epoch is odd while the thread processes a task,
+ * and is used to wait for threads after unregistration.
+ * In elastic mode, each pool thread accumulates the time
+ * spent in tasks, the elastic monitor samples the totals.
+ */
+struct PoolThreadStats
+{
+    PoolThreadStats(void):
+        epoch(0),
+        busyNs(0)
+    {
+        return;
+    }
+
+    std::atomic<size_t> epoch;
+    std::atomic<unsigned long long> busyNs;
+};
+
+/*!
+ * A ready queue shared by the tasks with the same placement hint.
+ * In pool mode, the tasks in a placement group are only processed
+ * by the pool thread which is designated to the placement group.
+ * A shared group of a NUMA node is designated to every pool thread
+ * on the node, so that these threads share and steal its tasks.
+ */
+struct PlacementGroup
+{
+    PlacementGroup(const std::string &affinityMode, const std::vector<size_t> &affinity, const bool shared = false):
+        affinityMode(affinityMode),
+        affinity(affinity),
+        shared(shared),
+        numReadyTasks(0),
+        numTasks(0)
+    {
+        return;
+    }
+
+    //! the affinity mode and list (same conventions as ThreadPoolArgs)
+    const std::string affinityMode;
+    const std::vector<size_t> affinity;
+
+    //! the group of a NUMA node from automatic placement
+    const bool shared;
+
+    //! the ready tasks in this placement group
+    ReadyQueue queue;
+
+    //! the number of tasks in the ready queue
+    std::atomic<size_t> numReadyTasks;
+
+    //! the number of registered tasks in this group
+    size_t numTasks;
+};
 
 /*!
- * Storage container for a worker task and an atomic flag.
- * The flag is used for exclusive access in pool mode.
+ * Per-task configuration given at registration.
+ * See Block::setThreadAffinity() and Block::setSchedulingClass().
  */
-struct TaskData
+struct TaskHints
+{
+    TaskHints(void):
+        nodeAffinity(-1),
+        deadlineNs(0)
+    {
+        return;
+    }
+
+    //! the placement hint mode or empty for none
+    std::string affinityMode;
+
+    //! the list of CPUs or NUMA nodes for the placement hint
+    std::vector<size_t> affinity;
+
+    //! the NUMA node from automatic placement or -1 for none
+    long nodeAffinity;
+
+    //! the scheduling class or empty for normal
+    std::string schedulingClass;
+
+    //! the relative deadline for the deadline class
+    long long deadlineNs;
+
+    //! called when the task was dispatched after its deadline
+    std::function<void(void)> deadlineMissed;
+
+    //! called when the task was stolen from the queue of another thread
+    std::function<void(void)> taskStolen;
+};
+
+/*!
+ * Storage container for a worker task and its ready state.
+ * The queued flag is used for exclusive access in pool mode.
+ */
+struct TaskData : std::enable_shared_from_this<TaskData>
 {
     typedef std::function<bool(bool)> Task;
     typedef std::function<void(void)> Wake;
 
-    TaskData(const Task task, const Wake wake):
+    TaskData(const Task task, const Wake wake, ThreadEnvironment *environment, const size_t queueIndex,
+        const std::shared_ptr<PlacementGroup> &placement, const TaskHints &hints):
         task(task),
-        wake(wake)
+        wake(wake),
+        environment(environment),
+        queueIndex(queueIndex),
+        placement(placement),
+        urgent(hints.schedulingClass == "HIGH" or hints.schedulingClass == "DEADLINE"),
+        deadline(hints.schedulingClass == "DEADLINE"?hints.deadlineNs:0),
+        deadlineMissed(hints.deadlineMissed),
+        taskStolen(hints.taskStolen),
+        registered(true),
+        exited(false)
     {
-        flag.clear(std::memory_order_release);
+        queued.clear(std::memory_order_release);
     }
 
     Task task;
     Wake wake;
-    std::atomic_flag flag;
+
+    //! the thread environment which owns this task
+    ThreadEnvironment *environment;
+
+    //! the index of the ready queue for this task
+    const size_t queueIndex;
+
+    //! the placement group or null when the task has no hint
+    const std::shared_ptr<PlacementGroup> placement;
+
+    //! served before normal tasks (high priority and deadline classes)
+    const bool urgent;
+
+    //! the relative deadline or zero when the task has no deadline
+    const std::chrono::nanoseconds deadline;
+
+    //! the absolute deadline, set when queued (protected by the queue lock)
+    std::chrono::high_resolution_clock::time_point absoluteDeadline;
+
+    //! called when the task was dispatched after its deadline
+    std::function<void(void)> deadlineMissed;
+
+    //! called when the task was stolen from the queue of another thread
+    std::function<void(void)> taskStolen;
+
+    //! set while in a ready queue or being processed
+    std::atomic_flag queued;
+
+    //! cleared when the task is unregistered
+    std::atomic<bool> registered;
+
+    //! set when the thread of the task exits (thread-per-block mode)
+    std::atomic<bool> exited;
 };
 
 /*!
@@ -49,8 +202,10 @@ public:
      * \param handle a unique handle representing the caller
      * \param task a function pointer to the handle worker task
      * \param wake a function pointer to wake a worker task
+     * \param hints the placement and scheduling class hints
+     * \return the task data for ready notifications in pool mode or null
      */
-    void registerTask(void *handle, TaskData::Task task, TaskData::Wake wake);
+    TaskData *registerTask(void *handle, TaskData::Task task, TaskData::Wake wake, const TaskHints &hints = TaskHints());
 
     /*!
      * Unregister the task from the thread environment.
@@ -58,20 +213,61 @@ public:
      */
     void unregisterTask(void *handle);
 
+    /*!
+     * Notify the thread environment that the task has a change.
+     * The task will be queued for processing by the pool threads
+     * unless the task is already queued or being processed.
+     * \param task the task data returned by registerTask()
+     */
+    void notifyReady(TaskData *task);
+
     //! Query the thread pool construction args
     const Pothos::ThreadPoolArgs &getArgs(void) const
     {
         return _args;
     }
 
+    /*!
+     * Schedule a callback with the timer service of this environment.
+     * The callback is made from the timer thread at the given time.
+     * Pending callbacks are discarded when the environment is destroyed.
+     * \param when the time on the steady clock for the callback
+     * \param callback the function to call when the time arrives
+     */
+    void scheduleTimer(const std::chrono::steady_clock::time_point &when, const std::function<void(void)> &callback);
+
+    /*!
+     * Register a file descriptor with the readiness service.
+     * The callback is made from the readiness thread once when the
+     * descriptor is ready, and then the descriptor is disarmed until
+     * rearmDescriptor() is called after the owner has serviced it.
+     * Registering a registered descriptor replaces its interest.
+     * \param fd the file descriptor to monitor
+     * \param read true to monitor for readable data
+     * \param write true to monitor for writable space
+     * \param callback the function to call when the descriptor is ready
+     * \throws ThreadPoolError when the descriptor cannot be monitored
+     */
+    void registerDescriptor(const int fd, const bool read, const bool write, const std::function<void(void)> &callback);
+
+    //! Monitor the descriptor again after its callback was made
+    void rearmDescriptor(const int fd);
+
+    //! Unregister a file descriptor from the readiness service
+    void unregisterDescriptor(const int fd);
+
     /*!
      * Is waiting allowed within an task?
+     * Pool threads wait on the ready queue instead.
      */
     bool isWaitingEnabled(void) const
     {
-        return _waitModeEnabled;
+        return _args.yieldMode != "SPIN" and _args.numThreads == 0;
     }
 
+    //! Get the size of a virtual memory page
+    static size_t getPageSize(void);
+
 private:
     /*!
      * Process loop used in thread pool mode:
@@ -83,9 +279,76 @@ private:
 
     /*!
      * Process loop used in thread per task mode.
-     * If the handle is removed, the thread exists.
+     * If the task is unregistered, the thread exits.
+     */
+    void singleProcessLoop(std::shared_ptr<TaskData> data);
+
+    /*!
+     * Wait for the pool threads which were processing a task
+     * when this call was made to complete the task.
+     * See the task table reclamation mechanics.
+     */
+    void waitQuiescentThreads(void);
+
+    /*!
+     * Pop a task from the ready queues:
+     * The thread's own queue is checked first,
+     * followed by stealing from the other queues.
+     * The thread's placement groups and the urgent queue
+     * are checked before the thread's own queue.
+     * \param index the index of the calling thread
+     * \param placements the groups designated to this thread
+     * \param [out] data the ready task
+     * \return true when a task was popped
+     */
+    bool popReadyTask(const size_t index, const std::vector<std::shared_ptr<PlacementGroup>> &placements, std::shared_ptr<TaskData> &data);
+
+    //! Push a task into its ready queue and wake a waiting thread
+    void pushReadyTask(std::shared_ptr<TaskData> &&data);
+
+    //! Process a task which was popped from the ready queues
+    void processReadyTask(std::shared_ptr<TaskData> &&data);
+
+    //! Wait for a ready task or a configuration change
+    void waitReadyTask(const size_t localSignature, const std::vector<std::shared_ptr<PlacementGroup>> &placements);
+
+    //! Get the placement groups designated to the pool thread at index
+    std::vector<std::shared_ptr<PlacementGroup>> getPlacements(const size_t index) const;
+
+    /*!
+     * Start or stop pool threads to match the current thread count:
+     * The smaller of the elastic thread count and the number of tasks.
+     * The caller must hold the registration mutex.
+     */
+    void resizeThreadPool(void);
+
+    /*!
+     * Monitor loop used in elastic mode:
+     * Sample the busy time of the pool threads every period,
+     * and add or retire a thread when the utilization
+     * leaves the target band given by the thread pool args.
+     */
+    void elasticMonitorLoop(void);
+
+    /*!
+     * Timer loop for the timer service:
+     * Sleep until the earliest pending time,
+     * and call the callbacks which are due.
      */
-    void singleProcessLoop(void *handle);
+    void timerLoop(void);
+
+    /*!
+     * Readiness loop for the readiness service:
+     * Wait on the descriptors which are armed,
+     * and call the callbacks of the ready descriptors.
+     */
+    void descriptorLoop(void);
+
+    //! Stop the readiness thread and release its resources
+    void stopDescriptorService(void);
+
+    //! Make the idle backoff state for a thread based on the yield mode
+    HybridBackoff makeBackoff(void) const;
 
     /*!
      * Apply priority and affinity to the caller.
@@ -93,6 +356,9 @@ private:
      */
     void applyThreadConfig(void);
 
+    //! Apply an affinity mode and list to the caller
+    static void applyAffinity(const std::string &affinityMode, const std::vector<size_t> &affinity);
+
     //! Set thread prio - return error message
     static std::string setPriority(const double prio);
 
@@ -102,16 +368,50 @@ private:
     //! Set NUMA affinity - return error message
     static std::string setNodeAffinity(const std::vector<size_t> &affinity);
 
+    //! Lock or unlock current and future process memory - return error message
+    static std::string lockMemory(const bool lock);
+
     //the thread pool configuration arguments
     Pothos::ThreadPoolArgs _args;
 
     //whether or not waiting is allowed based on args
     bool _waitModeEnabled;
 
+    //this pool holds a reference on the process memory lock
+    bool _memoryLocked;
+
+    //ready queues (one shared queue, or one per thread when stealing)
+    std::vector<std::unique_ptr<ReadyQueue>> _readyQueues;
+
+    //total number of tasks in the ready queues
+    std::atomic<size_t> _numReadyTasks;
+
+    //ready queue for urgent tasks, ordered by deadline
+    ReadyQueue _urgentQueue;
+
+    //number of tasks in the urgent ready queue
+    std::atomic<size_t> _numUrgentTasks;
+
+    //number of pool threads waiting on the ready condition
+    std::atomic<size_t> _numWaitingThreads;
+
+    //mutex and condition for waiting on the ready queues
+    std::mutex _readyMutex;
+    std::condition_variable _readyCond;
+
+    //counter used to assign the ready queue to new tasks
+    size_t _numRegistrations;
+
+    //placement groups for tasks with a hint (used in thread pool mode)
+    std::map<std::pair<std::string, std::vector<size_t>>, std::shared_ptr<PlacementGroup>> _placements;
+
+    //shared placement groups per NUMA node from automatic placement
+    std::map<long, std::shared_ptr<PlacementGroup>> _nodePlacements;
+
     //map of handle handles to tasks
-    std::map<void *, std::shared_ptr<TaskData>> _handleToTask;
+    std::unordered_map<void *, std::shared_ptr<TaskData>> _handleToTask;
 
-    //configuration signature (changed when handle list changed)
+    //configuration signature (changed when the pool threads or placement groups changed)
     std::atomic<size_t> _configurationSignature;
 
     //mutex for protecting handle registration
@@ -121,8 +421,38 @@ private:
     std::mutex _handleUpdateMutex;
 
     //handle to thread map (used in handle per thread mode)
-    std::map<void *, std::thread> _handleToThread;
+    std::unordered_map<void *, std::thread> _handleToThread;
 
     //per-thread process loop done flags (used in thread pool mode)
     std::vector<std::thread> _threadPool;
+
+    //the number of pool threads to run when there are enough tasks
+    std::atomic<size_t> _numPoolThreads;
+
+    //per-thread stats (pool mode) and the elastic monitor thread
+    bool _elasticEnabled;
+    std::vector<std::unique_ptr<PoolThreadStats>> _threadStats;
+    bool _elasticDone;
+    std::mutex _elasticMutex;
+    std::condition_variable _elasticCond;
+    std::thread _elasticMonitor;
+
+    //pending timer callbacks ordered by time and the timer thread
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void(void)>> _timers;
+    bool _timerDone;
+    std::mutex _timerMutex;
+    std::condition_variable _timerCond;
+    std::thread _timerThread;
+
+    //registered file descriptors, the readiness instance and its thread
+    struct DescriptorEntry
+    {
+        unsigned events;
+        std::function<void(void)> callback;
+    };
+    std::map<int, DescriptorEntry> _descriptors;
+    int _epollFd;
+    int _epollWakeFd;
+    std::mutex _descriptorMutex;
+    std::thread _descriptorThread;
 };
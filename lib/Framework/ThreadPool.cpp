@@ -10,21 +10,48 @@
 
 Pothos::ThreadPoolArgs::ThreadPoolArgs(void):
     numThreads(0),
-    priority(0.0)
+    priority(0.0),
+    spinBudgetNs(10000),
+    yieldBudgetNs(100000),
+    workQuantum(1),
+    workQuantumNs(0),
+    minThreads(0),
+    maxThreads(0),
+    utilizationLow(0.3),
+    utilizationHigh(0.8),
+    elasticPeriodNs(100000000)
 {
     return;
 }
 
 Pothos::ThreadPoolArgs::ThreadPoolArgs(const size_t numThreads):
     numThreads(numThreads),
-    priority(0.0)
+    priority(0.0),
+    spinBudgetNs(10000),
+    yieldBudgetNs(100000),
+    workQuantum(1),
+    workQuantumNs(0),
+    minThreads(0),
+    maxThreads(0),
+    utilizationLow(0.3),
+    utilizationHigh(0.8),
+    elasticPeriodNs(100000000)
 {
     return;
 }
 
 Pothos::ThreadPoolArgs::ThreadPoolArgs(const std::string &json):
     numThreads(0),
-    priority(0.0)
+    priority(0.0),
+    spinBudgetNs(10000),
+    yieldBudgetNs(100000),
+    workQuantum(1),
+    workQuantumNs(0),
+    minThreads(0),
+    maxThreads(0),
+    utilizationLow(0.3),
+    utilizationHigh(0.8),
+    elasticPeriodNs(100000000)
 {
     //parse to JSON object
     const auto result = Poco::JSON::Parser().parse(json);
@@ -35,6 +62,17 @@ Pothos::ThreadPoolArgs::ThreadPoolArgs(const std::string &json):
     this->priority = topObj->optValue<double>("priority", 0.0);
     this->affinityMode = topObj->optValue<std::string>("affinityMode", "");
     this->yieldMode = topObj->optValue<std::string>("yieldMode", "");
+    this->spinBudgetNs = topObj->optValue<Poco::Int64>("spinBudgetNs", this->spinBudgetNs);
+    this->yieldBudgetNs = topObj->optValue<Poco::Int64>("yieldBudgetNs", this->yieldBudgetNs);
+    this->schedulerMode = topObj->optValue<std::string>("schedulerMode", "");
+    this->workQuantum = topObj->optValue<int>("workQuantum", 1);
+    this->workQuantumNs = topObj->optValue<Poco::Int64>("workQuantumNs", this->workQuantumNs);
+    this->minThreads = topObj->optValue<int>("minThreads", 0);
+    this->maxThreads = topObj->optValue<int>("maxThreads", 0);
+    this->utilizationLow = topObj->optValue<double>("utilizationLow", this->utilizationLow);
+    this->utilizationHigh = topObj->optValue<double>("utilizationHigh", this->utilizationHigh);
+    this->elasticPeriodNs = topObj->optValue<Poco::Int64>("elasticPeriodNs", this->elasticPeriodNs);
+    this->profile = topObj->optValue<std::string>("profile", "");
 
     //parse out the affinity list
     Poco::JSON::Array::Ptr affinityArray;
@@ -72,6 +110,41 @@ Pothos::ThreadPool::ThreadPool(const ThreadPoolArgs &args)
     else if (args.yieldMode == "SPIN"){}
     else throw ThreadPoolError("Pothos::ThreadPool()", "unknown yieldMode " + args.yieldMode);
 
+    //validate the hybrid yield budgets
+    if (args.spinBudgetNs < 0 or args.yieldBudgetNs < 0)
+    {
+        throw ThreadPoolError("Pothos::ThreadPool()", "negative spin or yield budget");
+    }
+
+    //validate the scheduler strategy
+    if (args.schedulerMode.empty()){}
+    else if (args.schedulerMode == "ROUND_ROBIN"){}
+    else if (args.schedulerMode == "STEALING"){}
+    else throw ThreadPoolError("Pothos::ThreadPool()", "unknown schedulerMode " + args.schedulerMode);
+
+    //validate the work quantum
+    if (args.workQuantum == 0 or args.workQuantumNs < 0)
+    {
+        throw ThreadPoolError("Pothos::ThreadPool()", "work quantum must be positive");
+    }
+
+    //validate the elastic mode settings
+    if (args.maxThreads != 0)
+    {
+        if (args.numThreads == 0) throw ThreadPoolError("Pothos::ThreadPool()", "elastic mode requires numThreads in pool mode");
+        if (args.minThreads > args.maxThreads) throw ThreadPoolError("Pothos::ThreadPool()", "minThreads exceeds maxThreads");
+        if (args.utilizationLow < 0.0 or args.utilizationHigh > 1.0 or args.utilizationLow >= args.utilizationHigh)
+        {
+            throw ThreadPoolError("Pothos::ThreadPool()", "utilization band out of range");
+        }
+        if (args.elasticPeriodNs <= 0) throw ThreadPoolError("Pothos::ThreadPool()", "elastic period must be positive");
+    }
+
+    //validate the execution profile
+    if (args.profile.empty()){}
+    else if (args.profile == "REALTIME"){}
+    else throw ThreadPoolError("Pothos::ThreadPool()", "unknown profile " + args.profile);
+
     //validate the thread priority
     if (args.priority > +1.0 or args.priority < -1.0)
     {
@@ -108,6 +181,17 @@ static auto managedThreadPoolArgs = Pothos::ManagedClass()
     .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, affinityMode))
     .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, affinity))
     .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, yieldMode))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, spinBudgetNs))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, yieldBudgetNs))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, schedulerMode))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, workQuantum))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, workQuantumNs))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, minThreads))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, maxThreads))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, utilizationLow))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, utilizationHigh))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, elasticPeriodNs))
+    .registerField(POTHOS_FCN_TUPLE(Pothos::ThreadPoolArgs, profile))
     .commit("Pothos/ThreadPoolArgs");
 
 static auto managedThreadPool = Pothos::ManagedClass()
@@ -129,6 +213,17 @@ void serialize(Archive &ar, Pothos::ThreadPoolArgs &t, const unsigned int)
     ar & t.affinityMode;
     ar & t.affinity;
     ar & t.yieldMode;
+    ar & t.spinBudgetNs;
+    ar & t.yieldBudgetNs;
+    ar & t.schedulerMode;
+    ar & t.workQuantum;
+    ar & t.workQuantumNs;
+    ar & t.minThreads;
+    ar & t.maxThreads;
+    ar & t.utilizationLow;
+    ar & t.utilizationHigh;
+    ar & t.elasticPeriodNs;
+    ar & t.profile;
 }
 }}
 
@@ -0,0 +1,148 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/ThreadEnvironment.hpp"
+#include <Pothos/Framework/Exception.hpp>
+#include <Poco/Logger.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cerrno> //errno
+#include <cstring> //strerror
+
+/***********************************************************************
+ * Readiness service mechanics:
+ * Blocks which wrap sockets, pipes, or character devices register
+ * their descriptors rather than polling or blocking in work().
+ * One epoll instance per thread pool monitors every descriptor,
+ * and one readiness thread waits on it and flags the ready blocks.
+ *
+ * The descriptors are registered in one-shot mode, a ready descriptor
+ * is disarmed until its block calls work() and rearms the descriptor.
+ * This gives level-triggered semantics for the block without the
+ * readiness thread spinning on a descriptor that remains ready.
+ **********************************************************************/
+static unsigned descriptorEvents(const bool read, const bool write)
+{
+    unsigned events = EPOLLONESHOT;
+    if (read) events |= EPOLLIN;
+    if (write) events |= EPOLLOUT;
+    return events;
+}
+
+void ThreadEnvironment::registerDescriptor(const int fd, const bool read, const bool write, const std::function<void(void)> &callback)
+{
+    std::lock_guard<std::mutex> lock(_descriptorMutex);
+
+    //the epoll instance and the readiness thread are created on first use
+    if (_epollFd == -1)
+    {
+        _epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFd == -1) throw Pothos::ThreadPoolError("ThreadEnvironment::registerDescriptor()", std::strerror(errno));
+
+        //the wake descriptor stops the readiness thread
+        _epollWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = _epollWakeFd;
+        if (_epollWakeFd == -1 or epoll_ctl(_epollFd, EPOLL_CTL_ADD, _epollWakeFd, &ev) != 0)
+        {
+            const std::string errorMsg(std::strerror(errno));
+            if (_epollWakeFd != -1) close(_epollWakeFd);
+            close(_epollFd);
+            _epollWakeFd = -1;
+            _epollFd = -1;
+            throw Pothos::ThreadPoolError("ThreadEnvironment::registerDescriptor()", errorMsg);
+        }
+
+        _descriptorThread = std::thread(&ThreadEnvironment::descriptorLoop, this);
+    }
+
+    //add the descriptor or modify the interest of a registered descriptor
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = descriptorEvents(read, write);
+    ev.data.fd = fd;
+    const bool registered = _descriptors.count(fd) != 0;
+    if (epoll_ctl(_epollFd, registered?EPOLL_CTL_MOD:EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        throw Pothos::ThreadPoolError("ThreadEnvironment::registerDescriptor()", std::strerror(errno));
+    }
+
+    auto &entry = _descriptors[fd];
+    entry.events = ev.events;
+    entry.callback = callback;
+}
+
+void ThreadEnvironment::rearmDescriptor(const int fd)
+{
+    std::lock_guard<std::mutex> lock(_descriptorMutex);
+    auto it = _descriptors.find(fd);
+    if (it == _descriptors.end()) return;
+
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = it->second.events;
+    ev.data.fd = fd;
+    epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void ThreadEnvironment::unregisterDescriptor(const int fd)
+{
+    std::lock_guard<std::mutex> lock(_descriptorMutex);
+    auto it = _descriptors.find(fd);
+    if (it == _descriptors.end()) return;
+
+    //the descriptor may be closed already, which removed it from epoll
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    _descriptors.erase(it);
+}
+
+void ThreadEnvironment::descriptorLoop(void)
+{
+    this->applyThreadConfig();
+
+    std::vector<struct epoll_event> events(64);
+    while (true)
+    {
+        const int ret = epoll_wait(_epollFd, events.data(), int(events.size()), -1);
+        if (ret < 0 and errno == EINTR) continue;
+        if (ret < 0)
+        {
+            poco_error_f1(Poco::Logger::get("Pothos.ThreadPool"), "epoll_wait() failed %s", std::string(std::strerror(errno)));
+            return;
+        }
+
+        for (int i = 0; i < ret; i++)
+        {
+            const int fd = events[i].data.fd;
+            if (fd == _epollWakeFd) return;
+
+            //the callback is made without holding the lock
+            std::function<void(void)> callback;
+            {
+                std::lock_guard<std::mutex> lock(_descriptorMutex);
+                auto it = _descriptors.find(fd);
+                if (it != _descriptors.end()) callback = it->second.callback;
+            }
+            if (callback) callback();
+        }
+    }
+}
+
+void ThreadEnvironment::stopDescriptorService(void)
+{
+    if (not _descriptorThread.joinable()) return;
+
+    const uint64_t one(1);
+    if (write(_epollWakeFd, &one, sizeof(one)) != sizeof(one)) {/*the thread still exits on the readable wake descriptor*/}
+    _descriptorThread.join();
+
+    close(_epollWakeFd);
+    close(_epollFd);
+    _epollWakeFd = -1;
+    _epollFd = -1;
+    _descriptors.clear();
+}
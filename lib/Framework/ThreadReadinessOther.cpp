@@ -0,0 +1,33 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/ThreadEnvironment.hpp"
+#include <Pothos/Framework/Exception.hpp>
+
+/***********************************************************************
+ * The readiness service is only implemented with epoll on Linux.
+ **********************************************************************/
+void ThreadEnvironment::registerDescriptor(const int, const bool, const bool, const std::function<void(void)> &)
+{
+    throw Pothos::ThreadPoolError("ThreadEnvironment::registerDescriptor()", "not supported on this platform");
+}
+
+void ThreadEnvironment::rearmDescriptor(const int)
+{
+    return;
+}
+
+void ThreadEnvironment::unregisterDescriptor(const int)
+{
+    return;
+}
+
+void ThreadEnvironment::descriptorLoop(void)
+{
+    return;
+}
+
+void ThreadEnvironment::stopDescriptorService(void)
+{
+    return;
+}
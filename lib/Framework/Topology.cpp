@@ -71,6 +71,50 @@ const Pothos::ThreadPool &Pothos::Topology::getThreadPool(void) const
     return _impl->threadPool;
 }
 
+void Pothos::Topology::setAutoPlacement(const bool enable)
+{
+    _impl->autoPlacement = enable;
+}
+
+bool Pothos::Topology::getAutoPlacement(void) const
+{
+    return _impl->autoPlacement;
+}
+
+void Pothos::Topology::setAutoFusion(const bool enable)
+{
+    _impl->autoFusion = enable;
+}
+
+bool Pothos::Topology::getAutoFusion(void) const
+{
+    return _impl->autoFusion;
+}
+
+void Pothos::Topology::setReplication(const Object &block, const size_t numReplicas, const size_t frameSize)
+{
+    if (numReplicas == 0) throw Pothos::RangeException("Pothos::Topology::setReplication()", "numReplicas must be at least 1");
+    const auto uid = getProxy(block).call<std::string>("uid");
+    if (numReplicas == 1) _impl->replications.erase(uid);
+    else
+    {
+        //the replicas are made again when the settings change
+        auto &replication = _impl->replications[uid];
+        if (replication.numReplicas == numReplicas and replication.frameSize == frameSize) return;
+        replication = Impl::Replication();
+        replication.numReplicas = numReplicas;
+        replication.frameSize = frameSize;
+    }
+}
+
+size_t Pothos::Topology::getReplication(const Object &block) const
+{
+    const auto uid = getProxy(block).call<std::string>("uid");
+    auto it = _impl->replications.find(uid);
+    if (it == _impl->replications.end()) return 1;
+    return it->second.numReplicas;
+}
+
 std::vector<Pothos::PortInfo> Pothos::Topology::inputPortInfo(void)
 {
     std::vector<PortInfo> infos;
@@ -330,6 +374,13 @@ static auto managedTopology = Pothos::ManagedClass()
     .registerMethod("resolveFlows", &resolveFlowsFromTopology)
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setThreadPool))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, getThreadPool))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setAutoPlacement))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, getAutoPlacement))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setAutoFusion))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, getAutoFusion))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, setReplication))
+    .registerMethod("setReplication", Pothos::Callable(&Pothos::Topology::setReplication).bind(size_t(0), 3))
+    .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, getReplication))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, commit))
     .registerMethod(POTHOS_FCN_TUPLE(Pothos::Topology, disconnectAll))
     .registerMethod("disconnectAll", Pothos::Callable(&Pothos::Topology::disconnectAll).bind(false, 1))
@@ -275,12 +275,18 @@ void Pothos::Topology::commit(void)
     //1) complete the pass-through flows
     auto completeFlows = completePassThroughFlows(squashedFlows);
 
+    //replace the replicated blocks with splitter, replicas, and merger
+    if (not _impl->replications.empty()) completeFlows = _impl->replicateFlows(completeFlows);
+
     //2) create network iogress blocks when needed
     auto flatFlows = _impl->createNetworkFlows(completeFlows);
 
     //3) deal with domain crossing
     flatFlows = _impl->rectifyDomainFlows(flatFlows);
 
+    //4) assign NUMA nodes before buffers are allocated
+    if (_impl->autoPlacement or not _impl->autoPlacedBlocks.empty()) _impl->autoPlaceBlocks(flatFlows);
+
     //create remote topologies for all environments
     for (const auto &obj : getObjSetFromFlowList(flatFlows))
     {
@@ -328,6 +334,10 @@ void Pothos::Topology::commit(void)
         block.call<Block *>("getPointer")->setThreadPool(this->getThreadPool());
     }
 
+    //5) fuse linear chains once the thread pools are set
+    //the previous chains are undone when fusion was disabled
+    if (_impl->autoFusion or not _impl->fusedChains.empty()) _impl->autoFuseChains(flatFlows);
+
     _impl->activeFlatFlows = flatFlows;
 
     //Remove disconnections from the cache if present
@@ -0,0 +1,143 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/WorkerActor.hpp"
+#include <Pothos/Framework/Block.hpp>
+#include <Pothos/Framework/InputPort.hpp>
+#include <Pothos/Framework/OutputPort.hpp>
+#include <algorithm>
+#include <set>
+
+/***********************************************************************
+ * Automatic fusion of linear block chains:
+ *
+ * Neighboring blocks in a chain usually run on different threads,
+ * so each buffer handoff crosses cores and misses in the cache.
+ * A fused chain is processed by the task of the chain's head block,
+ * which calls each block in order on the same thread, so that the
+ * next block consumes the buffers while they are still in the cache.
+ *
+ * An edge can be fused when the source block has exactly one output
+ * connection, the destination block has exactly one input connection,
+ * the ports are in the same domain, and both blocks are local and share
+ * the same thread pool, placement hint, and scheduling class.
+ * The other blocks of the chain are unregistered from the thread pool
+ * and forward their external changes to the head of the chain.
+ **********************************************************************/
+static bool canFuseBlocks(Pothos::Block *src, Pothos::Block *dst)
+{
+    return src->getThreadPool() == dst->getThreadPool() and
+        src->getThreadAffinityMode() == dst->getThreadAffinityMode() and
+        src->getThreadAffinity() == dst->getThreadAffinity() and
+        src->getSchedulingClass() == dst->getSchedulingClass();
+}
+
+static void setFusedChain(const std::vector<Pothos::Block *> &chain, const bool fuse)
+{
+    //unregister the blocks while the chain changes
+    std::vector<Pothos::ThreadPool> threadPools;
+    for (auto block : chain)
+    {
+        threadPools.push_back(block->getThreadPool());
+        block->setThreadPool(Pothos::ThreadPool());
+    }
+
+    //the head processes the other actors of a fused chain
+    auto head = chain.front()->_actor.get();
+    head->fusedActors.clear();
+    for (size_t i = 1; i < chain.size(); i++)
+    {
+        auto actor = chain[i]->_actor.get();
+        if (fuse) head->fusedActors.push_back(actor);
+        actor->setFusedHead(fuse?head:nullptr);
+    }
+
+    //register again, only the head of a fused chain gets a task
+    for (size_t i = 0; i < chain.size(); i++)
+    {
+        chain[i]->setThreadPool(threadPools[i]);
+    }
+}
+
+static std::vector<Pothos::Block *> getChainPointers(const std::vector<Pothos::Proxy> &chain)
+{
+    std::vector<Pothos::Block *> blocks;
+    for (const auto &block : chain) blocks.push_back(block.call<Pothos::Block *>("getPointer"));
+    return blocks;
+}
+
+static std::vector<std::string> getChainUids(const std::vector<Pothos::Proxy> &chain)
+{
+    std::vector<std::string> uids;
+    for (const auto &block : chain) uids.push_back(block.call<std::string>("uid"));
+    return uids;
+}
+
+void Pothos::Topology::Impl::autoFuseChains(const std::vector<Flow> &flatFlows)
+{
+    //collect the local blocks and count the connections of each block
+    std::map<std::string, Pothos::Proxy> blocks;
+    std::map<std::string, size_t> numInputFlows, numOutputFlows;
+    for (const auto &block : getObjSetFromFlowList(flatFlows))
+    {
+        if (block.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid()) continue;
+        blocks[block.call<std::string>("uid")] = block;
+    }
+    for (const auto &flow : flatFlows)
+    {
+        numOutputFlows[flow.src.uid]++;
+        numInputFlows[flow.dst.uid]++;
+    }
+
+    //find the edges which can be fused
+    std::map<std::string, std::string> next;
+    std::set<std::string> hasPrev;
+    if (this->autoFusion) for (const auto &flow : flatFlows)
+    {
+        if (flow.src.uid == flow.dst.uid) continue;
+        if (numOutputFlows[flow.src.uid] != 1 or numInputFlows[flow.dst.uid] != 1) continue;
+        if (blocks.count(flow.src.uid) == 0 or blocks.count(flow.dst.uid) == 0) continue;
+        auto src = blocks[flow.src.uid].call<Block *>("getPointer");
+        auto dst = blocks[flow.dst.uid].call<Block *>("getPointer");
+        if (src->output(flow.src.name)->domain() != dst->input(flow.dst.name)->domain()) continue;
+        if (not canFuseBlocks(src, dst)) continue;
+        next[flow.src.uid] = flow.dst.uid;
+        hasPrev.insert(flow.dst.uid);
+    }
+
+    //follow each chain from its head (closed loops have no head)
+    std::vector<std::vector<Pothos::Proxy>> newChains;
+    std::set<std::vector<std::string>> newChainUids;
+    for (const auto &pair : next)
+    {
+        if (hasPrev.count(pair.first) != 0) continue;
+        std::vector<Pothos::Proxy> chain;
+        std::vector<std::string> uids;
+        for (auto uid = pair.first; not uid.empty(); uid = next.count(uid)?next[uid]:"")
+        {
+            chain.push_back(blocks[uid]);
+            uids.push_back(uid);
+        }
+        newChains.push_back(chain);
+        newChainUids.insert(uids);
+    }
+
+    //undo the previous chains which are no longer fused as before
+    std::set<std::vector<std::string>> oldChainUids;
+    for (const auto &chain : this->fusedChains)
+    {
+        const auto uids = getChainUids(chain);
+        if (newChainUids.count(uids) != 0) oldChainUids.insert(uids);
+        else setFusedChain(getChainPointers(chain), false);
+    }
+
+    //fuse the new chains
+    for (const auto &chain : newChains)
+    {
+        if (oldChainUids.count(getChainUids(chain)) != 0) continue;
+        setFusedChain(getChainPointers(chain), true);
+    }
+
+    this->fusedChains = newChains;
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2014-2015 Josh Blum
+// Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
@@ -6,6 +6,7 @@
 #include "Framework/PortsAndFlows.hpp"
 #include <unordered_map>
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -20,20 +21,50 @@ static inline Port envTagPort(const Port &port, const Port &other)
     return envTagged;
 }
 
+/*!
+ * Create a shared memory sink and source for a flow between
+ * two processes on the same host (see TopologyShmFlows.cpp).
+ * \return the pair of the source and the sink blocks
+ */
+std::pair<Pothos::Proxy, Pothos::Proxy> createShmFlow(const Flow &flow);
+
 /***********************************************************************
  * implementation guts
  **********************************************************************/
 struct Pothos::Topology::Impl
 {
-    Impl(Topology *self): self(self){}
+    Impl(Topology *self): self(self), autoPlacement(false), autoFusion(false){}
     Topology *self;
     ThreadPool threadPool;
+    bool autoPlacement;
+    bool autoFusion;
     std::vector<Flow> flows;
     std::vector<Flow> activeFlatFlows;
     std::unordered_map<Port, std::pair<Pothos::Proxy, Pothos::Proxy>> srcToNetgressCache;
     std::vector<Flow> squashFlows(const std::vector<Flow> &);
     std::vector<Flow> createNetworkFlows(const std::vector<Flow> &);
     std::vector<Flow> rectifyDomainFlows(const std::vector<Flow> &);
+    void autoPlaceBlocks(const std::vector<Flow> &);
+
+    //! the uids of the blocks with a node from automatic placement
+    std::set<std::string> autoPlacedBlocks;
+    std::vector<Flow> replicateFlows(const std::vector<Flow> &);
+    void autoFuseChains(const std::vector<Flow> &);
+
+    //! replication settings and the replica blocks per block uid
+    struct Replication
+    {
+        Replication(void): numReplicas(1), frameSize(0){}
+        size_t numReplicas;
+        size_t frameSize;
+        Pothos::Proxy splitter;
+        Pothos::Proxy merger;
+        std::vector<Pothos::Proxy> replicas;
+    };
+    std::map<std::string, Replication> replications;
+
+    //! the blocks of each fused chain in processing order
+    std::vector<std::vector<Pothos::Proxy>> fusedChains;
     std::vector<std::string> inputPortNames;
     std::vector<std::string> outputPortNames;
     std::map<std::string, PortInfo> inputPortInfo;
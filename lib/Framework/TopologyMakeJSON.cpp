@@ -193,6 +193,8 @@ std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &json
     //the IDs 'self', 'this', and '' can be used
     std::map<std::string, Pothos::Proxy> blocks;
     auto topology = Pothos::Topology::make();
+    topology->setAutoPlacement(topObj->optValue<bool>("autoPlacement", false));
+    topology->setAutoFusion(topObj->optValue<bool>("autoFusion", false));
     blocks["self"] = env->makeProxy(topology);
     blocks["this"] = env->makeProxy(topology);
     blocks[""] = env->makeProxy(topology);
@@ -216,6 +218,28 @@ std::shared_ptr<Pothos::Topology> Pothos::Topology::make(const std::string &json
         if (threadPoolIt != threadPools.end()) blocks[id].callVoid("setThreadPool", threadPoolIt->second);
         else if (not threadPoolName.empty()) throw Pothos::DataFormatException(
             "Pothos::Topology::make()", "blocks["+id+"] unknown threadPool = " + threadPoolName);
+
+        //set the thread placement hint
+        Poco::JSON::Array::Ptr affinityArray;
+        if (blockObj->isArray("affinity")) affinityArray = blockObj->getArray("affinity");
+        if (affinityArray)
+        {
+            std::vector<size_t> affinity;
+            for (size_t j = 0; j < affinityArray->size(); j++)
+            {
+                affinity.push_back(affinityArray->getElement<int>(j));
+            }
+            blocks[id].callVoid("setThreadAffinity", blockObj->optValue<std::string>("affinityMode", "CPU"), affinity);
+        }
+
+        //set the scheduling class and deadline
+        if (blockObj->has("schedulingClass")) blocks[id].callVoid("setSchedulingClass", blockObj->getValue<std::string>("schedulingClass"));
+        if (blockObj->has("deadlineNs") or blockObj->has("periodNs")) blocks[id].callVoid("setDeadline",
+            (long long)blockObj->optValue<Poco::Int64>("deadlineNs", 0), (long long)blockObj->optValue<Poco::Int64>("periodNs", 0));
+
+        //set the data-parallel replication
+        if (blockObj->has("replicas")) topology->setReplication(Pothos::Object(blocks[id]),
+            size_t(blockObj->getValue<int>("replicas")), size_t(blockObj->optValue<int>("frameSize", 0)));
     }
 
     //create the topology and connect the blocks
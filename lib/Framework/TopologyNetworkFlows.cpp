@@ -1,4 +1,4 @@
-// Copyright (c) 2014-2015 Josh Blum
+// Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/TopologyImpl.hpp"
@@ -6,6 +6,7 @@
 #include <Pothos/Remote.hpp>
 #include <Poco/Net/SocketAddress.h>
 #include <Poco/URI.h>
+#include <Poco/Logger.h>
 #include <future>
 
 /***********************************************************************
@@ -13,6 +14,19 @@
  **********************************************************************/
 std::pair<Pothos::Proxy, Pothos::Proxy> createNetworkFlow(const Flow &flow)
 {
+    //processes on the same host pass buffers through shared memory
+    if (flow.src.obj.getEnvironment()->getNodeId() == flow.dst.obj.getEnvironment()->getNodeId())
+    {
+        POTHOS_EXCEPTION_TRY
+        {
+            return createShmFlow(flow);
+        }
+        POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
+        {
+            poco_warning_f2(Poco::Logger::get("Pothos.Topology"), "%s shm flow failed, using the network: %s", flow.toString(), ex.displayText());
+        }
+    }
+
     //default behaviour: the sink binds, the source connects
     auto bindEnv = flow.src.obj.getEnvironment();
     auto connEnv = flow.dst.obj.getEnvironment();
@@ -0,0 +1,194 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/NumaPlacement.hpp"
+#include "Framework/WorkerActor.hpp"
+#include <Pothos/Framework/Block.hpp>
+#include <Pothos/System/NumaInfo.hpp>
+#include <algorithm>
+#include <deque>
+#include <set>
+
+/***********************************************************************
+ * Assign blocks to NUMA nodes:
+ *
+ * Connected blocks are assigned to the same NUMA node when possible,
+ * so that the buffers passed between them stay local to the node.
+ * Blocks in the fixed map keep their node and count towards its load.
+ * The other blocks are assigned by walking each connected group
+ * in breadth-first order and filling the least loaded node,
+ * followed by a pass that moves blocks to their neighbors' node.
+ **********************************************************************/
+std::map<std::string, size_t> assignNumaNodes(
+    const size_t numNodes,
+    const std::vector<std::string> &blocks,
+    const std::map<std::string, std::set<std::string>> &neighbors,
+    const std::map<std::string, size_t> &fixed)
+{
+    std::map<std::string, size_t> placement(fixed);
+    std::vector<size_t> loads(numNodes, 0);
+    for (const auto &pair : fixed) loads.at(pair.second)++;
+
+    //helper to find the node with the most placed neighbors of a block
+    static const std::set<std::string> noNeighbors;
+    auto neighborsOf = [&](const std::string &uid) -> const std::set<std::string> &
+    {
+        auto it = neighbors.find(uid);
+        return (it == neighbors.end())?noNeighbors:it->second;
+    };
+    auto neighborCounts = [&](const std::string &uid) -> std::vector<size_t>
+    {
+        std::vector<size_t> counts(numNodes, 0);
+        for (const auto &neighbor : neighborsOf(uid))
+        {
+            auto it = placement.find(neighbor);
+            if (it != placement.end()) counts[it->second]++;
+        }
+        return counts;
+    };
+    auto leastLoaded = [&](void)
+    {
+        return size_t(std::distance(loads.begin(), std::min_element(loads.begin(), loads.end())));
+    };
+
+    //assign the unplaced blocks of each connected group in breadth-first order
+    //the capacity allows for a small imbalance so pairs of blocks are not split
+    const size_t capacity = (blocks.size() + numNodes - 1)/numNodes + 1;
+    std::set<std::string> visited;
+    std::vector<std::string> assigned;
+    for (const auto &start : blocks)
+    {
+        if (visited.count(start) != 0) continue;
+        std::deque<std::string> frontier(1, start);
+        visited.insert(start);
+        size_t node = numNodes;
+        while (not frontier.empty())
+        {
+            const auto uid = frontier.front();
+            frontier.pop_front();
+            for (const auto &neighbor : neighborsOf(uid))
+            {
+                if (visited.insert(neighbor).second) frontier.push_back(neighbor);
+            }
+            if (placement.count(uid) != 0) continue;
+
+            //start next to placed neighbors, move on when the node is full
+            if (node == numNodes)
+            {
+                const auto counts = neighborCounts(uid);
+                node = size_t(std::distance(counts.begin(), std::max_element(counts.begin(), counts.end())));
+                if (counts[node] == 0) node = leastLoaded();
+            }
+            if (loads[node] >= capacity) node = leastLoaded();
+            placement[uid] = node;
+            loads[node]++;
+            assigned.push_back(uid);
+        }
+    }
+
+    //move blocks to the node of most neighbors when that node has room
+    std::map<std::string, size_t> result;
+    for (const auto &uid : assigned)
+    {
+        const auto counts = neighborCounts(uid);
+        const size_t current = placement[uid];
+        const size_t best = size_t(std::distance(counts.begin(), std::max_element(counts.begin(), counts.end())));
+        if (best != current and counts[best] > counts[current] and loads[best] < capacity)
+        {
+            loads[current]--;
+            loads[best]++;
+            placement[uid] = best;
+        }
+        result[uid] = placement[uid];
+    }
+    return result;
+}
+
+/***********************************************************************
+ * Automatic NUMA placement of the blocks in a topology:
+ *
+ * Each assigned block allocates the buffers of its ports on its node,
+ * and its task is processed by the pool threads of its node.
+ * The placement does not set thread placement hints, so the threads
+ * of a node continue to share and steal the tasks of the placed blocks.
+ * Blocks with an explicit placement hint keep the node of the hint,
+ * and blocks which were placed by a previous commit keep their node.
+ * The assigned nodes are cleared once placement is disabled.
+ **********************************************************************/
+static void setPlacementNode(Pothos::Block &block, const long node)
+{
+    if (block._actor->placementNode.exchange(node) == node) return;
+
+    //re-register with the thread pool to queue the task on the new node
+    const auto threadPool = block.getThreadPool();
+    if (not threadPool) return;
+    block.setThreadPool(Pothos::ThreadPool());
+    block.setThreadPool(threadPool);
+}
+
+void Pothos::Topology::Impl::autoPlaceBlocks(const std::vector<Flow> &flatFlows)
+{
+    //collect the local blocks and the connections between them
+    std::map<std::string, Block *> blocks;
+    std::vector<std::string> uids;
+    std::map<std::string, std::set<std::string>> neighbors;
+    for (const auto &block : getObjSetFromFlowList(flatFlows))
+    {
+        if (block.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid()) continue;
+        const auto uid = block.call<std::string>("uid");
+        blocks[uid] = block.call<Block *>("getPointer");
+        uids.push_back(uid);
+    }
+    for (const auto &flow : flatFlows)
+    {
+        if (blocks.count(flow.src.uid) == 0 or blocks.count(flow.dst.uid) == 0) continue;
+        neighbors[flow.src.uid].insert(flow.dst.uid);
+        neighbors[flow.dst.uid].insert(flow.src.uid);
+    }
+
+    //undo the previous placement when disabled
+    if (not autoPlacement)
+    {
+        for (const auto &uid : autoPlacedBlocks)
+        {
+            auto it = blocks.find(uid);
+            if (it != blocks.end()) setPlacementNode(*it->second, -1);
+        }
+        autoPlacedBlocks.clear();
+        return;
+    }
+
+    //nothing to place on a system with a single node
+    const auto numaInfo = Pothos::System::NumaInfo::get();
+    if (numaInfo.size() < 2) return;
+    const size_t numNodes = numaInfo.size();
+
+    //the node index of blocks with a placement hint or a previous placement
+    std::map<std::string, size_t> fixed;
+    for (const auto &pair : blocks)
+    {
+        const auto &mode = pair.second->getThreadAffinityMode();
+        const auto &affinity = pair.second->getThreadAffinity();
+        const long previous = (autoPlacedBlocks.count(pair.first) != 0)?pair.second->_actor->placementNode.load():-1;
+        if (affinity.empty() and previous < 0) continue;
+        for (size_t node = 0; node < numNodes; node++)
+        {
+            const auto &cpus = numaInfo[node].cpus;
+            if ((affinity.empty() and long(numaInfo[node].nodeNumber) == previous) or
+                (mode == "NUMA" and numaInfo[node].nodeNumber == affinity.front()) or
+                (mode == "CPU" and std::find(cpus.begin(), cpus.end(), affinity.front()) != cpus.end()))
+            {
+                fixed[pair.first] = node;
+                break;
+            }
+        }
+    }
+
+    //apply the assigned nodes to the buffers of the blocks
+    for (const auto &pair : assignNumaNodes(numNodes, uids, neighbors, fixed))
+    {
+        setPlacementNode(*blocks[pair.first], long(numaInfo[pair.second].nodeNumber));
+        autoPlacedBlocks.insert(pair.first);
+    }
+}
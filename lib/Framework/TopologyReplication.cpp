@@ -0,0 +1,332 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/ReplicaFrames.hpp"
+#include "Framework/WorkerActor.hpp"
+#include <Pothos/Framework/Block.hpp>
+#include <Pothos/Framework/InputPort.hpp>
+#include <Pothos/Framework/OutputPort.hpp>
+#include <Pothos/Framework/Exception.hpp>
+#include <algorithm>
+#include <set>
+
+/***********************************************************************
+ * Data-parallel replication of a block:
+ *
+ * A replicated block is replaced in the flows by a splitter,
+ * the replicas of the block, and a merger. The splitter deals
+ * frames of the input to the replicas in round-robin order,
+ * and records the size of each frame in the shared frames.
+ * Each replica reports its consumed and produced elements,
+ * which map the frame boundaries onto the replica's output.
+ * The merger visits the replicas in the same round-robin order,
+ * and forwards each replica's output up to the end of the frame
+ * before moving to the next replica, so the output is reassembled
+ * in the original order. The merge does not depend on the labels
+ * which the replicas propagate, and allows replicas which change
+ * the rate. Both blocks forward the buffers zero-copy, and carry
+ * the labels with the index adjusted to the output.
+ **********************************************************************/
+ReplicaFrames::ReplicaFrames(const size_t numReplicas):
+    ports(numReplicas),
+    _inputSizes(numReplicas),
+    _consumed(numReplicas, 0),
+    _produced(numReplicas, 0),
+    _totalProduced(numReplicas, 0),
+    _outputSizes(numReplicas)
+{
+    return;
+}
+
+void ReplicaFrames::setReplicaPorts(const size_t index, Pothos::InputPort *input, Pothos::OutputPort *output)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ports[index] = std::make_pair(input, output);
+    _totalProduced[index] = output->totalElements();
+}
+
+void ReplicaFrames::frameDealt(const size_t index, const size_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _inputSizes[index].push_back(size);
+}
+
+void ReplicaFrames::workDone(const size_t index, const size_t consumed, const unsigned long long totalProduced)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t produced = size_t(totalProduced - _totalProduced[index]);
+    _totalProduced[index] = totalProduced;
+
+    //share the output among the frames in proportion to the consumption
+    auto &sizes = _inputSizes[index];
+    size_t remaining = consumed;
+    while (remaining != 0 and not sizes.empty())
+    {
+        const size_t n = std::min(remaining, sizes.front()-_consumed[index]);
+        const size_t share = size_t((unsigned long long)(produced)*n/remaining);
+        _consumed[index] += n;
+        _produced[index] += share;
+        produced -= share;
+        remaining -= n;
+
+        //the frame is complete once the replica consumed all of it
+        if (_consumed[index] != sizes.front()) continue;
+        _outputSizes[index].push_back(_produced[index]);
+        sizes.pop_front();
+        _consumed[index] = 0;
+        _produced[index] = 0;
+    }
+
+    //output without consumption belongs to the current frame
+    _produced[index] += produced;
+}
+
+bool ReplicaFrames::popOutputFrame(const size_t index, size_t &size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &sizes = _outputSizes[index];
+    if (sizes.empty()) return false;
+    size = sizes.front();
+    sizes.pop_front();
+    return true;
+}
+
+class ReplicaSplitter : public Pothos::Block
+{
+public:
+    ReplicaSplitter(const Pothos::DType &dtype, const std::shared_ptr<ReplicaFrames> &frames, const size_t frameSize):
+        _frames(frames),
+        _frameSize(frameSize),
+        _next(0)
+    {
+        this->setName("replicaSplitter");
+        this->setupInput(0, dtype);
+        for (size_t i = 0; i < frames->ports.size(); i++) this->setupOutput(i, dtype);
+        if (_frameSize != 0) this->input(0)->setReserve(_frameSize);
+    }
+
+    void work(void)
+    {
+        auto inPort = this->input(0);
+        const auto &outputs = this->outputs();
+        const size_t available = inPort->elements();
+        const size_t elemSize = inPort->dtype().size();
+        std::vector<size_t> offsets(outputs.size(), 0);
+
+        size_t pos = 0;
+        auto labelIt = inPort->labels().begin();
+        while (pos < available)
+        {
+            //the whole available input is a frame without a frame size
+            const size_t frame = (_frameSize == 0)?(available-pos):_frameSize;
+            if (available-pos < frame) break;
+            auto outPort = outputs[_next];
+            auto &offset = offsets[_next];
+
+            //carry the labels in this frame relative to the output
+            for (; labelIt != inPort->labels().end() and labelIt->index < pos+frame; ++labelIt)
+            {
+                auto label = *labelIt;
+                label.index = label.index - pos + offset;
+                outPort->postLabel(label);
+            }
+
+            //record the frame before the replica can consume it
+            _frames->frameDealt(_next, frame);
+
+            auto buffer = inPort->buffer();
+            buffer.address += pos*elemSize;
+            buffer.length = frame*elemSize;
+            outPort->postBuffer(buffer);
+
+            offset += frame;
+            pos += frame;
+            _next = (_next+1)%outputs.size();
+        }
+
+        inPort->consume(pos);
+    }
+
+    void propagateLabels(const Pothos::InputPort *)
+    {
+        //labels are carried in work()
+    }
+
+private:
+    const std::shared_ptr<ReplicaFrames> _frames;
+    const size_t _frameSize;
+    size_t _next;
+};
+
+class ReplicaMerger : public Pothos::Block
+{
+public:
+    ReplicaMerger(const Pothos::DType &dtype, const std::shared_ptr<ReplicaFrames> &frames):
+        _frames(frames),
+        _next(0),
+        _remaining(0)
+    {
+        this->setName("replicaMerger");
+        for (size_t i = 0; i < frames->ports.size(); i++) this->setupInput(i, dtype);
+        this->setupOutput(0, dtype);
+    }
+
+    void work(void)
+    {
+        auto outPort = this->output(0);
+        const auto &inputs = this->inputs();
+        size_t offset = 0;
+
+        //visit each replica at most once per call in the frame order
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            auto inPort = inputs[_next];
+            const size_t available = inPort->elements();
+
+            //the output size of the current frame from this replica
+            if (_remaining == 0 and not _frames->popOutputFrame(_next, _remaining)) break;
+
+            //forward the elements and labels up to the end of the frame
+            const size_t n = std::min(available, _remaining);
+            for (const auto &label : inPort->labels())
+            {
+                if (label.index >= n) break;
+                auto adjusted = label;
+                adjusted.index += offset;
+                outPort->postLabel(adjusted);
+            }
+            if (n != 0)
+            {
+                auto buffer = inPort->buffer();
+                buffer.length = n*inPort->dtype().size();
+                outPort->postBuffer(buffer);
+                inPort->consume(n);
+                offset += n;
+                _remaining -= n;
+            }
+
+            //stay on this replica until its frame is complete
+            if (_remaining != 0) break;
+            _next = (_next+1)%inputs.size();
+        }
+    }
+
+    void propagateLabels(const Pothos::InputPort *)
+    {
+        //labels are carried in work()
+    }
+
+private:
+    const std::shared_ptr<ReplicaFrames> _frames;
+    size_t _next;
+    size_t _remaining;
+};
+
+/***********************************************************************
+ * Replace the replicated blocks in the flows
+ **********************************************************************/
+static Pothos::Proxy makeBlockProxy(const std::shared_ptr<Pothos::Block> &block)
+{
+    return Pothos::ProxyEnvironment::make("managed")->makeProxy(block);
+}
+
+std::vector<Flow> Pothos::Topology::Impl::replicateFlows(const std::vector<Flow> &flows)
+{
+    auto newFlows = flows;
+    for (auto &pair : this->replications)
+    {
+        const auto &uid = pair.first;
+        auto &replication = pair.second;
+
+        //find the connections of the replicated block
+        std::vector<Flow> inputFlows, outputFlows;
+        std::set<std::string> inputNames, outputNames;
+        for (const auto &flow : newFlows)
+        {
+            if (flow.dst.uid == uid) {inputFlows.push_back(flow); inputNames.insert(flow.dst.name);}
+            if (flow.src.uid == uid) {outputFlows.push_back(flow); outputNames.insert(flow.src.name);}
+        }
+        if (inputFlows.empty() and outputFlows.empty()) continue;
+
+        //check that the block can be replicated
+        const auto block = inputFlows.empty()?outputFlows.front().src.obj:inputFlows.front().dst.obj;
+        const auto name = block.call<std::string>("getName");
+        if (block.getEnvironment()->getUniquePid() != Pothos::ProxyEnvironment::getLocalUniquePid())
+        {
+            throw Pothos::TopologyConnectError("Pothos::Topology::commit()", name + " must be local for replication");
+        }
+        if (inputNames.size() != 1 or outputNames.size() != 1)
+        {
+            throw Pothos::TopologyConnectError("Pothos::Topology::commit()", name + " must have one input and one output connected for replication");
+        }
+        const auto &inputName = *inputNames.begin();
+        const auto &outputName = *outputNames.begin();
+        auto blockPtr = block.call<Block *>("getPointer");
+
+        //make the replicas, splitter, and merger the first time
+        if (replication.replicas.empty())
+        {
+            replication.replicas.push_back(block);
+            while (replication.replicas.size() < replication.numReplicas)
+            {
+                auto replica = blockPtr->replicate();
+                if (not replica) throw Pothos::TopologyConnectError("Pothos::Topology::commit()", name + " does not support replication");
+                replica->setName(name + "[" + std::to_string(replication.replicas.size()) + "]");
+                replication.replicas.push_back(makeBlockProxy(replica));
+            }
+            std::shared_ptr<ReplicaFrames> frames(new ReplicaFrames(replication.numReplicas));
+            for (size_t i = 0; i < replication.replicas.size(); i++)
+            {
+                //the workers of the replicas report each work call to the frames
+                auto replicaPtr = replication.replicas[i].call<Block *>("getPointer");
+                frames->setReplicaPorts(i, replicaPtr->input(inputName), replicaPtr->output(outputName));
+                ActorInterfaceLock lock(replicaPtr->_actor.get());
+                replicaPtr->_actor->replicaFrames = frames;
+                replicaPtr->_actor->replicaIndex = i;
+            }
+            replication.splitter = makeBlockProxy(std::shared_ptr<Block>(new ReplicaSplitter(
+                blockPtr->input(inputName)->dtype(), frames, replication.frameSize)));
+            replication.merger = makeBlockProxy(std::shared_ptr<Block>(new ReplicaMerger(
+                blockPtr->output(outputName)->dtype(), frames)));
+        }
+
+        //the replicas, splitter, and merger follow the block's thread pool and class
+        std::vector<Pothos::Proxy> followers(replication.replicas.begin()+1, replication.replicas.end());
+        followers.push_back(replication.splitter);
+        followers.push_back(replication.merger);
+        for (const auto &follower : followers)
+        {
+            auto followerPtr = follower.call<Block *>("getPointer");
+            if (not (followerPtr->getThreadPool() == blockPtr->getThreadPool())) followerPtr->setThreadPool(blockPtr->getThreadPool());
+            followerPtr->setSchedulingClass(blockPtr->getSchedulingClass());
+        }
+
+        //rewrite the flows through the splitter and merger
+        newFlows.erase(std::remove_if(newFlows.begin(), newFlows.end(), [&uid](const Flow &flow)
+        {
+            return flow.src.uid == uid or flow.dst.uid == uid;
+        }), newFlows.end());
+        for (auto flow : inputFlows)
+        {
+            flow.dst = this->makePort(replication.splitter, "0");
+            newFlows.push_back(flow);
+        }
+        for (size_t i = 0; i < replication.replicas.size(); i++)
+        {
+            Flow toReplica, fromReplica;
+            toReplica.src = this->makePort(replication.splitter, std::to_string(i));
+            toReplica.dst = this->makePort(replication.replicas[i], inputName);
+            fromReplica.src = this->makePort(replication.replicas[i], outputName);
+            fromReplica.dst = this->makePort(replication.merger, std::to_string(i));
+            newFlows.push_back(toReplica);
+            newFlows.push_back(fromReplica);
+        }
+        for (auto flow : outputFlows)
+        {
+            flow.src = this->makePort(replication.merger, "0");
+            newFlows.push_back(flow);
+        }
+    }
+    return newFlows;
+}
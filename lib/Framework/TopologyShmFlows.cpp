@@ -0,0 +1,351 @@
+// Copyright (c) 2016-2016 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Framework/TopologyImpl.hpp"
+#include "Framework/ShmChannel.hpp"
+#include <Pothos/Framework.hpp>
+#include <Poco/Logger.h>
+#include <unordered_map>
+#include <algorithm> //min
+#include <sstream>
+#include <cstring> //memcpy
+#include <deque>
+#include <thread>
+
+/***********************************************************************
+ * The shm sink and source replace a network flow between processes
+ * on the same host. The sink asks upstream to write into shared memory,
+ * passes the descriptor of each segment to the source once,
+ * and passes each buffer to the source by segment and offset.
+ * The source posts the mapped buffer without a copy, and the last
+ * release of the buffer downstream returns its sequence to the sink,
+ * which holds the buffer until then so that it is not overwritten.
+ * Buffers from another manager are copied into a private shm manager.
+ * The flow ends when either process closes the channel or exits.
+ **********************************************************************/
+static void releaseWhenReturned(std::shared_ptr<ShmChannel> channel, std::unordered_map<uint64_t, Pothos::BufferChunk> held)
+{
+    //the consumer may still read the held buffers after the sink is gone,
+    //so they are released once returned or once the consumer closed
+    while (not held.empty() and not channel->isPeerClosed())
+    {
+        uint64_t sequence = 0;
+        while (channel->popReturn(sequence)) held.erase(sequence);
+        if (not held.empty() and channel->wait()) channel->sleep(1000);
+        channel->clearDoorbell();
+    }
+}
+
+class ShmSink : public Pothos::Block
+{
+public:
+    static Pothos::Block *make(const std::string &dtype)
+    {
+        return new ShmSink(Pothos::DType(dtype));
+    }
+
+    ShmSink(const Pothos::DType &dtype):
+        _channel(ShmChannel::make()),
+        _nextSequence(0),
+        _ended(false)
+    {
+        this->setupInput(0, dtype);
+        this->registerCall(this, POTHOS_FCN_TUPLE(ShmSink, getChannelName));
+    }
+
+    ~ShmSink(void)
+    {
+        if (_channel->getDoorbell() >= 0) this->unregisterFileDescriptor(_channel->getDoorbell());
+        if (_held.empty() or _channel->isPeerClosed()) return;
+        std::thread(&releaseWhenReturned, _channel, std::move(_held)).detach();
+    }
+
+    void activate(void)
+    {
+        //the source connected when the topology created it
+        if (_ended) return;
+        _channel->accept();
+        this->registerFileDescriptor(_channel->getDoorbell(), true);
+    }
+
+    std::string getChannelName(void) const
+    {
+        return _channel->getName();
+    }
+
+    std::shared_ptr<Pothos::BufferManager> getInputBufferManager(const std::string &, const std::string &)
+    {
+        //upstream writes directly into shared memory
+        return Pothos::BufferManager::make("shm");
+    }
+
+    void work(void)
+    {
+        //release the buffers which the source returned
+        _channel->clearDoorbell();
+        uint64_t sequence = 0;
+        while (_channel->popReturn(sequence)) _held.erase(sequence);
+
+        //the source closed the channel or exited, drop the input
+        auto inPort = this->input(0);
+        if (_channel->isPeerClosed()) return this->endFlow(inPort);
+
+        //only take more input once the pending packets are written
+        if (this->flush())
+        {
+            while (inPort->hasMessage()) this->enqueueMessage(inPort->popMessage());
+            if (inPort->elements() != 0 and _held.size() < _channel->getMaxReturns()) this->enqueueBuffer(inPort);
+            this->flush();
+        }
+
+        //sleep until the source returns buffers or reads packets
+        if (_held.empty() and _pending.empty()) return;
+        if (not _channel->wait() or this->writable()) this->yield();
+    }
+
+    void propagateLabels(const Pothos::InputPort *)
+    {
+        //labels are sent in work()
+    }
+
+private:
+    void endFlow(Pothos::InputPort *inPort)
+    {
+        if (not _ended)
+        {
+            if (not _held.empty() or not _pending.empty()) poco_error_f3(Poco::Logger::get("Pothos.ShmSink"),
+                "%s: the source closed with %z buffers and %z packets in flight", this->getName(), _held.size(), _pending.size());
+            this->unregisterFileDescriptor(_channel->getDoorbell());
+            _held.clear();
+            _pending.clear();
+            _ended = true;
+        }
+        while (inPort->hasMessage()) inPort->popMessage();
+        inPort->consume(inPort->elements());
+    }
+
+    void enqueue(const ShmChannel::Packet &packet, const std::string &payload)
+    {
+        if (payload.size() > _channel->getMaxPayloadSize())
+        {
+            poco_error_f2(Poco::Logger::get("Pothos.ShmSink"), "%s: dropped %z byte packet", this->getName(), payload.size());
+            return;
+        }
+        _pending.emplace_back(packet, payload);
+    }
+
+    void enqueueMessage(const Pothos::Object &message)
+    {
+        POTHOS_EXCEPTION_TRY
+        {
+            std::ostringstream os;
+            message.serialize(os);
+            ShmChannel::Packet packet = ShmChannel::Packet();
+            packet.type = ShmChannel::PACKET_MESSAGE;
+            this->enqueue(packet, os.str());
+        }
+        POTHOS_EXCEPTION_CATCH(const Pothos::Exception &ex)
+        {
+            poco_error_f2(Poco::Logger::get("Pothos.ShmSink"), "%s: dropped message: %s", this->getName(), ex.displayText());
+        }
+    }
+
+    void enqueueBuffer(Pothos::InputPort *inPort)
+    {
+        const size_t elemSize = inPort->dtype().size();
+        size_t elements = inPort->elements();
+        auto buffer = inPort->buffer();
+
+        //copy into shared memory when upstream used another manager
+        auto segment = ShmSegment::lookup(buffer.address, elements*elemSize);
+        if (not segment)
+        {
+            if (not _copyManager) _copyManager = Pothos::BufferManager::make("shm", Pothos::BufferManagerArgs());
+            if (_copyManager->empty()) return;
+            auto copy = _copyManager->front();
+            elements = std::min(elements, copy.length/elemSize);
+            if (elements == 0) return;
+            copy.length = elements*elemSize;
+            std::memcpy(copy.as<void *>(), buffer.as<const void *>(), copy.length);
+            _copyManager->pop(copy.length);
+            buffer = copy;
+            segment = ShmSegment::lookup(buffer.address, buffer.length);
+        }
+        buffer.length = elements*elemSize;
+
+        //the source maps the segment from its descriptor
+        _channel->sendSegment(segment);
+        if (_channel->isPeerClosed()) return;
+
+        //the labels precede their buffer with indexes relative to the buffer
+        std::vector<Pothos::Label> labels;
+        for (const auto &label : inPort->labels())
+        {
+            if (label.index < elements) labels.push_back(label);
+        }
+        if (not labels.empty())
+        {
+            std::ostringstream os;
+            Pothos::Object(labels).serialize(os);
+            ShmChannel::Packet packet = ShmChannel::Packet();
+            packet.type = ShmChannel::PACKET_LABELS;
+            this->enqueue(packet, os.str());
+        }
+
+        ShmChannel::Packet packet = ShmChannel::Packet();
+        packet.type = ShmChannel::PACKET_BUFFER;
+        packet.sequence = _nextSequence++;
+        packet.segment = segment->getId();
+        packet.offset = buffer.address - segment->getAddress();
+        packet.length = buffer.length;
+        this->enqueue(packet, std::string());
+        _held[packet.sequence] = buffer;
+        inPort->consume(elements);
+    }
+
+    bool writable(void) const
+    {
+        if (_pending.empty()) return false;
+        const size_t payloadSize = _pending.front().second.size();
+        return _channel->writable(&payloadSize, 1);
+    }
+
+    bool flush(void)
+    {
+        while (this->writable())
+        {
+            _channel->write(_pending.front().first, _pending.front().second);
+            _pending.pop_front();
+        }
+        return _pending.empty();
+    }
+
+    std::shared_ptr<ShmChannel> _channel;
+    uint64_t _nextSequence;
+    std::deque<std::pair<ShmChannel::Packet, std::string>> _pending;
+    std::unordered_map<uint64_t, Pothos::BufferChunk> _held;
+    Pothos::BufferManager::Sptr _copyManager;
+    bool _ended;
+};
+
+class ShmSource : public Pothos::Block
+{
+public:
+    static Pothos::Block *make(const std::string &channelName, const std::string &dtype)
+    {
+        return new ShmSource(channelName, Pothos::DType(dtype));
+    }
+
+    ShmSource(const std::string &channelName, const Pothos::DType &dtype):
+        _channel(ShmChannel::open(channelName)),
+        _ended(false)
+    {
+        this->setupOutput(0, dtype);
+        this->registerFileDescriptor(_channel->getDoorbell(), true);
+    }
+
+    ~ShmSource(void)
+    {
+        this->unregisterFileDescriptor(_channel->getDoorbell());
+    }
+
+    void work(void)
+    {
+        _channel->clearDoorbell();
+        auto outPort = this->output(0);
+        size_t offset = 0;
+
+        ShmChannel::Packet packet;
+        std::string payload;
+        while (_channel->read(packet, payload))
+        {
+            std::istringstream is(payload);
+            Pothos::Object object;
+            switch (packet.type)
+            {
+            case ShmChannel::PACKET_MESSAGE:
+                object.deserialize(is);
+                outPort->postMessage(std::move(object));
+                break;
+
+            case ShmChannel::PACKET_LABELS:
+                object.deserialize(is);
+                for (const auto &label : object.extract<std::vector<Pothos::Label>>()) _labels.push_back(label);
+                break;
+
+            case ShmChannel::PACKET_BUFFER:
+            {
+                auto buffer = this->mapBuffer(packet);
+                buffer.dtype = outPort->dtype();
+                for (auto &label : _labels)
+                {
+                    label.index += offset;
+                    outPort->postLabel(label);
+                }
+                _labels.clear();
+                outPort->postBuffer(buffer);
+                offset += buffer.elements();
+            } break;
+
+            default: break;
+            }
+        }
+
+        //the packets before the sink closed or exited were read
+        if (_channel->isPeerClosed())
+        {
+            if (not _ended) this->unregisterFileDescriptor(_channel->getDoorbell());
+            _ended = true;
+            return;
+        }
+
+        //sleep until the sink writes more packets
+        if (not _channel->wait()) this->yield();
+    }
+
+private:
+    Pothos::BufferChunk mapBuffer(const ShmChannel::Packet &packet)
+    {
+        //the segments of the sink stay mapped while the channel is referenced
+        auto segment = _channel->getSegment(packet.segment);
+        if (packet.offset + packet.length > segment->getLength())
+        {
+            throw Pothos::SharedBufferError("ShmSource::mapBuffer("+_channel->getName()+")", "buffer out of range");
+        }
+
+        //the container returns the sequence when the last copy is released
+        const size_t address = segment->getAddress() + size_t(packet.offset);
+        const auto channel = _channel;
+        const auto sequence = packet.sequence;
+        std::shared_ptr<void> container(reinterpret_cast<void *>(address), [channel, segment, sequence](void *)
+        {
+            channel->pushReturn(sequence);
+        });
+        return Pothos::BufferChunk(Pothos::SharedBuffer(address, size_t(packet.length), container));
+    }
+
+    std::shared_ptr<ShmChannel> _channel;
+    std::vector<Pothos::Label> _labels;
+    bool _ended;
+};
+
+static Pothos::BlockRegistry registerShmSink("/shm_sink", &ShmSink::make);
+static Pothos::BlockRegistry registerShmSource("/shm_source", &ShmSource::make);
+
+/***********************************************************************
+ * Create a shm sink in the source process and a shm source
+ * in the destination process, which opens the channel of the sink
+ **********************************************************************/
+std::pair<Pothos::Proxy, Pothos::Proxy> createShmFlow(const Flow &flow)
+{
+    const auto dtype = flow.src.obj.callProxy("output", flow.src.name).callProxy("dtype").call<std::string>("toMarkup");
+    auto shmSink = flow.src.obj.getEnvironment()->findProxy("Pothos/BlockRegistry").callProxy("/blocks/shm_sink", dtype);
+    const auto channelName = shmSink.call<std::string>("getChannelName");
+    auto shmSource = flow.dst.obj.getEnvironment()->findProxy("Pothos/BlockRegistry").callProxy("/blocks/shm_source", channelName, dtype);
+
+    //return the pair of shm blocks
+    const auto name = flow.src.obj.call<std::string>("getName")+"["+flow.src.name+"]";
+    shmSink.callVoid("setName", "ShmTo: "+name);
+    shmSource.callVoid("setName", "ShmFrom: "+name);
+    return std::make_pair(shmSource, shmSink);
+}
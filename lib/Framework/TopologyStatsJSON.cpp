@@ -53,6 +53,18 @@ std::string Pothos::Topology::queryJSONStats(void)
         for (const auto &name : names) stats->set(name, workStats->getObject(name));
     }
 
+    //list the blocks of each fused chain in processing order
+    for (const auto &chain : _impl->fusedChains)
+    {
+        Poco::JSON::Array::Ptr chainArray(new Poco::JSON::Array());
+        for (const auto &block : chain) chainArray->add(block.call<std::string>("uid"));
+        for (const auto &block : chain)
+        {
+            const auto uid = block.call<std::string>("uid");
+            if (stats->has(uid)) stats->getObject(uid)->set("fusedChain", chainArray);
+        }
+    }
+
     //use flat topology to get hierarchical block names
     const auto result = Poco::JSON::Parser().parse(this->dumpJSON());
     const auto flatTopologyObj = result.extract<Poco::JSON::Object::Ptr>();
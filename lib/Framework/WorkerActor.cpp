@@ -2,9 +2,11 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include "Framework/WorkerActor.hpp"
+#include "Framework/AllocationCounter.hpp"
 #include <Pothos/Framework/InputPortImpl.hpp>
 #include <Pothos/Framework/OutputPortImpl.hpp>
 #include <Pothos/Object/Containers.hpp>
+#include <Pothos/System/NumaInfo.hpp>
 #include <Poco/Format.h>
 #include <Poco/Logger.h>
 #include <cassert>
@@ -64,22 +66,73 @@ Pothos::BufferManager::Sptr Pothos::WorkerActor::getBufferManager(const std::str
     return this->getBufferManagerNoLock(name, domain, isInput);
 }
 
+static long getNodeAffinity(const Pothos::Block *block)
+{
+    //the NUMA node of the block's placement hint, or from automatic placement
+    const auto &affinity = block->getThreadAffinity();
+    if (affinity.empty()) return block->_actor->placementNode;
+    if (block->getThreadAffinityMode() == "NUMA") return long(affinity.front());
+
+    //the NUMA node which contains the first hinted CPU
+    for (const auto &info : Pothos::System::NumaInfo::get())
+    {
+        if (std::find(info.cpus.begin(), info.cpus.end(), affinity.front()) != info.cpus.end()) return long(info.nodeNumber);
+    }
+    return -1;
+}
+
 Pothos::BufferManager::Sptr Pothos::WorkerActor::getBufferManagerNoLock(const std::string &name, const std::string &domain, const bool isInput)
 {
     //check the cache for a manager thats still in use
     auto &weakMgr = bufferManagerCache[isInput][name][domain];
     auto m = weakMgr.lock();
 
+    //allocate buffers on the NUMA node of the block's placement hint
+    BufferManagerArgs args;
+    args.nodeAffinity = getNodeAffinity(block);
+
     //try to get the manager and make one if its null
     if (not m) m = isInput? block->getInputBufferManager(name, domain) : block->getOutputBufferManager(name, domain);
-    if (not m) m = BufferManager::make("generic", BufferManagerArgs());
-    else if (not m->isInitialized()) m->init(BufferManagerArgs()); //TODO pass this in from somewhere
+    if (not m and not isInput) m = this->makeStagingBufferManagerNoLock(name, args);
+    if (not m) m = BufferManager::make("generic", args);
+    else if (not m->isInitialized()) m->init(args);
 
     //store the new buffer manager to the cache
     weakMgr = m;
     return m;
 }
 
+Pothos::BufferManager::Sptr Pothos::WorkerActor::makeStagingBufferManagerNoLock(const std::string &name, const BufferManagerArgs &args)
+{
+    //the largest reserve in bytes of the subscribers on this output
+    size_t reserveBytes = 0;
+    for (auto *subscriber : this->outputs.at(name)->_subscribers)
+    {
+        reserveBytes = std::max(reserveBytes, subscriber->_reserveElements*subscriber->dtype().size());
+    }
+
+    //Frames that fit into a single buffer are mostly handed downstream as-is.
+    //Larger frames would span several buffers and be copied together by require().
+    if (reserveBytes <= args.bufferSize) return BufferManager::Sptr();
+
+    //Instead, stage the output into a circular buffer so the frames stay contiguous.
+    //The ring holds two frames plus the partially consumed buffers at either end,
+    //so the downstream accumulator can wait for an entire frame without copying.
+    BufferManagerArgs circArgs(args);
+    const size_t buffersPerFrame = (reserveBytes + args.bufferSize - 1)/args.bufferSize;
+    circArgs.numBuffers = std::max(args.numBuffers, 2*buffersPerFrame + 2);
+    try
+    {
+        return BufferManager::make("circular", circArgs);
+    }
+    catch (const Exception &ex)
+    {
+        poco_warning_f3(Poco::Logger::get("Pothos.WorkerActor"), "%s[%s] circular staging buffer failed: %s",
+            block->getName(), name, ex.displayText());
+    }
+    return BufferManager::Sptr();
+}
+
 void Pothos::WorkerActor::setOutputBufferManager(const std::string &name, const BufferManager::Sptr &manager)
 {
     ActorInterfaceLock lock(this);
@@ -167,6 +220,9 @@ void Pothos::WorkerActor::subscribeOutput(const std::string &action, const std::
     //empty subscribers, don't hold onto the buffer manager so it can be cleaned up
     if (subscribers.empty()) bufferManagerTmpCache[true][myPortName].reset();
 
+    //the only subscriber hands off buffers without a lock, fan-in uses the lock
+    this->inputs.at(myPortName)->setHandoffProducer((subscribers.size() == 1)?subscribers.front():nullptr);
+
     this->updatePorts();
 }
 
@@ -184,6 +240,9 @@ void Pothos::WorkerActor::setActiveStateOn(void)
         this->ensureOutputBufferManagerNoLock(entry.first);
     }
 
+    //realtime profile: prepare the ports before the stream starts
+    if (this->realtimeProfile) this->prepareRealtimeNoLock();
+
     POTHOS_EXCEPTION_TRY
     {
         this->activeState = true;
@@ -209,19 +268,157 @@ void Pothos::WorkerActor::setActiveStateOff(void)
     this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
 }
 
+/***********************************************************************
+ * realtime profile
+ **********************************************************************/
+//matches the default capacity of the input port message queues
+static const size_t RealtimeQueueCapacity = 1024;
+
+//touch every page of the buffers in a manager's buffer list,
+//writing back the same value so that the pages are mapped writable
+static void prefaultBuffers(const Pothos::ManagedBuffer &first)
+{
+    const size_t pageSize = ThreadEnvironment::getPageSize();
+    for (auto buff = first; buff;)
+    {
+        const auto &shared = buff.getBuffer();
+        for (size_t off = 0; off < shared.getLength(); off += pageSize)
+        {
+            auto p = reinterpret_cast<volatile char *>(shared.getAddress() + off);
+            *p = *p;
+        }
+        buff = buff.getNextBuffer();
+        if (buff == first) break; //circular list
+    }
+}
+
+void Pothos::WorkerActor::setRealtimeProfile(const bool enable)
+{
+    ActorInterfaceLock lock(this);
+    this->realtimeProfile = enable;
+    if (this->realtimeProfile and this->activeState) this->prepareRealtimeNoLock();
+}
+
+void Pothos::WorkerActor::prepareRealtimeNoLock(void)
+{
+    //allocate and pre-size the input queues and the accumulator,
+    //so pushes from upstream never allocate a queue
+    for (const auto &entry : this->inputs)
+    {
+        auto &port = *entry.second;
+        port._asyncMessages.allocate();
+        port._slotCalls.allocate();
+        port._inputInlineMessages.set_capacity(RealtimeQueueCapacity);
+        {
+            std::lock_guard<Util::SpinLock> lock(port._bufferAccumulatorLock);
+            port._stagedBatches.set_capacity(RealtimeQueueCapacity);
+            port._bufferAccumulator.reserve(RealtimeQueueCapacity, port._reserveElements*port.dtype().size());
+        }
+    }
+
+    //pre-fault the buffer managers which the inputs provide upstream
+    for (const auto &nameEntry : this->bufferManagerCache[true])
+    {
+        for (const auto &domainEntry : nameEntry.second)
+        {
+            auto manager = domainEntry.second.lock();
+            if (not manager or manager->empty()) continue;
+            prefaultBuffers(manager->front().getManagedBuffer());
+        }
+    }
+
+    //pre-size the posted buffers and pre-fault the buffer managers
+    for (const auto &entry : this->outputs)
+    {
+        auto &port = *entry.second;
+        port._postedBuffers.set_capacity(RealtimeQueueCapacity);
+        if (not port._bufferManager or port._bufferManager->empty()) continue;
+        prefaultBuffers(port._bufferManager->front().getManagedBuffer());
+    }
+}
+
+/***********************************************************************
+ * file descriptor readiness
+ **********************************************************************/
+static std::function<void(void)> makeDescriptorCallback(const std::weak_ptr<Pothos::WorkerActor> &weakActor)
+{
+    //the callback holds a weak reference in case the block is destroyed first
+    return [weakActor](void)
+    {
+        auto actor = weakActor.lock();
+        if (not actor) return;
+        actor->descriptorsReady = true;
+        actor->flagExternalChange();
+    };
+}
+
+void Pothos::WorkerActor::registerDescriptor(const int fd, const bool read, const bool write)
+{
+    std::lock_guard<std::mutex> lock(descriptorMutex);
+    if (descriptorEnvironment) descriptorEnvironment->registerDescriptor(fd, read, write, makeDescriptorCallback(block->_actor));
+    descriptors[fd] = std::make_pair(read, write);
+}
+
+void Pothos::WorkerActor::unregisterDescriptor(const int fd)
+{
+    std::lock_guard<std::mutex> lock(descriptorMutex);
+    if (descriptors.erase(fd) == 0) return;
+    if (descriptorEnvironment) descriptorEnvironment->unregisterDescriptor(fd);
+}
+
+void Pothos::WorkerActor::setDescriptorEnvironment(const std::shared_ptr<ThreadEnvironment> &environment)
+{
+    std::lock_guard<std::mutex> lock(descriptorMutex);
+    if (descriptorEnvironment == environment) return;
+
+    if (descriptorEnvironment) for (const auto &entry : descriptors)
+    {
+        descriptorEnvironment->unregisterDescriptor(entry.first);
+    }
+
+    descriptorEnvironment = environment;
+
+    //log rather than throw, the block remains in the new thread pool
+    if (descriptorEnvironment) for (const auto &entry : descriptors)
+    {
+        POTHOS_EXCEPTION_TRY
+        {
+            descriptorEnvironment->registerDescriptor(entry.first,
+                entry.second.first, entry.second.second, makeDescriptorCallback(block->_actor));
+        }
+        POTHOS_EXCEPTION_CATCH(const Exception &ex)
+        {
+            poco_error_f2(Poco::Logger::get("Pothos.Block.registerFileDescriptor"), "%s: %s", block->getName(), ex.displayText());
+        }
+    }
+}
+
+void Pothos::WorkerActor::rearmDescriptors(void)
+{
+    //only descriptors which were ready are disarmed
+    if (not descriptorsReady.load(std::memory_order_relaxed)) return;
+    if (not descriptorsReady.exchange(false)) return;
+
+    std::lock_guard<std::mutex> lock(descriptorMutex);
+    if (descriptorEnvironment) for (const auto &entry : descriptors)
+    {
+        descriptorEnvironment->rearmDescriptor(entry.first);
+    }
+}
+
 /***********************************************************************
  * work task dispatcher
  **********************************************************************/
-void Pothos::WorkerActor::workTask(void)
+bool Pothos::WorkerActor::workTask(void)
 {
-    if (not activeState) return;
+    if (not activeState) return false;
     this->numTaskCalls++;
     TimeAccumulator taskTime(this->totalTimeTask);
 
     //prework
     {
         TimeAccumulator preWorkTime(this->totalTimePreWork);
-        if (not this->preWorkTasks()) return;
+        if (not this->preWorkTasks()) return false;
     }
 
     //work
@@ -229,6 +426,7 @@ void Pothos::WorkerActor::workTask(void)
     {
         this->numWorkCalls++;
         TimeAccumulator workTime(this->totalTimeWork);
+        AllocationAccumulator workAllocations(this->numWorkAllocations);
         block->work();
     }
     POTHOS_EXCEPTION_CATCH(const Exception &ex)
@@ -236,13 +434,18 @@ void Pothos::WorkerActor::workTask(void)
         poco_error_f2(Poco::Logger::get("Pothos.Block.work"), "%s: %s", block->getName(), ex.displayText());
     }
 
+    //monitor the file descriptors again after work() serviced them
+    this->rearmDescriptors();
+
     //postwork
+    bool productive = false;
     {
         TimeAccumulator preWorkTime(this->totalTimePostWork);
-        this->postWorkTasks();
+        productive = this->postWorkTasks();
     }
 
     this->timeLastWork = std::chrono::high_resolution_clock::now();
+    return productive;
 }
 
 /***********************************************************************
@@ -285,6 +488,12 @@ bool Pothos::WorkerActor::preWorkTasks(void)
         //hold all of our message resources, we can't continue
         if (port.tokenManagerEmpty()) return false;
 
+        //a full message queue downstream blocks this port like empty tokens
+        if (port._totalMessages != 0) for (const auto &subscriber : port._subscribers)
+        {
+            if (subscriber->messagesBlocked()) return false;
+        }
+
         //signal ports don't use buffers, skip the code below
         if (port.isSignal()) continue;
 
@@ -377,7 +586,7 @@ bool Pothos::WorkerActor::preWorkTasks(void)
 /***********************************************************************
  * post-work
  **********************************************************************/
-void Pothos::WorkerActor::postWorkTasks(void)
+bool Pothos::WorkerActor::postWorkTasks(void)
 {
     ///////////////////// input handling ////////////////////////
 
@@ -499,7 +708,7 @@ void Pothos::WorkerActor::postWorkTasks(void)
         {
             for (const auto &subscriber : port._subscribers)
             {
-                subscriber->bufferLabelPush(postedLabels, postedBuffers);
+                subscriber->bufferLabelPush(postedLabels, postedBuffers, &port);
             }
         }
 
@@ -527,6 +736,15 @@ void Pothos::WorkerActor::postWorkTasks(void)
         this->activityIndicator.fetch_add(1, std::memory_order_relaxed);
         this->timeLastProduced = std::chrono::high_resolution_clock::now();
     }
+
+    //a replica reports the work call after its output was posted
+    if (replicaFrames)
+    {
+        const auto &ports = replicaFrames->ports[replicaIndex];
+        replicaFrames->workDone(replicaIndex, ports.first->_pendingElements, ports.second->_totalElements);
+    }
+
+    return inputWorkEvents != 0 or outputWorkEvents != 0;
 }
 
 Poco::JSON::Object::Ptr Pothos::WorkerActor::queryWorkStats(void)
@@ -538,6 +756,11 @@ Poco::JSON::Object::Ptr Pothos::WorkerActor::queryWorkStats(void)
     stats->set("blockName", block->getName());
     stats->set("numTaskCalls", Poco::UInt64(this->numTaskCalls));
     stats->set("numWorkCalls", Poco::UInt64(this->numWorkCalls));
+    stats->set("numWorkAllocations", Poco::UInt64(this->numWorkAllocations));
+    stats->set("numDeadlineMisses", Poco::UInt64(this->numDeadlineMisses.load()));
+    stats->set("placementNode", Poco::Int64(this->placementNode.load()));
+    stats->set("numTaskSteals", Poco::UInt64(this->numTaskSteals.load()));
+    stats->set("maxWorkCallsPerTask", Poco::UInt64(this->maxWorkCallsPerTask));
     stats->set("totalTimeTask", Poco::UInt64(this->totalTimeTask.count()));
     stats->set("totalTimeWork", Poco::UInt64(this->totalTimeWork.count()));
     stats->set("totalTimePreWork", Poco::UInt64(this->totalTimePreWork.count()));
@@ -570,17 +793,14 @@ Poco::JSON::Object::Ptr Pothos::WorkerActor::queryWorkStats(void)
         {
             BufferChunk frontBuff; port.bufferAccumulatorFront(frontBuff);
             portStats->set("frontBytes", Poco::UInt64(frontBuff.length));
+            portStats->set("frontBacking", frontBuff.getBuffer().getBacking());
         }
-        {
-            std::lock_guard<Util::SpinLock> lockB(port._bufferAccumulatorLock);
-            portStats->set("enqueuedBytes", Poco::UInt64(port._bufferAccumulator.getTotalBytesAvailable()));
-            portStats->set("enqueuedBuffers", Poco::UInt64(port._bufferAccumulator.getUniqueManagedBufferCount()));
-            portStats->set("enqueuedLabels", Poco::UInt64(port._inlineMessages.size()+port._inputInlineMessages.size()));
-        }
-        {
-            std::lock_guard<Util::SpinLock> lockM(port._asyncMessagesLock);
-            portStats->set("enqueuedMessages", Poco::UInt64(port._asyncMessages.size()));
-        }
+        portStats->set("enqueuedBytes", Poco::UInt64(port._bufferAccumulator.getTotalBytesAvailable()));
+        portStats->set("enqueuedBuffers", Poco::UInt64(port._bufferAccumulator.getUniqueManagedBufferCount()));
+        portStats->set("enqueuedLabels", Poco::UInt64(port._inlineMessages.size()+port._inputInlineMessages.size()));
+        portStats->set("lockFreeHandoff", port._handoffProducer.load() != nullptr);
+        portStats->set("enqueuedMessages", Poco::UInt64(port._asyncMessages.size()+(port._hasPeekedMessage?1:0)));
+        portStats->set("droppedMessages", Poco::UInt64(port._droppedMessages.load()));
         inputStats->add(portStats);
     }
     if (inputStats->size() > 0) stats->set("inputStats", inputStats);
@@ -603,6 +823,7 @@ Poco::JSON::Object::Ptr Pothos::WorkerActor::queryWorkStats(void)
         {
             BufferChunk frontBuff; port.bufferManagerFront(frontBuff);
             portStats->set("frontBytes", Poco::UInt64(frontBuff.length));
+            portStats->set("frontBacking", frontBuff.getBuffer().getBacking());
         }
         portStats->set("tokensEmpty", port.tokenManagerEmpty());
         outputStats->add(portStats);
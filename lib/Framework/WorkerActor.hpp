@@ -1,14 +1,16 @@
-// Copyright (c) 2014-2015 Josh Blum
+// Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
 #include "Framework/ActorInterface.hpp"
+#include "Framework/ReplicaFrames.hpp"
 #include <Pothos/Framework/BlockImpl.hpp>
 #include <Pothos/Framework/Exception.hpp>
 #include <Poco/Format.h>
 #include <Poco/Logger.h>
 #include <Poco/JSON/Object.h>
 #include <Poco/JSON/Array.h>
+#include <algorithm> //max
 #include <atomic>
 #include <set>
 #include <iostream>
@@ -23,25 +25,108 @@ public:
         block(block),
         activeState(false),
         activityIndicator(0),
+        workQuantum(1),
+        workQuantumNs(0),
+        realtimeProfile(false),
+        placementNode(-1),
+        replicaIndex(0),
+        pendingWakeNs(0),
+        descriptorsReady(false),
         numTaskCalls(0),
-        numWorkCalls(0)
+        numWorkCalls(0),
+        numWorkAllocations(0),
+        numDeadlineMisses(0),
+        numTaskSteals(0),
+        maxWorkCallsPerTask(0)
     {
         return;
     }
 
     /*!
-     * Perform the main processing task once.
+     * Perform the main processing task.
+     * The task is repeated while it remains productive,
+     * up to the work quantum limits of the thread pool.
      * Give the context back to the worker thread.
      */
     bool processTask(const bool waitEnabled)
     {
-        if (this->workerThreadAcquire(waitEnabled))
+        if (not this->workerThreadAcquire(waitEnabled)) return false;
+
+        //the quantum time limit is only checked when configured
+        std::chrono::high_resolution_clock::time_point deadline;
+        if (workQuantumNs.count() != 0) deadline = std::chrono::high_resolution_clock::now() + workQuantumNs;
+
+        const auto startWorkCalls = numWorkCalls;
+        for (size_t i = 1; this->workTask() and i < workQuantum; i++)
+        {
+            if (this->externalCallPending()) break;
+            if (workQuantumNs.count() != 0 and std::chrono::high_resolution_clock::now() > deadline) break;
+        }
+        maxWorkCallsPerTask = std::max(maxWorkCallsPerTask, numWorkCalls - startWorkCalls);
+
+        this->workerThreadRelease();
+        return true;
+    }
+
+    /*!
+     * Perform the processing task of a fused chain.
+     * This actor is the head, followed by the fused actors,
+     * which are processed in order on the calling thread,
+     * so that each block consumes the buffers of the previous
+     * block while they are still in the cache of this core.
+     * The fused actors forward external changes to the head,
+     * so the caller only needs to wait on the head actor.
+     */
+    bool processFusedTask(const bool waitEnabled)
+    {
+        if (fusedActors.empty()) return this->processTask(waitEnabled);
+
+        bool acquired = this->processTask(false);
+        for (auto actor : fusedActors)
         {
-            this->workTask();
-            this->workerThreadRelease();
-            return true;
+            if (actor->processTask(false)) acquired = true;
         }
-        return false;
+        if (acquired or not waitEnabled) return acquired;
+        return this->processTask(true);
+    }
+
+    //! Set the work quantum limits from the thread pool args
+    void setWorkQuantum(const size_t quantum, const long long quantumNs)
+    {
+        workQuantum = quantum;
+        workQuantumNs = std::chrono::nanoseconds(quantumNs);
+    }
+
+    /*!
+     * Enable the realtime profile from the thread pool args.
+     * The ports are prepared now when the block is already active,
+     * otherwise the ports are prepared when the block is activated.
+     */
+    void setRealtimeProfile(const bool enable);
+
+    /*!
+     * Register a file descriptor for readiness notifications.
+     * The descriptor is registered with the thread environment
+     * of the block, and moves with the block between thread pools.
+     */
+    void registerDescriptor(const int fd, const bool read, const bool write);
+
+    //! Unregister a file descriptor from readiness notifications
+    void unregisterDescriptor(const int fd);
+
+    //! Move the registered file descriptors to the thread environment
+    void setDescriptorEnvironment(const std::shared_ptr<ThreadEnvironment> &environment);
+
+    //! Count a dispatch of the deadline class after its deadline
+    void deadlineMissed(void)
+    {
+        numDeadlineMisses++;
+    }
+
+    //! Count a dispatch from the ready queue of another pool thread
+    void taskStolen(void)
+    {
+        numTaskSteals++;
     }
 
     /*!
@@ -67,6 +152,18 @@ public:
     Block *block;
     bool activeState;
     std::atomic<int> activityIndicator;
+    size_t workQuantum;
+    std::chrono::nanoseconds workQuantumNs;
+    bool realtimeProfile;
+    std::atomic<long> placementNode; //NUMA node from automatic placement or -1 (see Topology::setAutoPlacement)
+    std::shared_ptr<ReplicaFrames> replicaFrames; //set on the replicas of a block (see Topology::setReplication)
+    size_t replicaIndex;
+    std::atomic<long long> pendingWakeNs; //time of the pending timer or zero (see Block::yieldUntil)
+    std::map<int, std::pair<bool, bool>> descriptors; //registered file descriptors to read and write interest
+    std::shared_ptr<ThreadEnvironment> descriptorEnvironment;
+    std::atomic<bool> descriptorsReady; //a descriptor was ready and needs to be rearmed
+    std::mutex descriptorMutex;
+    std::vector<WorkerActor *> fusedActors; //downstream actors when the head of a fused chain
     std::map<std::string, std::unique_ptr<InputPort>> inputs;
     std::map<std::string, std::unique_ptr<OutputPort>> outputs;
     std::map<bool, std::map<std::string, std::map<std::string, std::string>>> bufferModeCache;
@@ -76,6 +173,10 @@ public:
     ///////////////////// work stats collection ///////////////////////
     unsigned long long numTaskCalls;
     unsigned long long numWorkCalls;
+    unsigned long long numWorkAllocations;
+    std::atomic<unsigned long long> numDeadlineMisses;
+    std::atomic<unsigned long long> numTaskSteals;
+    unsigned long long maxWorkCallsPerTask; //most consecutive work() calls in one dispatch
     std::chrono::high_resolution_clock::duration totalTimeTask;
     std::chrono::high_resolution_clock::duration totalTimeWork;
     std::chrono::high_resolution_clock::duration totalTimePreWork;
@@ -115,12 +216,15 @@ public:
     std::string getBufferMode(const std::string &name, const std::string &domain, const bool isInput);
     BufferManager::Sptr getBufferManager(const std::string &name, const std::string &domain, const bool isInput);
     BufferManager::Sptr getBufferManagerNoLock(const std::string &name, const std::string &domain, const bool isInput);
+    BufferManager::Sptr makeStagingBufferManagerNoLock(const std::string &name, const BufferManagerArgs &args);
     void setOutputBufferManager(const std::string &name, const BufferManager::Sptr &manager);
     void ensureOutputBufferManagerNoLock(const std::string &name);
+    void prepareRealtimeNoLock(void);
 
     ///////////////////// work helper methods ///////////////////////
-    void workTask(void);
+    bool workTask(void);
     bool preWorkTasks(void);
-    void postWorkTasks(void);
+    bool postWorkTasks(void);
     void handleSlotCalls(InputPort &);
+    void rearmDescriptors(void);
 };